@@ -133,7 +133,13 @@ bool GAnimationManager::animationIsPlay(int index)
 
 bool GAnimationManager::hasAnyPlaying() const
 {
-    return !_animationsPlaying.empty();
+    // Finished animations leave their priority layer behind as an empty list.
+    for (const auto& layer : _animationsPlaying) {
+        if (!layer.second.empty()) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void GAnimationManager::setEndTime(osgAnimation::Animation* animation, double end)
@@ -0,0 +1,407 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gbatch.h"
+#include "gnodevisitor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <osg/ComputeBoundsVisitor>
+#include <osg/Geode>
+#include <osg/LOD>
+#include <osg/MatrixTransform>
+#include <osg/PositionAttitudeTransform>
+#include <osg/ProxyNode>
+#include <osg/Sequence>
+#include <osg/Switch>
+#include <osgAnimation/AnimationManagerBase>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+namespace GBatch {
+
+struct Item {
+    osg::ref_ptr<osg::Geometry> geometry;
+    osg::ref_ptr<osg::Group> parent;
+    osg::Matrixd matrix;
+};
+
+using BatchKey = std::tuple<osg::Group*, osg::StateSet*, std::string, int>;
+
+static bool isBatchableArray(const osg::Array* array, unsigned int numVertices, bool allowOverall)
+{
+    if (!array) {
+        return true;
+    }
+    if (array->getBinding() == osg::Array::BIND_OVERALL) {
+        return allowOverall && array->getNumElements() >= 1;
+    }
+    return (array->getBinding() == osg::Array::BIND_PER_VERTEX || array->getBinding() == osg::Array::BIND_UNDEFINED)
+        && array->getNumElements() == numVertices;
+}
+
+static std::string layoutOf(const osg::Geometry* geometry)
+{
+    std::ostringstream layout;
+    auto add = [&layout](const char* name, const osg::Array* array) {
+        layout << name << ":";
+        if (array) {
+            layout << array->getType() << "/" << array->getNormalize();
+        }
+        layout << ";";
+    };
+    add("v", geometry->getVertexArray());
+    add("n", geometry->getNormalArray());
+    add("c", geometry->getColorArray());
+    for (unsigned int i = 0; i < geometry->getNumTexCoordArrays(); i++) {
+        add("t", geometry->getTexCoordArray(i));
+    }
+    return layout.str();
+}
+
+static bool isBatchable(const osg::Geometry* geometry)
+{
+    if (!GGeometryVisitor::isPlainGeometry(geometry) || geometry->getCullCallback() || geometry->getEventCallback() || geometry->getDrawCallback()) {
+        return false;
+    }
+    const osg::Array* vertices = geometry->getVertexArray();
+    if (!vertices || vertices->getType() != osg::Array::Vec3ArrayType || vertices->getNumElements() == 0) {
+        return false;
+    }
+    unsigned int numVertices = vertices->getNumElements();
+    const osg::Array* normals = geometry->getNormalArray();
+    if (normals && normals->getType() != osg::Array::Vec3ArrayType && normals->getType() != osg::Array::Vec3bArrayType) {
+        return false;
+    }
+    if (geometry->getSecondaryColorArray() || geometry->getFogCoordArray() || geometry->getNumVertexAttribArrays() > 0) {
+        return false;
+    }
+    if (!isBatchableArray(vertices, numVertices, false) || !isBatchableArray(normals, numVertices, true) || !isBatchableArray(geometry->getColorArray(), numVertices, true)) {
+        return false;
+    }
+    for (const auto& texCoords : geometry->getTexCoordArrayList()) {
+        if (!isBatchableArray(texCoords, numVertices, false)) {
+            return false;
+        }
+    }
+    if (geometry->getNumPrimitiveSets() == 0) {
+        return false;
+    }
+    for (const auto& primitiveSet : geometry->getPrimitiveSetList()) {
+        if (primitiveSet->getMode() != GL_TRIANGLES || primitiveSet->getNumInstances() > 0) {
+            return false;
+        }
+        if (!primitiveSet->getDrawElements() && primitiveSet->getType() != osg::PrimitiveSet::DrawArraysPrimitiveType) {
+            return false;
+        }
+    }
+    return true;
+}
+
+class GBatchVisitor : public osg::NodeVisitor {
+public:
+    explicit GBatchVisitor(const Options& options, const osg::BoundingBox& bound, osg::Group* root)
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+        , m_options(options)
+        , m_bound(bound)
+        , m_stateNode(root)
+    {
+        m_cellSize = std::max(std::max(bound.xMax() - bound.xMin(), bound.yMax() - bound.yMin()), bound.zMax() - bound.zMin()) / std::max(1u, options.cells);
+    }
+    inline std::map<BatchKey, std::vector<Item>>& batchList() { return m_batchList; }
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        if (isExcluded(node)) {
+            return;
+        }
+        osg::Group* group = node.asGroup();
+        if (group && node.getStateSet() && group != m_stateNode) {
+            osg::ref_ptr<osg::Group> stateNode = m_stateNode;
+            osg::Matrixd matrix = m_matrix;
+            m_stateNode = group;
+            m_matrix.makeIdentity();
+            traverse(node);
+            m_stateNode = stateNode;
+            m_matrix = matrix;
+            return;
+        }
+        traverse(node);
+    }
+    virtual void apply(osg::Transform& transform) override
+    {
+        if (isExcluded(transform) || (!transform.asMatrixTransform() && !transform.asPositionAttitudeTransform())) {
+            return;
+        }
+        osg::Matrixd local;
+        transform.computeLocalToWorldMatrix(local, this);
+        osg::Matrixd world = m_world;
+        osg::Matrixd matrix = m_matrix;
+        m_world = local * m_world;
+        m_matrix = local * m_matrix;
+        apply(static_cast<osg::Node&>(transform));
+        m_world = world;
+        m_matrix = matrix;
+    }
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        osg::Geometry* geometry = drawable.asGeometry();
+        if (!geometry || isExcluded(drawable) || !isBatchable(geometry) || getNodePath().size() < 2) {
+            return;
+        }
+        osg::Group* parent = getNodePath().at(getNodePath().size() - 2)->asGroup();
+        if (!parent) {
+            return;
+        }
+        // Instanced subtrees are left alone, removing a shared child would drop it everywhere.
+        for (size_t i = 1; i < getNodePath().size(); i++) {
+            if (getNodePath().at(i)->getNumParents() > 1) {
+                return;
+            }
+        }
+        osg::Vec3d center = geometry->getBoundingBox().center() * m_world;
+        int cell = 0;
+        if (m_cellSize > 0) {
+            int cells = (int)std::max(1u, m_options.cells);
+            int x = osg::clampBetween((int)((center.x() - m_bound.xMin()) / m_cellSize), 0, cells - 1);
+            int y = osg::clampBetween((int)((center.y() - m_bound.yMin()) / m_cellSize), 0, cells - 1);
+            int z = osg::clampBetween((int)((center.z() - m_bound.zMin()) / m_cellSize), 0, cells - 1);
+            cell = x + (y + z * cells) * cells;
+        }
+        m_batchList[BatchKey(m_stateNode.get(), geometry->getStateSet(), layoutOf(geometry), cell)].push_back(Item { geometry, parent, m_matrix });
+    }
+
+private:
+    bool isExcluded(const osg::Node& node) const
+    {
+        if (!node.getName().empty() && m_options.excludeNames.count(node.getName()) > 0) {
+            return true;
+        }
+        if (node.getDataVariance() == osg::Object::DYNAMIC || node.getCullCallback() || node.getEventCallback()) {
+            return true;
+        }
+        if (node.getUpdateCallback() && !dynamic_cast<const osgAnimation::AnimationManagerBase*>(node.getUpdateCallback())) {
+            return true;
+        }
+        return node.asSwitch() || node.asCamera() || dynamic_cast<const osg::LOD*>(&node) || dynamic_cast<const osg::Sequence*>(&node) || dynamic_cast<const osg::ProxyNode*>(&node);
+    }
+
+private:
+    const Options& m_options;
+    osg::BoundingBox m_bound;
+    double m_cellSize = 0;
+    osg::ref_ptr<osg::Group> m_stateNode;
+    osg::Matrixd m_world;
+    osg::Matrixd m_matrix;
+    std::map<BatchKey, std::vector<Item>> m_batchList;
+};
+
+static void appendIndices(const osg::PrimitiveSet* primitiveSet, unsigned int base, bool flip, std::vector<unsigned int>& indices)
+{
+    for (unsigned int i = 0; i + 2 < primitiveSet->getNumIndices(); i += 3) {
+        unsigned int a = primitiveSet->index(i);
+        unsigned int b = primitiveSet->index(i + 1);
+        unsigned int c = primitiveSet->index(i + 2);
+        indices.push_back(base + a);
+        indices.push_back(base + (flip ? c : b));
+        indices.push_back(base + (flip ? b : c));
+    }
+}
+
+static void copyElements(const osg::Array* src, osg::Array* dst, unsigned int offset, unsigned int count)
+{
+    unsigned int elementSize = src->getElementSize();
+    unsigned char* data = static_cast<unsigned char*>(const_cast<GLvoid*>(dst->getDataPointer()));
+    bool overall = src->getBinding() == osg::Array::BIND_OVERALL;
+    for (unsigned int i = 0; i < count; i++) {
+        std::memcpy(data + (offset + i) * elementSize, src->getDataPointer(overall ? 0 : i), elementSize);
+    }
+}
+
+static osg::ref_ptr<osg::Array> createArray(const osg::Array* prototype, unsigned int count)
+{
+    if (!prototype) {
+        return nullptr;
+    }
+    osg::ref_ptr<osg::Array> array = static_cast<osg::Array*>(prototype->cloneType());
+    array->resizeArray(count);
+    array->setBinding(osg::Array::BIND_PER_VERTEX);
+    array->setNormalize(prototype->getNormalize());
+    return array;
+}
+
+static osg::ref_ptr<osg::Geometry> mergeItems(const std::vector<Item>& items, size_t begin, size_t end)
+{
+    const osg::Geometry* prototype = items.at(begin).geometry;
+    unsigned int numVertices = 0;
+    for (size_t i = begin; i < end; i++) {
+        numVertices += items.at(i).geometry->getVertexArray()->getNumElements();
+    }
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX, numVertices);
+    osg::ref_ptr<osg::Array> normals = createArray(prototype->getNormalArray(), numVertices);
+    osg::ref_ptr<osg::Array> colors = createArray(prototype->getColorArray(), numVertices);
+    std::vector<osg::ref_ptr<osg::Array>> texCoordsList;
+    for (const auto& texCoords : prototype->getTexCoordArrayList()) {
+        texCoordsList.push_back(createArray(texCoords, numVertices));
+    }
+    std::vector<unsigned int> indices;
+    unsigned int base = 0;
+    for (size_t i = begin; i < end; i++) {
+        const Item& item = items.at(i);
+        const osg::Geometry* geometry = item.geometry;
+        const osg::Vec3Array* srcVertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+        unsigned int count = srcVertices->getNumElements();
+        for (unsigned int v = 0; v < count; v++) {
+            (*vertices)[base + v] = (*srcVertices)[v] * item.matrix;
+        }
+        if (normals.valid()) {
+            const osg::Array* srcNormals = geometry->getNormalArray();
+            bool overall = srcNormals->getBinding() == osg::Array::BIND_OVERALL;
+            osg::Matrixd inverse = osg::Matrixd::inverse(item.matrix);
+            // Rounded like the quantize stage, so batched and quantized normals agree.
+            auto toByte = [](float v) {
+                return (signed char)std::lround(osg::clampBetween(v, -1.0f, 1.0f) * 127.0f);
+            };
+            for (unsigned int v = 0; v < count; v++) {
+                unsigned int index = overall ? 0 : v;
+                osg::Vec3 normal;
+                if (srcNormals->getType() == osg::Array::Vec3bArrayType) {
+                    const osg::Vec3b& n = (*static_cast<const osg::Vec3bArray*>(srcNormals))[index];
+                    normal.set(n.x() / 127.0f, n.y() / 127.0f, n.z() / 127.0f);
+                } else {
+                    normal = (*static_cast<const osg::Vec3Array*>(srcNormals))[index];
+                }
+                normal = osg::Matrixd::transform3x3(inverse, normal);
+                normal.normalize();
+                if (normals->getType() == osg::Array::Vec3bArrayType) {
+                    (*static_cast<osg::Vec3bArray*>(normals.get()))[base + v] = osg::Vec3b(toByte(normal.x()), toByte(normal.y()), toByte(normal.z()));
+                } else {
+                    (*static_cast<osg::Vec3Array*>(normals.get()))[base + v] = normal;
+                }
+            }
+        }
+        if (colors.valid()) {
+            copyElements(geometry->getColorArray(), colors, base, count);
+        }
+        for (unsigned int unit = 0; unit < texCoordsList.size(); unit++) {
+            if (texCoordsList.at(unit).valid()) {
+                copyElements(geometry->getTexCoordArray(unit), texCoordsList.at(unit), base, count);
+            }
+        }
+        bool flip = (osg::Vec3d(item.matrix(0, 0), item.matrix(0, 1), item.matrix(0, 2)) ^ osg::Vec3d(item.matrix(1, 0), item.matrix(1, 1), item.matrix(1, 2))) * osg::Vec3d(item.matrix(2, 0), item.matrix(2, 1), item.matrix(2, 2)) < 0;
+        for (const auto& primitiveSet : geometry->getPrimitiveSetList()) {
+            appendIndices(primitiveSet, base, flip, indices);
+        }
+        base += count;
+    }
+    osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+    geometry->setName("batch");
+    geometry->setStateSet(const_cast<osg::StateSet*>(prototype->getStateSet()));
+    geometry->setUseDisplayList(false);
+    geometry->setUseVertexBufferObjects(true);
+    geometry->setVertexArray(vertices);
+    if (normals.valid()) {
+        geometry->setNormalArray(normals);
+    }
+    if (colors.valid()) {
+        geometry->setColorArray(colors);
+    }
+    for (unsigned int unit = 0; unit < texCoordsList.size(); unit++) {
+        if (texCoordsList.at(unit).valid()) {
+            geometry->setTexCoordArray(unit, texCoordsList.at(unit));
+        }
+    }
+    if (numVertices <= 65536) {
+        geometry->addPrimitiveSet(new osg::DrawElementsUShort(GL_TRIANGLES, indices.begin(), indices.end()));
+    } else {
+        geometry->addPrimitiveSet(new osg::DrawElementsUInt(GL_TRIANGLES, indices.begin(), indices.end()));
+    }
+    return geometry;
+}
+
+class GCountVisitor : public osg::NodeVisitor {
+public:
+    explicit GCountVisitor()
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+    {
+    }
+    inline unsigned int count() const { return m_count; }
+
+protected:
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        (void)drawable;
+        m_count++;
+    }
+
+private:
+    unsigned int m_count = 0;
+};
+
+unsigned int countDrawables(osg::Node* node)
+{
+    if (!node) {
+        return 0;
+    }
+    GCountVisitor visitor;
+    node->accept(visitor);
+    return visitor.count();
+}
+
+Report optimize(osg::Node* node, const Options& options)
+{
+    Report report;
+    if (!node || !node->asGroup()) {
+        return report;
+    }
+    report.drawablesBefore = countDrawables(node);
+    osg::ComputeBoundsVisitor boundVisitor;
+    node->accept(boundVisitor);
+    GBatchVisitor batchVisitor(options, boundVisitor.getBoundingBox(), node->asGroup());
+    node->accept(batchVisitor);
+    std::map<osg::Group*, osg::ref_ptr<osg::Geode>> batchGeodes;
+    for (auto& batch : batchVisitor.batchList()) {
+        std::vector<Item>& items = batch.second;
+        if (items.size() < 2) {
+            continue;
+        }
+        osg::ref_ptr<osg::Geode>& geode = batchGeodes[std::get<0>(batch.first)];
+        if (!geode.valid()) {
+            geode = new osg::Geode;
+            geode->setName("batch");
+            std::get<0>(batch.first)->addChild(geode);
+        }
+        size_t begin = 0;
+        while (begin < items.size()) {
+            size_t end = begin;
+            unsigned int numVertices = 0;
+            while (end < items.size() && (end == begin || numVertices + items.at(end).geometry->getVertexArray()->getNumElements() <= options.maxVertices)) {
+                numVertices += items.at(end).geometry->getVertexArray()->getNumElements();
+                end++;
+            }
+            geode->addDrawable(mergeItems(items, begin, end));
+            report.batches++;
+            begin = end;
+        }
+        for (const Item& item : items) {
+            item.parent->removeChild(item.geometry);
+            report.merged++;
+        }
+    }
+    report.drawablesAfter = countDrawables(node);
+    return report;
+}
+
+};
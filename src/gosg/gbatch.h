@@ -0,0 +1,39 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GBATCH_H
+#define GBATCH_H
+
+#include <osg/Node>
+#include <set>
+
+namespace GBatch {
+
+struct Options {
+    std::set<std::string> excludeNames;
+    unsigned int cells = 4;
+    unsigned int maxVertices = 1 << 20;
+};
+
+struct Report {
+    unsigned int drawablesBefore = 0;
+    unsigned int drawablesAfter = 0;
+    unsigned int merged = 0;
+    unsigned int batches = 0;
+};
+
+extern unsigned int countDrawables(osg::Node* node);
+extern Report optimize(osg::Node* node, const Options& options = Options());
+
+};
+
+#endif // GBATCH_H
@@ -0,0 +1,98 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gcommandqueue.h"
+#include <osg/NodeVisitor>
+
+GCommandQueue::GCommandQueue()
+    : m_head(&m_stub)
+    , m_tail(&m_stub)
+    , m_pending(0)
+{
+}
+
+GCommandQueue::~GCommandQueue()
+{
+    while (Entry* entry = pop()) {
+        delete entry;
+    }
+}
+
+void GCommandQueue::push(const Command& command)
+{
+    Entry* entry = new Entry;
+    entry->command = command;
+    m_pending++;
+    link(entry);
+}
+
+unsigned int GCommandQueue::run()
+{
+    // Only one consumer at a time, a second caller leaves the commands to the first.
+    if (m_running.test_and_set(std::memory_order_acquire)) {
+        return 0;
+    }
+    unsigned int count = 0;
+    while (Entry* entry = pop()) {
+        if (entry->command) {
+            entry->command();
+        }
+        delete entry;
+        m_pending--;
+        count++;
+    }
+    m_running.clear(std::memory_order_release);
+    return count;
+}
+
+void GCommandQueue::operator()(osg::Node* node, osg::NodeVisitor* nv)
+{
+    run();
+    traverse(node, nv);
+}
+
+void GCommandQueue::link(Entry* entry)
+{
+    entry->next.store(nullptr, std::memory_order_relaxed);
+    Entry* previous = m_head.exchange(entry, std::memory_order_acq_rel);
+    previous->next.store(entry, std::memory_order_release);
+}
+
+GCommandQueue::Entry* GCommandQueue::pop()
+{
+    Entry* tail = m_tail;
+    Entry* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &m_stub) {
+        if (!next) {
+            return nullptr;
+        }
+        m_tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    if (tail != m_head.load(std::memory_order_acquire)) {
+        // A producer has swapped the head but not linked it yet, its command runs next frame.
+        return nullptr;
+    }
+    link(&m_stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        m_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
@@ -0,0 +1,56 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GCOMMANDQUEUE_H
+#define GCOMMANDQUEUE_H
+
+#include <atomic>
+#include <functional>
+#include <osg/Callback>
+#include <osg/Node>
+
+// Commands pushed from any thread without locks and run in order by the
+// update traversal, so the scene is only ever changed by the frame itself.
+class GCommandQueue : public osg::NodeCallback {
+public:
+    using Command = std::function<void()>;
+    explicit GCommandQueue();
+
+public:
+    inline bool empty() const { return m_pending == 0; }
+    void push(const Command& command);
+    unsigned int run();
+
+public:
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv) override;
+
+protected:
+    virtual ~GCommandQueue();
+
+private:
+    struct Entry {
+        std::atomic<Entry*> next { nullptr };
+        Command command;
+    };
+    void link(Entry* entry);
+    Entry* pop();
+
+private:
+    std::atomic<Entry*> m_head;
+    Entry* m_tail = nullptr;
+    Entry m_stub;
+    std::atomic<unsigned int> m_pending;
+    std::atomic_flag m_running = ATOMIC_FLAG_INIT;
+};
+
+#endif // GCOMMANDQUEUE_H
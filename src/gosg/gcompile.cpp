@@ -0,0 +1,109 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gcompile.h"
+#include <OpenThreads/ScopedLock>
+#include <algorithm>
+#include <string>
+
+#define COMPILE_TARGET_FRAME_RATE 1000000.0
+#define COMPILE_MAX_OBJECTS 256
+#define COMPILE_FLUSH_TIME_RATIO 0.1
+
+namespace GCompile {
+
+osg::ref_ptr<osgUtil::IncrementalCompileOperation> create(double budget)
+{
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation> operation = new osgUtil::IncrementalCompileOperation;
+    operation->setMaximumNumOfObjectsToCompilePerFrame(COMPILE_MAX_OBJECTS);
+    operation->setFlushTimeRatio(COMPILE_FLUSH_TIME_RATIO);
+    operation->setConservativeTimeRatio(1.0);
+    setBudget(operation, budget);
+    return operation;
+}
+
+void setBudget(osgUtil::IncrementalCompileOperation* operation, double budget)
+{
+    if (!operation) {
+        return;
+    }
+    // An unreachable target frame rate makes the minimum time the effective per-frame budget.
+    operation->setTargetFrameRate(COMPILE_TARGET_FRAME_RATE);
+    operation->setMinimumTimeAvailableForGLCompileAndDeletePerFrame(std::max(budget, 0.1) / 1000.0);
+}
+
+unsigned int add(osgUtil::IncrementalCompileOperation* operation, osg::Group* attachmentPoint, osg::Node* node)
+{
+    if (!operation || !operation->isActive() || !attachmentPoint || !node) {
+        return 0;
+    }
+    // Only plain groups are split: re-adding children to a LOD, PagedLOD or Switch would drop their ranges and values.
+    osg::Group* group = node->asGroup();
+    const std::string className = node->className();
+    if (!group || group->getNumChildren() == 0 || (className != "Group" && className != "MatrixTransform")) {
+        attachmentPoint->removeChild(node);
+        operation->add(new osgUtil::IncrementalCompileOperation::CompileSet(attachmentPoint, node));
+        return 1;
+    }
+    std::vector<osg::ref_ptr<osg::Node>> parts;
+    for (unsigned int i = 0; i < group->getNumChildren(); i++) {
+        parts.push_back(group->getChild(i));
+    }
+    group->removeChildren(0, group->getNumChildren());
+    for (const auto& part : parts) {
+        operation->add(new osgUtil::IncrementalCompileOperation::CompileSet(group, part));
+    }
+    return (unsigned int)parts.size();
+}
+
+unsigned int pendingCount(osgUtil::IncrementalCompileOperation* operation)
+{
+    if (!operation) {
+        return 0;
+    }
+    size_t count = 0;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> locker(*operation->getToCompiledMutex());
+        count += operation->getToCompile().size();
+    }
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> locker(*operation->getCompiledMutex());
+        count += operation->getCompiled().size();
+    }
+    return (unsigned int)count;
+}
+
+unsigned int flush(osgUtil::IncrementalCompileOperation* operation)
+{
+    if (!operation) {
+        return 0;
+    }
+    osgUtil::IncrementalCompileOperation::CompileSets compileSets;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> locker(*operation->getToCompiledMutex());
+        compileSets.splice(compileSets.end(), operation->getToCompile());
+    }
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> locker(*operation->getCompiledMutex());
+        compileSets.splice(compileSets.end(), operation->getCompiled());
+    }
+    // Attached uncompiled, the first draw uploads them.
+    for (const auto& compileSet : compileSets) {
+        osg::ref_ptr<osg::Group> attachmentPoint;
+        if (compileSet->_attachmentPoint.lock(attachmentPoint) && compileSet->_subgraphToCompile.valid()) {
+            attachmentPoint->addChild(compileSet->_subgraphToCompile);
+        }
+    }
+    return (unsigned int)compileSets.size();
+}
+
+};
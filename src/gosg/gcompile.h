@@ -0,0 +1,29 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GCOMPILE_H
+#define GCOMPILE_H
+
+#include <osg/Group>
+#include <osgUtil/IncrementalCompileOperation>
+
+namespace GCompile {
+
+extern osg::ref_ptr<osgUtil::IncrementalCompileOperation> create(double budget);
+extern void setBudget(osgUtil::IncrementalCompileOperation* operation, double budget);
+extern unsigned int add(osgUtil::IncrementalCompileOperation* operation, osg::Group* attachmentPoint, osg::Node* node);
+extern unsigned int pendingCount(osgUtil::IncrementalCompileOperation* operation);
+extern unsigned int flush(osgUtil::IncrementalCompileOperation* operation);
+
+};
+
+#endif // GCOMPILE_H
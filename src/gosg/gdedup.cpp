@@ -0,0 +1,358 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gdedup.h"
+#include "gnodevisitor.h"
+#include <cstring>
+#include <map>
+#include <set>
+#include <osg/Image>
+#include <osg/Material>
+#include <osg/Texture>
+
+namespace GDedup {
+
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+static uint64_t hashValue(const T& value, uint64_t hash)
+{
+    return hashBytes(&value, sizeof(T), hash);
+}
+
+template <typename T>
+class GObjectTable {
+public:
+    using HashFunction = std::function<uint64_t(const T*)>;
+    using EqualFunction = std::function<bool(const T*, const T*)>;
+    GObjectTable(const HashFunction& hashFunction, const EqualFunction& equalFunction)
+        : m_hashFunction(hashFunction)
+        , m_equalFunction(equalFunction)
+    {
+    }
+    T* share(T* object)
+    {
+        auto it = m_shared.find(object);
+        if (it != m_shared.end()) {
+            return it->second;
+        }
+        std::vector<osg::ref_ptr<T>>& bucket = m_buckets[m_hashFunction(object)];
+        for (const auto& candidate : bucket) {
+            if (m_equalFunction(candidate, object)) {
+                m_shared.emplace(object, candidate.get());
+                m_count++;
+                return candidate.get();
+            }
+        }
+        bucket.push_back(object);
+        m_shared.emplace(object, object);
+        return object;
+    }
+    inline unsigned int count() const { return m_count; }
+
+private:
+    HashFunction m_hashFunction;
+    EqualFunction m_equalFunction;
+    std::map<uint64_t, std::vector<osg::ref_ptr<T>>> m_buckets;
+    std::map<T*, T*> m_shared;
+    unsigned int m_count = 0;
+};
+
+static uint64_t hashArray(const osg::Array* array)
+{
+    uint64_t hash = hashValue(array->getType(), 14695981039346656037ULL);
+    hash = hashValue(array->getBinding(), hash);
+    hash = hashValue(array->getNormalize(), hash);
+    return hashBytes(array->getDataPointer(), array->getTotalDataSize(), hash);
+}
+
+static bool equalArray(const osg::Array* a, const osg::Array* b)
+{
+    return a->getType() == b->getType()
+        && a->getBinding() == b->getBinding()
+        && a->getNormalize() == b->getNormalize()
+        && a->getNumElements() == b->getNumElements()
+        && a->getTotalDataSize() == b->getTotalDataSize()
+        && std::memcmp(a->getDataPointer(), b->getDataPointer(), a->getTotalDataSize()) == 0;
+}
+
+static uint64_t hashImage(const osg::Image* image)
+{
+    uint64_t hash = hashValue(image->s(), 14695981039346656037ULL);
+    hash = hashValue(image->t(), hash);
+    hash = hashValue(image->r(), hash);
+    hash = hashValue(image->getPixelFormat(), hash);
+    hash = hashValue(image->getDataType(), hash);
+    if (image->data()) {
+        hash = hashBytes(image->data(), image->getTotalSizeInBytes(), hash);
+    }
+    return hash;
+}
+
+static bool equalImage(const osg::Image* a, const osg::Image* b)
+{
+    if (!a->data() || !b->data()) {
+        return !a->data() && !b->data() && a->getFileName() == b->getFileName();
+    }
+    return a->s() == b->s()
+        && a->t() == b->t()
+        && a->r() == b->r()
+        && a->getInternalTextureFormat() == b->getInternalTextureFormat()
+        && a->getPixelFormat() == b->getPixelFormat()
+        && a->getDataType() == b->getDataType()
+        && a->getPacking() == b->getPacking()
+        && a->getOrigin() == b->getOrigin()
+        && a->getNumMipmapLevels() == b->getNumMipmapLevels()
+        && a->getTotalSizeInBytesIncludingMipmaps() == b->getTotalSizeInBytesIncludingMipmaps()
+        && std::memcmp(a->data(), b->data(), a->getTotalSizeInBytesIncludingMipmaps()) == 0;
+}
+
+static uint64_t hashAttribute(const osg::StateAttribute* attribute)
+{
+    uint64_t hash = hashValue(attribute->getType(), 14695981039346656037ULL);
+    hash = hashValue(attribute->getMember(), hash);
+    const osg::Material* material = dynamic_cast<const osg::Material*>(attribute);
+    if (material) {
+        hash = hashValue(material->getDiffuse(osg::Material::FRONT), hash);
+        hash = hashValue(material->getEmission(osg::Material::FRONT), hash);
+    }
+    const osg::Texture* texture = attribute->asTexture();
+    if (texture) {
+        for (unsigned int i = 0; i < texture->getNumImages(); i++) {
+            hash = hashValue(texture->getImage(i), hash);
+        }
+    }
+    return hash;
+}
+
+static bool equalAttribute(const osg::StateAttribute* a, const osg::StateAttribute* b)
+{
+    return a->getType() == b->getType()
+        && a->getMember() == b->getMember()
+        && a->compare(*b) == 0
+        && !a->getUpdateCallback() && !b->getUpdateCallback()
+        && !a->getEventCallback() && !b->getEventCallback();
+}
+
+static uint64_t hashStateSet(const osg::StateSet* stateSet)
+{
+    uint64_t hash = hashValue(stateSet->getRenderingHint(), 14695981039346656037ULL);
+    hash = hashValue(stateSet->getBinNumber(), hash);
+    hash = hashBytes(stateSet->getBinName().data(), stateSet->getBinName().size(), hash);
+    for (const auto& mode : stateSet->getModeList()) {
+        hash = hashValue(mode.first, hash);
+        hash = hashValue(mode.second, hash);
+    }
+    for (const auto& attribute : stateSet->getAttributeList()) {
+        hash = hashValue(attribute.second.first.get(), hash);
+        hash = hashValue(attribute.second.second, hash);
+    }
+    for (const auto& unit : stateSet->getTextureAttributeList()) {
+        for (const auto& attribute : unit) {
+            hash = hashValue(attribute.second.first.get(), hash);
+            hash = hashValue(attribute.second.second, hash);
+        }
+    }
+    for (const auto& unit : stateSet->getTextureModeList()) {
+        for (const auto& mode : unit) {
+            hash = hashValue(mode.first, hash);
+            hash = hashValue(mode.second, hash);
+        }
+    }
+    return hashValue(stateSet->getUniformList().size(), hash);
+}
+
+static bool equalStateSet(const osg::StateSet* a, const osg::StateSet* b)
+{
+    return a->compare(*b, true) == 0;
+}
+
+static bool isStatic(const osg::StateSet* stateSet)
+{
+    return stateSet->getDataVariance() != osg::Object::DYNAMIC
+        && !stateSet->getUpdateCallback()
+        && !stateSet->getEventCallback();
+}
+
+static bool isNamedTarget(const osg::Geometry* geometry, const std::set<std::string>& excludeNames)
+{
+    if (!geometry->getName().empty()) {
+        return true;
+    }
+    for (const auto& nodePath : geometry->getParentalNodePaths()) {
+        for (const osg::Node* node : nodePath) {
+            if (!node->getName().empty() && excludeNames.count(node->getName()) > 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+class GResidentVisitor : public osg::NodeVisitor {
+public:
+    explicit GResidentVisitor()
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+    {
+    }
+    inline unsigned long long bytes() const { return m_bytes; }
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        addStateSet(node.getStateSet());
+        traverse(node);
+    }
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        addStateSet(drawable.getStateSet());
+        const osg::Geometry* geometry = drawable.asGeometry();
+        if (!geometry) {
+            return;
+        }
+        GGeometryVisitor::forEachArray(*geometry, [this](const osg::Array* array) {
+            addBufferData(array);
+        });
+        for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); i++) {
+            addBufferData(geometry->getPrimitiveSet(i)->getDrawElements());
+        }
+    }
+
+private:
+    void addBufferData(const osg::BufferData* data)
+    {
+        if (data && m_seen.insert(data).second) {
+            m_bytes += data->getTotalDataSize();
+        }
+    }
+    void addStateSet(const osg::StateSet* stateSet)
+    {
+        if (!stateSet) {
+            return;
+        }
+        for (const auto& unit : stateSet->getTextureAttributeList()) {
+            for (const auto& attribute : unit) {
+                const osg::Texture* texture = attribute.second.first->asTexture();
+                for (unsigned int i = 0; texture && i < texture->getNumImages(); i++) {
+                    addBufferData(texture->getImage(i));
+                }
+            }
+        }
+    }
+
+private:
+    std::set<const osg::BufferData*> m_seen;
+    unsigned long long m_bytes = 0;
+};
+
+unsigned long long residentBytes(osg::Node* node)
+{
+    if (!node) {
+        return 0;
+    }
+    GResidentVisitor visitor;
+    node->accept(visitor);
+    return visitor.bytes();
+}
+
+Report optimize(osg::Node* node, const std::set<std::string>& excludeNames)
+{
+    Report report;
+    if (!node) {
+        return report;
+    }
+    report.bytesBefore = residentBytes(node);
+    GGeometryVisitor geometryVisitor;
+    geometryVisitor.collect(node);
+    GObjectTable<osg::Image> imageTable(hashImage, equalImage);
+    GObjectTable<osg::StateAttribute> attributeTable(hashAttribute, equalAttribute);
+    GObjectTable<osg::StateSet> stateSetTable(hashStateSet, equalStateSet);
+    GObjectTable<osg::Array> arrayTable(hashArray, equalArray);
+    auto shareImages = [&](osg::StateSet* stateSet) {
+        for (const auto& unit : stateSet->getTextureAttributeList()) {
+            for (const auto& attribute : unit) {
+                osg::Texture* texture = attribute.second.first->asTexture();
+                for (unsigned int i = 0; texture && i < texture->getNumImages(); i++) {
+                    if (texture->getImage(i)) {
+                        texture->setImage(i, imageTable.share(texture->getImage(i)));
+                    }
+                }
+            }
+        }
+    };
+    for (const auto& stateSet : geometryVisitor.nodeStateSetList()) {
+        shareImages(stateSet);
+    }
+    for (const auto& stateSet : geometryVisitor.drawableStateSetList()) {
+        shareImages(stateSet);
+    }
+    // Node StateSets and those of named targets are left alone: playGrow() edits the material
+    // of whatever node or drawable the name resolves to in place.
+    std::set<const osg::StateSet*> targetStateSets;
+    for (const auto& geometry : geometryVisitor.geometryList()) {
+        if (geometry->getStateSet() && isNamedTarget(geometry, excludeNames)) {
+            targetStateSets.insert(geometry->getStateSet());
+        }
+    }
+    std::map<osg::StateSet*, osg::StateSet*> sharedStateSets;
+    for (const auto& stateSet : geometryVisitor.drawableStateSetList()) {
+        if (!isStatic(stateSet) || targetStateSets.count(stateSet.get()) > 0) {
+            continue;
+        }
+        osg::StateSet::AttributeList attributeList = stateSet->getAttributeList();
+        for (const auto& attribute : attributeList) {
+            osg::StateAttribute* shared = attributeTable.share(attribute.second.first.get());
+            if (shared != attribute.second.first.get()) {
+                stateSet->setAttribute(shared, attribute.second.second);
+            }
+        }
+        for (unsigned int unit = 0; unit < stateSet->getTextureAttributeList().size(); unit++) {
+            osg::StateSet::AttributeList textureAttributeList = stateSet->getTextureAttributeList().at(unit);
+            for (const auto& attribute : textureAttributeList) {
+                osg::StateAttribute* shared = attributeTable.share(attribute.second.first.get());
+                if (shared != attribute.second.first.get()) {
+                    stateSet->setTextureAttribute(unit, shared, attribute.second.second);
+                }
+            }
+        }
+        sharedStateSets.emplace(stateSet.get(), stateSetTable.share(stateSet.get()));
+    }
+    for (const auto& geometry : geometryVisitor.geometryList()) {
+        auto it = sharedStateSets.find(geometry->getStateSet());
+        if (it != sharedStateSets.end() && it->first != it->second) {
+            geometry->setStateSet(it->second);
+        }
+        // Rig and morph geometries deform their own arrays, sharing them would deform every user.
+        if (!GGeometryVisitor::isPlainGeometry(geometry) || geometry->getDataVariance() == osg::Object::DYNAMIC) {
+            continue;
+        }
+        GGeometryVisitor::replaceArrays(*geometry, [&](osg::Array* array) {
+            return arrayTable.share(array);
+        });
+    }
+    report.arrays = arrayTable.count();
+    report.images = imageTable.count();
+    report.attributes = attributeTable.count();
+    report.stateSets = stateSetTable.count();
+    report.bytesAfter = residentBytes(node);
+    return report;
+}
+
+};
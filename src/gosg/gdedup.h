@@ -0,0 +1,37 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GDEDUP_H
+#define GDEDUP_H
+
+#include <osg/Node>
+#include <set>
+#include <string>
+
+namespace GDedup {
+
+struct Report {
+    unsigned int arrays = 0;
+    unsigned int images = 0;
+    unsigned int attributes = 0;
+    unsigned int stateSets = 0;
+    unsigned long long bytesBefore = 0;
+    unsigned long long bytesAfter = 0;
+};
+
+extern unsigned long long residentBytes(osg::Node* node);
+// Named drawables and drawables below excluded names keep their own StateSets and attributes.
+extern Report optimize(osg::Node* node, const std::set<std::string>& excludeNames = std::set<std::string>());
+
+};
+
+#endif // GDEDUP_H
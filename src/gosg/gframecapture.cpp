@@ -0,0 +1,266 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gframecapture.h"
+#include <QDir>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QUrl>
+#include <cstring>
+
+#define CAPTURE_BUFFER_COUNT 3
+#define CAPTURE_MAX_JOBS 8
+#define CAPTURE_IDLE_FRAMES 4
+
+static QString localPath(const QString& path)
+{
+    QUrl url(path);
+    return url.isLocalFile() ? url.toLocalFile() : path;
+}
+
+GFrameCapture::GFrameCapture()
+{
+    m_thread = std::thread(&GFrameCapture::run, this);
+}
+
+GFrameCapture::~GFrameCapture()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+bool GFrameCapture::grab(const QString& path)
+{
+    if (path.isEmpty()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_grabList.push_back(localPath(path));
+    return true;
+}
+
+bool GFrameCapture::startRecording(const QString& path, bool raw)
+{
+    QString recordPath = localPath(path);
+    if (recordPath.isEmpty() || (!raw && !QDir().mkpath(recordPath))) {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_recording) {
+        return false;
+    }
+    m_recordPath = recordPath;
+    m_recordRaw = raw;
+    m_recordIndex = 0;
+    m_finishPending = false;
+    m_recording = true;
+    return true;
+}
+
+void GFrameCapture::stopRecording()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_recording) {
+        m_recording = false;
+        m_finishPending = true;
+    }
+}
+
+GFrameCapture::TakeResult GFrameCapture::takeRequest(Request& request)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    request = Request();
+    if (!m_grabList.empty()) {
+        request.path = m_grabList.front();
+        m_grabList.pop_front();
+        return Taken;
+    }
+    if (m_finishPending) {
+        // Travels through the readback ring behind the last recorded frame.
+        request.path = m_recordPath;
+        request.raw = m_recordRaw;
+        request.finish = true;
+        m_finishPending = false;
+        return Taken;
+    }
+    if (!m_recording) {
+        return Idle;
+    }
+    if (m_jobList.size() >= CAPTURE_MAX_JOBS) {
+        // The writer is behind, skipping here costs no readback.
+        m_droppedFrames++;
+        return Dropped;
+    }
+    request.path = m_recordPath;
+    request.raw = m_recordRaw;
+    request.sequence = true;
+    request.index = m_recordIndex++;
+    return Taken;
+}
+
+void GFrameCapture::submit(const Request& request, const QImage& image)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_jobList.emplace_back(request, image);
+    }
+    m_condition.notify_all();
+}
+
+void GFrameCapture::run()
+{
+    std::unique_lock<std::mutex> locker(m_mutex);
+    for (;;) {
+        m_condition.wait(locker, [this]() { return m_quit || !m_jobList.empty(); });
+        if (m_jobList.empty()) {
+            break;
+        }
+        std::pair<Request, QImage> job = std::move(m_jobList.front());
+        m_jobList.pop_front();
+        locker.unlock();
+        write(job.first, job.second);
+        locker.lock();
+    }
+    if (m_rawFile.isOpen()) {
+        m_rawFile.close();
+    }
+}
+
+void GFrameCapture::write(const Request& request, const QImage& image)
+{
+    if (request.finish) {
+        if (m_rawFile.isOpen()) {
+            m_rawFile.close();
+        }
+        if (m_savedCallback) {
+            m_savedCallback(request.path);
+        }
+        return;
+    }
+    if (image.isNull()) {
+        m_droppedFrames++;
+        return;
+    }
+    // GL rows start at the bottom, a renderer that mirrors the texture for Qt reads back upside down.
+    QImage frame = request.mirrored ? image.mirrored() : image;
+    bool ok = false;
+    if (!request.sequence) {
+        ok = frame.save(request.path, "PNG");
+        if (ok && m_savedCallback) {
+            m_savedCallback(request.path);
+        }
+    } else if (request.raw) {
+        if (!m_rawFile.isOpen() || m_rawFile.fileName() != request.path) {
+            m_rawFile.close();
+            m_rawFile.setFileName(request.path);
+            m_rawFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            m_rawSize = frame.size();
+        }
+        if (frame.size() != m_rawSize) {
+            // Raw video has no per-frame size, a resized window is scaled back to the first frame.
+            frame = frame.scaled(m_rawSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        qint64 bytes = (qint64)frame.bytesPerLine() * frame.height();
+        ok = m_rawFile.isOpen() && m_rawFile.write((const char*)frame.constBits(), bytes) == bytes;
+    } else {
+        ok = frame.save(QDir(request.path).filePath(QString("frame_%1.png").arg(request.index, 6, 10, QChar('0'))), "PNG");
+    }
+    if (ok) {
+        m_capturedFrames++;
+    } else {
+        m_droppedFrames++;
+    }
+}
+
+void GFrameReadback::read(QOpenGLFramebufferObject* fbo, GFrameCapture* capture, bool mirrored)
+{
+    for (Slot& slot : m_slotList) {
+        slot.age++;
+    }
+    GFrameCapture::Request request;
+    GFrameCapture::TakeResult result = fbo ? capture->takeRequest(request) : GFrameCapture::Idle;
+    m_idleFrames = result == GFrameCapture::Idle ? m_idleFrames + 1 : 0;
+    if (result == GFrameCapture::Taken) {
+        request.mirrored = mirrored;
+        Slot slot;
+        slot.request = request;
+        slot.size = fbo->size();
+        if (!request.finish) {
+            if (m_bufferList.empty() && m_slotList.size() >= CAPTURE_BUFFER_COUNT) {
+                // Every buffer is still in flight, the oldest frame has to be mapped now.
+                collect(capture);
+            }
+            if (m_bufferList.empty()) {
+                slot.buffer = std::make_shared<QOpenGLBuffer>(QOpenGLBuffer::PixelPackBuffer);
+                slot.buffer->setUsagePattern(QOpenGLBuffer::StreamRead);
+                slot.buffer->create();
+            } else {
+                slot.buffer = m_bufferList.back();
+                m_bufferList.pop_back();
+            }
+            QOpenGLFramebufferObject* source = fbo;
+            if (fbo->format().samples() > 0) {
+                // Multisampled buffers can not be read, the resolve blit stays on the GPU.
+                if (!m_resolveFbo || m_resolveFbo->size() != fbo->size()) {
+                    m_resolveFbo.reset(new QOpenGLFramebufferObject(fbo->size()));
+                }
+                QOpenGLFramebufferObject::blitFramebuffer(m_resolveFbo.get(), fbo);
+                source = m_resolveFbo.get();
+            }
+            int bytes = slot.size.width() * slot.size.height() * 4;
+            source->bind();
+            slot.buffer->bind();
+            if (slot.buffer->size() != bytes) {
+                slot.buffer->allocate(bytes);
+            }
+            QOpenGLContext::currentContext()->functions()->glReadPixels(0, 0, slot.size.width(), slot.size.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            slot.buffer->release();
+            fbo->bind();
+        }
+        m_slotList.push_back(slot);
+    }
+    // Maps only buffers the GPU has had two frames to fill, a dropped frame must not stall on the rest.
+    while (!m_slotList.empty() && (m_slotList.front().age >= CAPTURE_BUFFER_COUNT - 1 || !m_slotList.front().buffer || m_idleFrames >= CAPTURE_IDLE_FRAMES)) {
+        collect(capture);
+    }
+}
+
+void GFrameReadback::collect(GFrameCapture* capture)
+{
+    Slot slot = m_slotList.front();
+    m_slotList.pop_front();
+    if (!slot.buffer) {
+        capture->submit(slot.request, QImage());
+        return;
+    }
+    QImage image(slot.size, QImage::Format_RGBA8888);
+    int bytes = slot.size.width() * slot.size.height() * 4;
+    slot.buffer->bind();
+    void* data = slot.buffer->mapRange(0, bytes, QOpenGLBuffer::RangeRead);
+    if (!data) {
+        data = slot.buffer->map(QOpenGLBuffer::ReadOnly);
+    }
+    if (data) {
+        std::memcpy(image.bits(), data, (size_t)bytes);
+        slot.buffer->unmap();
+    } else {
+        image = QImage();
+    }
+    slot.buffer->release();
+    m_bufferList.push_back(slot.buffer);
+    capture->submit(slot.request, image);
+}
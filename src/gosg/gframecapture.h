@@ -0,0 +1,115 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GFRAMECAPTURE_H
+#define GFRAMECAPTURE_H
+
+#include <QFile>
+#include <QImage>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Queues screenshot and recording requests and writes the read back frames
+// as PNG files or raw RGBA video on a worker thread.
+class GFrameCapture {
+public:
+    using SavedCallback = std::function<void(const QString&)>;
+    enum TakeResult {
+        Idle,
+        Dropped,
+        Taken
+    };
+    struct Request {
+        QString path;
+        unsigned int index = 0;
+        bool sequence = false;
+        bool raw = false;
+        bool finish = false;
+        bool mirrored = false;
+    };
+    explicit GFrameCapture();
+    GFrameCapture(const GFrameCapture&) = delete;
+    GFrameCapture& operator=(const GFrameCapture&) = delete;
+    ~GFrameCapture();
+
+public:
+    inline bool isRecording() const { return m_recording; }
+    inline unsigned int capturedFrames() const { return m_capturedFrames; }
+    inline unsigned int droppedFrames() const { return m_droppedFrames; }
+    inline void setSavedCallback(const SavedCallback& callback) { m_savedCallback = callback; }
+    bool grab(const QString& path);
+    bool startRecording(const QString& path, bool raw);
+    void stopRecording();
+    TakeResult takeRequest(Request& request);
+    void submit(const Request& request, const QImage& image);
+
+private:
+    void run();
+    void write(const Request& request, const QImage& image);
+
+private:
+    std::deque<QString> m_grabList;
+    QString m_recordPath;
+    bool m_recordRaw = false;
+    bool m_finishPending = false;
+    unsigned int m_recordIndex = 0;
+    std::atomic<bool> m_recording { false };
+    std::atomic<unsigned int> m_capturedFrames { 0 };
+    std::atomic<unsigned int> m_droppedFrames { 0 };
+    std::deque<std::pair<Request, QImage>> m_jobList;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_quit = false;
+    QFile m_rawFile;
+    QSize m_rawSize;
+    SavedCallback m_savedCallback = nullptr;
+};
+
+// Reads the rendered framebuffer into a ring of pixel buffer objects and maps
+// each one a couple of frames later, once the GPU has finished the copy.
+class GFrameReadback {
+public:
+    explicit GFrameReadback() = default;
+    GFrameReadback(const GFrameReadback&) = delete;
+    GFrameReadback& operator=(const GFrameReadback&) = delete;
+
+public:
+    inline bool isPending() const { return !m_slotList.empty(); }
+    void read(QOpenGLFramebufferObject* fbo, GFrameCapture* capture, bool mirrored);
+
+private:
+    struct Slot {
+        GFrameCapture::Request request;
+        std::shared_ptr<QOpenGLBuffer> buffer;
+        QSize size;
+        unsigned int age = 0;
+    };
+    void collect(GFrameCapture* capture);
+
+private:
+    std::vector<std::shared_ptr<QOpenGLBuffer>> m_bufferList;
+    std::deque<Slot> m_slotList;
+    unsigned int m_idleFrames = 0;
+    std::unique_ptr<QOpenGLFramebufferObject> m_resolveFbo;
+};
+
+#endif // GFRAMECAPTURE_H
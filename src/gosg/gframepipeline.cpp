@@ -0,0 +1,187 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gframepipeline.h"
+#include <osgViewer/Renderer>
+
+GFramePipeline::GFramePipeline(osgViewer::Viewer* viewer)
+    : m_viewer(viewer)
+    , m_endDynamicDrawBlock(new osg::EndOfDynamicDrawBlock(1))
+{
+}
+
+GFramePipeline::~GFramePipeline()
+{
+    if (m_running) {
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            m_quit = true;
+        }
+        m_condition.notify_all();
+        m_endDynamicDrawBlock->release();
+        m_thread.join();
+    }
+}
+
+void GFramePipeline::start()
+{
+    if (m_running) {
+        return;
+    }
+    osgViewer::Viewer::Cameras cameras;
+    m_viewer->getCameras(cameras);
+    for (osg::Camera* camera : cameras) {
+        osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(camera->getRenderer());
+        if (renderer) {
+            // Cull and draw then use the two scene views in turn.
+            renderer->setGraphicsThreadDoesCull(false);
+        }
+        if (camera->getGraphicsContext() && camera->getGraphicsContext()->getState()) {
+            camera->getGraphicsContext()->getState()->setDynamicObjectRenderingCompletedCallback(m_endDynamicDrawBlock);
+        }
+    }
+    m_endDynamicDrawBlock->release();
+    m_requested = 1;
+    m_culled = 0;
+    m_frameStarts.clear();
+    m_frameNumbers.clear();
+    m_quit = false;
+    m_running = true;
+    m_thread = std::thread(&GFramePipeline::run, this);
+}
+
+void GFramePipeline::stop()
+{
+    if (!m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+    m_running = false;
+    osg::GraphicsContext* context = m_viewer->getCamera()->getGraphicsContext();
+    if (m_culled > 0 && context) {
+        // Draws the frame still queued so no scene view is left behind.
+        context->runOperations();
+    }
+    osgViewer::Viewer::Cameras cameras;
+    m_viewer->getCameras(cameras);
+    for (osg::Camera* camera : cameras) {
+        osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(camera->getRenderer());
+        if (renderer) {
+            renderer->setGraphicsThreadDoesCull(true);
+        }
+        if (camera->getGraphicsContext() && camera->getGraphicsContext()->getState()) {
+            camera->getGraphicsContext()->getState()->setDynamicObjectRenderingCompletedCallback(nullptr);
+        }
+    }
+}
+
+void GFramePipeline::wait()
+{
+    std::unique_lock<std::mutex> locker(m_mutex);
+    m_condition.wait(locker, [this]() { return !m_running || m_culled >= m_requested; });
+}
+
+double GFramePipeline::frame()
+{
+    std::chrono::steady_clock::time_point frameStart;
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        m_condition.wait(locker, [this]() { return m_culled >= m_requested; });
+        frameStart = m_frameStarts.front();
+        m_frameStarts.pop_front();
+        m_drawnFrameNumber = m_frameNumbers.front();
+        m_frameNumbers.pop_front();
+        // The next frame may update the scene once this draw has finished the dynamic objects.
+        m_endDynamicDrawBlock->reset();
+        m_requested++;
+    }
+    m_condition.notify_all();
+    osg::GraphicsContext* context = m_viewer->getCamera()->getGraphicsContext();
+    if (context) {
+        // Only views drawing another view's scene wait for its update, the owner overlaps on the dynamic block.
+        std::shared_lock<std::shared_timed_mutex> sceneLocker;
+        if (m_sceneLock && m_lockDraw) {
+            sceneLocker = std::shared_lock<std::shared_timed_mutex>(*m_sceneLock);
+        }
+        context->runOperations();
+    }
+    m_endDynamicDrawBlock->release();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+}
+
+void GFramePipeline::run()
+{
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            m_condition.wait(locker, [this]() { return m_quit || m_culled < m_requested; });
+            if (m_culled >= m_requested) {
+                return;
+            }
+        }
+        m_endDynamicDrawBlock->block();
+        std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+        m_viewer->advance(m_clock ? m_clock() : USE_REFERENCE_TIME);
+        if (m_frameCounter) {
+            m_viewer->getFrameStamp()->setFrameNumber(m_frameCounter());
+        }
+        unsigned int frameNumber = m_viewer->getFrameStamp()->getFrameNumber();
+        m_viewer->eventTraversal();
+        {
+            // Views sharing the scene cull together but update alone, uncontended with a single view.
+            std::unique_lock<std::shared_timed_mutex> sceneLocker;
+            if (m_sceneLock) {
+                sceneLocker = std::unique_lock<std::shared_timed_mutex>(*m_sceneLock);
+            }
+            m_viewer->updateTraversal();
+        }
+        {
+            std::shared_lock<std::shared_timed_mutex> sceneLocker;
+            if (m_sceneLock) {
+                sceneLocker = std::shared_lock<std::shared_timed_mutex>(*m_sceneLock);
+            }
+            cull();
+        }
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            m_frameStarts.push_back(frameStart);
+            m_frameNumbers.push_back(frameNumber);
+            m_culled++;
+        }
+        m_condition.notify_all();
+    }
+}
+
+void GFramePipeline::cull()
+{
+    osgDB::DatabasePager* pager = m_viewer->getDatabasePager();
+    if (pager) {
+        pager->signalBeginFrame(m_viewer->getFrameStamp());
+    }
+    osgViewer::Viewer::Cameras cameras;
+    m_viewer->getCameras(cameras);
+    for (osg::Camera* camera : cameras) {
+        osgViewer::Renderer* renderer = dynamic_cast<osgViewer::Renderer*>(camera->getRenderer());
+        if (renderer && camera->getGraphicsContext()) {
+            renderer->cull();
+        }
+    }
+    if (pager) {
+        pager->signalEndFrame();
+    }
+}
@@ -0,0 +1,74 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GFRAMEPIPELINE_H
+#define GFRAMEPIPELINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <osg/GraphicsThread>
+#include <shared_mutex>
+#include <osgViewer/Viewer>
+#include <thread>
+
+// Runs event, update and cull of the next frame on a worker thread while
+// the caller draws the current one with its own GL context current.
+class GFramePipeline {
+public:
+    explicit GFramePipeline(osgViewer::Viewer* viewer);
+    GFramePipeline(const GFramePipeline&) = delete;
+    GFramePipeline& operator=(const GFramePipeline&) = delete;
+    ~GFramePipeline();
+
+public:
+    inline bool isRunning() const { return m_running; }
+    inline unsigned int drawnFrameNumber() const { return m_drawnFrameNumber; }
+    inline void setClock(const std::function<double()>& clock) { m_clock = clock; }
+    inline void setFrameCounter(const std::function<unsigned int()>& frameCounter) { m_frameCounter = frameCounter; }
+    inline void setSceneLock(std::shared_timed_mutex* sceneLock, bool lockDraw)
+    {
+        m_sceneLock = sceneLock;
+        m_lockDraw = lockDraw;
+    }
+    void start();
+    void stop();
+    void wait();
+    double frame();
+
+private:
+    void run();
+    void cull();
+
+private:
+    osgViewer::Viewer* m_viewer = nullptr;
+    osg::ref_ptr<osg::EndOfDynamicDrawBlock> m_endDynamicDrawBlock;
+    std::function<double()> m_clock;
+    std::function<unsigned int()> m_frameCounter;
+    std::shared_timed_mutex* m_sceneLock = nullptr;
+    bool m_lockDraw = false;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::chrono::steady_clock::time_point> m_frameStarts;
+    std::deque<unsigned int> m_frameNumbers;
+    unsigned int m_drawnFrameNumber = 0;
+    unsigned int m_requested = 0;
+    unsigned int m_culled = 0;
+    bool m_running = false;
+    bool m_quit = false;
+};
+
+#endif // GFRAMEPIPELINE_H
@@ -0,0 +1,94 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gframestats.h"
+#include <algorithm>
+#include <cmath>
+
+GFrameStats::GFrameStats(unsigned int capacity)
+    : m_frames(std::max(1u, capacity), 0.0)
+{
+}
+
+void GFrameStats::addFrame(double time)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_frames[m_next] = time;
+    m_next = (m_next + 1) % m_frames.size();
+    m_count = std::min<unsigned int>(m_count + 1, (unsigned int)m_frames.size());
+    m_total++;
+}
+
+void GFrameStats::clear()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_next = 0;
+    m_count = 0;
+    m_total = 0;
+}
+
+unsigned int GFrameStats::count() const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_count;
+}
+
+unsigned int GFrameStats::total() const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_total;
+}
+
+double GFrameStats::percentile(double percent) const
+{
+    const std::vector<double>& frames = sortedFrames();
+    if (frames.empty()) {
+        return 0;
+    }
+    size_t index = (size_t)std::ceil(std::min(std::max(percent, 0.0), 100.0) / 100.0 * frames.size());
+    return frames.at(index > 0 ? index - 1 : 0);
+}
+
+double GFrameStats::maximum() const
+{
+    const std::vector<double>& frames = sortedFrames();
+    return frames.empty() ? 0 : frames.back();
+}
+
+unsigned int GFrameStats::framesOver(double budget) const
+{
+    const std::vector<double>& frames = sortedFrames();
+    return (unsigned int)(frames.end() - std::upper_bound(frames.begin(), frames.end(), budget));
+}
+
+std::vector<unsigned int> GFrameStats::histogram(const std::vector<double>& bounds) const
+{
+    // One bucket up to each bound, the last one holds everything above.
+    const std::vector<double>& frames = sortedFrames();
+    std::vector<unsigned int> buckets;
+    std::vector<double>::const_iterator begin = frames.begin();
+    for (double bound : bounds) {
+        std::vector<double>::const_iterator end = std::upper_bound(begin, frames.end(), bound);
+        buckets.push_back((unsigned int)(end - begin));
+        begin = end;
+    }
+    buckets.push_back((unsigned int)(frames.end() - begin));
+    return buckets;
+}
+
+std::vector<double> GFrameStats::sortedFrames() const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    std::vector<double> frames(m_frames.begin(), m_frames.begin() + m_count);
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
@@ -0,0 +1,46 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GFRAMESTATS_H
+#define GFRAMESTATS_H
+
+#include <mutex>
+#include <vector>
+
+class GFrameStats {
+public:
+    explicit GFrameStats(unsigned int capacity = 600);
+    GFrameStats(const GFrameStats&) = delete;
+    GFrameStats& operator=(const GFrameStats&) = delete;
+
+public:
+    void addFrame(double time);
+    void clear();
+    unsigned int count() const;
+    unsigned int total() const;
+    double percentile(double percent) const;
+    double maximum() const;
+    unsigned int framesOver(double budget) const;
+    std::vector<unsigned int> histogram(const std::vector<double>& bounds) const;
+
+private:
+    std::vector<double> sortedFrames() const;
+
+private:
+    std::vector<double> m_frames;
+    unsigned int m_next = 0;
+    unsigned int m_count = 0;
+    unsigned int m_total = 0;
+    mutable std::mutex m_mutex;
+};
+
+#endif // GFRAMESTATS_H
@@ -0,0 +1,163 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gimageloader.h"
+#include "gnodevisitor.h"
+#include "gparallel.h"
+#include "gtexturecache.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <osg/BlendFunc>
+#include <osg/Texture>
+#include <osgDB/FileUtils>
+#include <osgDB/Registry>
+
+namespace GImageLoader {
+
+class GDeferredImageCallback : public osgDB::ReadFileCallback {
+public:
+    virtual osgDB::ReaderWriter::ReadResult readImage(const std::string& filename, const osgDB::Options* options) override
+    {
+        std::string path = osgDB::findDataFile(filename, options);
+        if (path.empty()) {
+            return osgDB::ReaderWriter::ReadResult::FILE_NOT_FOUND;
+        }
+        std::lock_guard<std::mutex> locker(m_mutex);
+        osg::ref_ptr<osg::Image>& image = m_imageList[path];
+        if (!image.valid()) {
+            image = new osg::Image;
+            image->setFileName(filename);
+        }
+        return image.get();
+    }
+    std::map<std::string, osg::ref_ptr<osg::Image>> takeImageList()
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        std::map<std::string, osg::ref_ptr<osg::Image>> imageList;
+        imageList.swap(m_imageList);
+        return imageList;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::map<std::string, osg::ref_ptr<osg::Image>> m_imageList;
+};
+
+static void moveImage(osg::Image* from, osg::Image* to)
+{
+    // Hand the decoded buffer over without copying, the decoder image must not free it any more.
+    to->setImage(from->s(), from->t(), from->r(), from->getInternalTextureFormat(), from->getPixelFormat(), from->getDataType(),
+        from->data(), from->getAllocationMode(), from->getPacking(), from->getRowLength());
+    to->setMipmapLevels(from->getMipmapLevels());
+    to->setOrigin(from->getOrigin());
+    from->setAllocationMode(osg::Image::NO_DELETE);
+}
+
+static bool fixupStateSet(osg::StateSet* stateSet)
+{
+    bool translucent = false;
+    for (unsigned int unit = 0; unit < stateSet->getTextureAttributeList().size(); unit++) {
+        osg::StateSet::AttributeList attributeList = stateSet->getTextureAttributeList().at(unit);
+        for (const auto& attribute : attributeList) {
+            osg::Texture* texture = attribute.second.first->asTexture();
+            if (!texture) {
+                continue;
+            }
+            bool empty = false;
+            for (unsigned int i = 0; i < texture->getNumImages(); i++) {
+                const osg::Image* image = texture->getImage(i);
+                if (image && !image->data()) {
+                    empty = true;
+                } else if (unit == 0 && image && image->isImageTranslucent()) {
+                    translucent = true;
+                }
+            }
+            if (empty) {
+                stateSet->removeTextureAttribute(unit, texture);
+                stateSet->removeTextureMode(unit, texture->getTextureTarget());
+            }
+        }
+    }
+    // The reader decides transparency from the image while parsing, redo it now that the pixels exist.
+    if (translucent && stateSet->getRenderingHint() != osg::StateSet::TRANSPARENT_BIN) {
+        stateSet->setAttributeAndModes(new osg::BlendFunc(osg::BlendFunc::SRC_ALPHA, osg::BlendFunc::ONE_MINUS_SRC_ALPHA));
+        stateSet->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+        return true;
+    }
+    return false;
+}
+
+void defer(osgDB::Options* options)
+{
+    if (options) {
+        options->setReadFileCallback(new GDeferredImageCallback);
+    }
+}
+
+Report decode(osgDB::Options* options, osg::Node* node, const Options& decodeOptions)
+{
+    Report report;
+    GDeferredImageCallback* callback = options ? dynamic_cast<GDeferredImageCallback*>(options->getReadFileCallback()) : nullptr;
+    if (!callback) {
+        return report;
+    }
+    options->setReadFileCallback(nullptr);
+    osg::ref_ptr<osgDB::Options> readOptions = options->cloneOptions();
+    readOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+    std::vector<std::pair<std::string, osg::ref_ptr<osg::Image>>> imageList;
+    for (const auto& image : callback->takeImageList()) {
+        imageList.push_back(image);
+    }
+    report.images = (unsigned int)imageList.size();
+    report.threads = std::min<unsigned int>(GParallel::threadCount(), std::max<unsigned int>(1, report.images));
+    std::vector<char> failedList(imageList.size(), 0);
+    std::vector<char> hitList(imageList.size(), 0);
+    std::vector<char> writeList(imageList.size(), 0);
+    auto startTime = std::chrono::steady_clock::now();
+    GParallel::forEach(imageList.size(), [&](size_t i) {
+        const std::string& file = imageList.at(i).first;
+        osg::Image* image = imageList.at(i).second;
+        const std::string& cacheFile = GTextureCache::cachePath(decodeOptions.cacheDirectory, file, decodeOptions.compress);
+        if (GTextureCache::load(cacheFile, image)) {
+            hitList[i] = 1;
+            return;
+        }
+        osgDB::ReaderWriter::ReadResult result = osgDB::Registry::instance()->readImageImplementation(file, readOptions);
+        if (!result.validImage()) {
+            failedList[i] = 1;
+            return;
+        }
+        moveImage(result.getImage(), image);
+        if (GTextureCache::store(cacheFile, image, decodeOptions.compress) && GTextureCache::load(cacheFile, image)) {
+            writeList[i] = 1;
+        }
+    });
+    report.decodeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    report.failed = (unsigned int)std::count(failedList.begin(), failedList.end(), 1);
+    report.cacheHits = (unsigned int)std::count(hitList.begin(), hitList.end(), 1);
+    report.cacheWrites = (unsigned int)std::count(writeList.begin(), writeList.end(), 1);
+    if (node) {
+        GGeometryVisitor geometryVisitor;
+        geometryVisitor.collect(node);
+        for (const auto& stateSet : geometryVisitor.nodeStateSetList()) {
+            report.translucent += fixupStateSet(stateSet) ? 1 : 0;
+        }
+        for (const auto& stateSet : geometryVisitor.drawableStateSetList()) {
+            report.translucent += fixupStateSet(stateSet) ? 1 : 0;
+        }
+    }
+    return report;
+}
+
+};
@@ -0,0 +1,41 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GIMAGELOADER_H
+#define GIMAGELOADER_H
+
+#include <osg/Node>
+#include <osgDB/Options>
+
+namespace GImageLoader {
+
+struct Options {
+    std::string cacheDirectory;
+    bool compress = true;
+};
+
+struct Report {
+    unsigned int images = 0;
+    unsigned int failed = 0;
+    unsigned int cacheHits = 0;
+    unsigned int cacheWrites = 0;
+    unsigned int translucent = 0;
+    unsigned int threads = 0;
+    double decodeTime = 0;
+};
+
+extern void defer(osgDB::Options* options);
+extern Report decode(osgDB::Options* options, osg::Node* node, const Options& decodeOptions = Options());
+
+};
+
+#endif // GIMAGELOADER_H
@@ -0,0 +1,92 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "ginputlatency.h"
+#include <osg/NodeVisitor>
+
+#define INPUT_LATENCY_SAMPLES 2000
+
+class GInputStamp : public osg::Referenced {
+public:
+    explicit GInputStamp(const GInputLatency::TimeList& timeList)
+        : m_timeList(timeList)
+    {
+    }
+    inline const GInputLatency::TimeList& timeList() const { return m_timeList; }
+
+private:
+    GInputLatency::TimeList m_timeList;
+};
+
+static double elapsed(const GInputLatency::Clock::time_point& time, const GInputLatency::Clock::time_point& now)
+{
+    return std::chrono::duration<double, std::milli>(now - time).count();
+}
+
+GInputLatency::GInputLatency()
+    : m_drawStats(INPUT_LATENCY_SAMPLES)
+    , m_swapStats(INPUT_LATENCY_SAMPLES)
+{
+}
+
+void GInputLatency::stamp(osgGA::GUIEventAdapter* event, const TimeList& timeList)
+{
+    if (event && !timeList.empty()) {
+        event->setUserData(new GInputStamp(timeList));
+    }
+}
+
+void GInputLatency::frameDrawn(unsigned int frameNumber)
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    // Frames dropped without a draw hand their input to the next one drawn.
+    auto end = m_frameList.upper_bound(frameNumber);
+    for (auto it = m_frameList.begin(); it != end; ++it) {
+        for (const Clock::time_point& time : it->second) {
+            m_drawStats.addFrame(elapsed(time, now));
+            m_drawnList.push_back(time);
+        }
+    }
+    m_frameList.erase(m_frameList.begin(), end);
+}
+
+void GInputLatency::frameSwapped()
+{
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> locker(m_mutex);
+    for (const Clock::time_point& time : m_drawnList) {
+        m_swapStats.addFrame(elapsed(time, now));
+    }
+    m_drawnList.clear();
+}
+
+void GInputLatency::clear()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_drawStats.clear();
+    m_swapStats.clear();
+}
+
+bool GInputLatency::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa, osg::Object* object, osg::NodeVisitor* nv)
+{
+    (void)aa;
+    (void)object;
+    const GInputStamp* inputStamp = dynamic_cast<const GInputStamp*>(ea.getUserData());
+    if (inputStamp && nv && nv->getFrameStamp()) {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        TimeList& timeList = m_frameList[nv->getFrameStamp()->getFrameNumber()];
+        timeList.insert(timeList.end(), inputStamp->timeList().begin(), inputStamp->timeList().end());
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GINPUTLATENCY_H
+#define GINPUTLATENCY_H
+
+#include "gframestats.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <osgGA/GUIEventHandler>
+#include <vector>
+
+// Follows input timestamps through the event traversal that consumes them
+// to the draw and the swap of that frame.
+class GInputLatency : public osgGA::GUIEventHandler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimeList = std::vector<Clock::time_point>;
+    explicit GInputLatency();
+    static void stamp(osgGA::GUIEventAdapter* event, const TimeList& timeList);
+
+public:
+    inline const GFrameStats& drawStats() const { return m_drawStats; }
+    inline const GFrameStats& swapStats() const { return m_swapStats; }
+    void frameDrawn(unsigned int frameNumber);
+    void frameSwapped();
+    void clear();
+
+public:
+    virtual bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa, osg::Object* object, osg::NodeVisitor* nv) override;
+
+protected:
+    virtual ~GInputLatency() = default;
+
+private:
+    std::map<unsigned int, TimeList> m_frameList;
+    TimeList m_drawnList;
+    GFrameStats m_drawStats;
+    GFrameStats m_swapStats;
+    std::mutex m_mutex;
+};
+
+#endif // GINPUTLATENCY_H
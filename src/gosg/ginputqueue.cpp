@@ -0,0 +1,189 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "ginputqueue.h"
+
+GInputQueue::GInputQueue(osgGA::EventQueue* eventQueue)
+    : m_eventQueue(eventQueue)
+{
+}
+
+void GInputQueue::mouseMotion(float x, float y)
+{
+    // The manipulator takes deltas between positions, the latest position carries them all.
+    Input* input = mergeable(MOTION);
+    if (!input) {
+        input = &append(MOTION);
+    }
+    record(*input);
+    input->x = x;
+    input->y = y;
+}
+
+void GInputQueue::mouseButtonPress(float x, float y, unsigned int button)
+{
+    Input& input = record(append(PRESS));
+    input.x = x;
+    input.y = y;
+    input.value = (int)button;
+}
+
+void GInputQueue::mouseButtonRelease(float x, float y, unsigned int button)
+{
+    Input& input = record(append(RELEASE));
+    input.x = x;
+    input.y = y;
+    input.value = (int)button;
+}
+
+void GInputQueue::mouseDoubleButtonPress(float x, float y, unsigned int button)
+{
+    Input& input = record(append(DOUBLE_PRESS));
+    input.x = x;
+    input.y = y;
+    input.value = (int)button;
+}
+
+void GInputQueue::mouseScroll(osgGA::GUIEventAdapter::ScrollingMotion motion)
+{
+    Input* input = mergeable(SCROLL);
+    if (input && input->value == (int)motion) {
+        record(*input).steps++;
+        return;
+    }
+    record(append(SCROLL)).value = (int)motion;
+}
+
+void GInputQueue::touch(const std::vector<TouchPoint>& touchPoints)
+{
+    if (touchPoints.empty()) {
+        return;
+    }
+    auto allMoved = [](const std::vector<TouchPoint>& points) {
+        for (const TouchPoint& point : points) {
+            if (point.phase != osgGA::GUIEventAdapter::TOUCH_MOVED) {
+                return false;
+            }
+        }
+        return true;
+    };
+    Input* input = mergeable(TOUCH);
+    if (input && input->touchPoints.size() == touchPoints.size() && allMoved(input->touchPoints) && allMoved(touchPoints)) {
+        bool sameIds = true;
+        for (size_t i = 0; i < touchPoints.size(); i++) {
+            sameIds = sameIds && input->touchPoints[i].id == touchPoints[i].id;
+        }
+        if (sameIds) {
+            record(*input).touchPoints = touchPoints;
+            return;
+        }
+    }
+    record(append(TOUCH)).touchPoints = touchPoints;
+}
+
+void GInputQueue::keyPress(int key)
+{
+    record(append(KEY_PRESS)).value = key;
+}
+
+void GInputQueue::keyRelease(int key)
+{
+    record(append(KEY_RELEASE)).value = key;
+}
+
+unsigned int GInputQueue::flush()
+{
+    if (!m_eventQueue) {
+        return 0;
+    }
+    unsigned int count = 0;
+    for (const Input& input : m_inputList) {
+        m_eventQueue->getCurrentEventState()->setModKeyMask(input.modKeyMask);
+        osgGA::GUIEventAdapter* event = nullptr;
+        switch (input.type) {
+        case MOTION:
+            event = m_eventQueue->mouseMotion(input.x, input.y);
+            break;
+        case PRESS:
+            event = m_eventQueue->mouseButtonPress(input.x, input.y, (unsigned int)input.value);
+            break;
+        case RELEASE:
+            event = m_eventQueue->mouseButtonRelease(input.x, input.y, (unsigned int)input.value);
+            break;
+        case DOUBLE_PRESS:
+            event = m_eventQueue->mouseDoubleButtonPress(input.x, input.y, (unsigned int)input.value);
+            break;
+        case SCROLL:
+            event = m_eventQueue->mouseScroll((osgGA::GUIEventAdapter::ScrollingMotion)input.value);
+            // Merged wheel steps, GManipulator zooms once per step.
+            if (input.value == osgGA::GUIEventAdapter::SCROLL_LEFT || input.value == osgGA::GUIEventAdapter::SCROLL_RIGHT) {
+                event->setScrollingDeltaX((float)input.steps);
+            } else {
+                event->setScrollingDeltaY((float)input.steps);
+            }
+            break;
+        case TOUCH:
+            for (const TouchPoint& point : input.touchPoints) {
+                if (event) {
+                    event->addTouchPoint(point.id, point.phase, point.x, point.y);
+                } else if (point.phase == osgGA::GUIEventAdapter::TOUCH_BEGAN) {
+                    event = m_eventQueue->touchBegan(point.id, point.phase, point.x, point.y);
+                } else if (point.phase == osgGA::GUIEventAdapter::TOUCH_ENDED) {
+                    event = m_eventQueue->touchEnded(point.id, point.phase, point.x, point.y, 1);
+                } else {
+                    event = m_eventQueue->touchMoved(point.id, point.phase, point.x, point.y);
+                }
+            }
+            break;
+        case KEY_PRESS:
+            event = m_eventQueue->keyPress(input.value);
+            break;
+        case KEY_RELEASE:
+            event = m_eventQueue->keyRelease(input.value);
+            break;
+        }
+        if (event) {
+            GInputLatency::stamp(event, input.timeList);
+            count++;
+        }
+    }
+    m_eventQueue->getCurrentEventState()->setModKeyMask(m_modKeyMask);
+    m_inputList.clear();
+    m_deliveredEvents += count;
+    return count;
+}
+
+GInputQueue::Input& GInputQueue::append(Type type)
+{
+    m_inputList.emplace_back();
+    Input& input = m_inputList.back();
+    input.type = type;
+    input.modKeyMask = m_modKeyMask;
+    return input;
+}
+
+GInputQueue::Input& GInputQueue::record(Input& input)
+{
+    m_rawEvents++;
+    input.timeList.push_back(GInputLatency::Clock::now());
+    return input;
+}
+
+GInputQueue::Input* GInputQueue::mergeable(Type type)
+{
+    // Only the newest input merges, anything in between keeps its order.
+    if (m_inputList.empty() || m_inputList.back().type != type || m_inputList.back().modKeyMask != m_modKeyMask) {
+        return nullptr;
+    }
+    return &m_inputList.back();
+}
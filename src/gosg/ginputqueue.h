@@ -0,0 +1,82 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GINPUTQUEUE_H
+#define GINPUTQUEUE_H
+
+#include "ginputlatency.h"
+#include <osgGA/EventQueue>
+#include <vector>
+
+// Collects input between frames and merges runs of motion, scroll and touch
+// moves before they reach the OSG event queue. Filled on the GUI thread and
+// flushed by the renderer's synchronize while the GUI thread waits.
+class GInputQueue {
+public:
+    struct TouchPoint {
+        unsigned int id = 0;
+        osgGA::GUIEventAdapter::TouchPhase phase = osgGA::GUIEventAdapter::TOUCH_UNKNOWN;
+        float x = 0;
+        float y = 0;
+    };
+    explicit GInputQueue(osgGA::EventQueue* eventQueue = nullptr);
+
+public:
+    inline void setEventQueue(osgGA::EventQueue* eventQueue) { m_eventQueue = eventQueue; }
+    inline unsigned long long rawEvents() const { return m_rawEvents; }
+    inline unsigned long long deliveredEvents() const { return m_deliveredEvents; }
+    inline void setModKeyMask(unsigned int modKeyMask) { m_modKeyMask = modKeyMask; }
+    void mouseMotion(float x, float y);
+    void mouseButtonPress(float x, float y, unsigned int button);
+    void mouseButtonRelease(float x, float y, unsigned int button);
+    void mouseDoubleButtonPress(float x, float y, unsigned int button);
+    void mouseScroll(osgGA::GUIEventAdapter::ScrollingMotion motion);
+    void touch(const std::vector<TouchPoint>& touchPoints);
+    void keyPress(int key);
+    void keyRelease(int key);
+    unsigned int flush();
+
+private:
+    enum Type {
+        MOTION,
+        PRESS,
+        RELEASE,
+        DOUBLE_PRESS,
+        SCROLL,
+        TOUCH,
+        KEY_PRESS,
+        KEY_RELEASE,
+    };
+    struct Input {
+        Type type = MOTION;
+        unsigned int modKeyMask = 0;
+        float x = 0;
+        float y = 0;
+        int value = 0;
+        unsigned int steps = 1;
+        std::vector<TouchPoint> touchPoints;
+        GInputLatency::TimeList timeList;
+    };
+    Input& append(Type type);
+    Input* mergeable(Type type);
+    Input& record(Input& input);
+
+private:
+    osgGA::EventQueue* m_eventQueue = nullptr;
+    std::vector<Input> m_inputList;
+    unsigned int m_modKeyMask = 0;
+    unsigned long long m_rawEvents = 0;
+    unsigned long long m_deliveredEvents = 0;
+};
+
+#endif // GINPUTQUEUE_H
@@ -12,6 +12,8 @@
 
 #include "gmanipulator.h"
 #include "gcommon.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #define FIRST_CONTROLPOINT_TIME 1
@@ -79,6 +81,12 @@ bool GManipulator::stopFly()
     return true;
 }
 
+void GManipulator::setCameraMatrix(const osg::Matrixd& matrix)
+{
+    m_matrix = matrix;
+    setByMatrix(m_matrix);
+}
+
 void GManipulator::setByMatrix(const osg::Matrixd& matrix)
 {
     _center = osg::Vec3d(0, 0, -_distance) * matrix;
@@ -94,8 +102,8 @@ void GManipulator::home(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapte
 
 bool GManipulator::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us)
 {
-    osgViewer::Viewer* viewer = dynamic_cast<osgViewer::Viewer*>(&us);
     if (ea.getEventType() == osgGA::GUIEventAdapter::DOUBLECLICK) {
+        osgViewer::Viewer* viewer = dynamic_cast<osgViewer::Viewer*>(&us);
         if (viewer) {
             osgUtil::LineSegmentIntersector::Intersections intersections;
             viewer->computeIntersections(ea.getX(), ea.getY(), intersections);
@@ -115,6 +123,8 @@ bool GManipulator::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdap
         _rotation = oldRotation;
         _distance = oldDistance;
     }
+    // Published for the GUI thread, which must not read the event traversal's state.
+    m_moving = m_flyIndex >= 0 || _thrown;
     return reval;
 }
 
@@ -147,6 +157,20 @@ bool GManipulator::handleKeyDown(const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
     return osgGA::OrbitManipulator::handleKeyDown(ea, us);
 }
 
+bool GManipulator::handleMouseWheel(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us)
+{
+    // Coalesced wheel events carry their step count in the scrolling delta.
+    int steps = 1;
+    if (ea.getScrollingMotion() != osgGA::GUIEventAdapter::SCROLL_2D) {
+        steps = std::max(1, (int)std::lround(std::fabs(ea.getScrollingDeltaX()) + std::fabs(ea.getScrollingDeltaY())));
+    }
+    bool reval = false;
+    for (int i = 0; i < steps; i++) {
+        reval = osgGA::OrbitManipulator::handleMouseWheel(ea, us) || reval;
+    }
+    return reval;
+}
+
 bool GManipulator::performMovementLeftMouseButton(const double eventTimeDelta, const double dx, const double dy)
 {
     float scale = -0.3f * _distance * getThrowScale(eventTimeDelta);
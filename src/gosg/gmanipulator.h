@@ -13,6 +13,7 @@
 #ifndef GMANIPULATOR_H
 #define GMANIPULATOR_H
 
+#include <atomic>
 #include <osg/AnimationPath>
 #include <osgGA/OrbitManipulator>
 #include <osgViewer/Viewer>
@@ -27,12 +28,15 @@ public:
     inline std::vector<osg::ref_ptr<osg::AnimationPath>> flyList() { return m_flyList; }
     inline void setFlyList(const std::vector<osg::ref_ptr<osg::AnimationPath>>& flyList) { m_flyList = flyList; }
     inline int flyIndex() const { return m_flyIndex; }
+    inline bool isMoving() const { return m_moving; }
+    inline osg::Matrixd cameraMatrix() const { return m_matrix; }
     inline void setFlyFinishedCallback(const FlyCompletedCallback& callback) { m_flyFinishedCallback = callback; }
     void setLimit(double maxPosition, double maxDistance, double minDistance);
     std::tuple<osg::Vec3d, osg::Vec3d, osg::Vec3d> getHomePoint() const;
     std::tuple<osg::Vec3d, osg::Quat, osg::Vec3d> getFlyPoint() const;
     bool playFly(int index);
     bool stopFly();
+    void setCameraMatrix(const osg::Matrixd& matrix);
 
 protected:
     inline void setByInverseMatrix(const osg::Matrixd& matrix) override { setByMatrix(osg::Matrixd::inverse(matrix)); }
@@ -43,6 +47,7 @@ protected:
     bool handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us) override;
     bool handleFrame(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us) override;
     virtual bool handleKeyDown(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us) override;
+    virtual bool handleMouseWheel(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& us) override;
     virtual bool performMovementLeftMouseButton(const double eventTimeDelta, const double dx, const double dy) override;
     virtual bool performMovementMiddleMouseButton(const double eventTimeDelta, const double dx, const double dy) override;
     virtual bool performMovementRightMouseButton(const double eventTimeDelta, const double dx, const double dy) override;
@@ -57,6 +62,7 @@ private:
     osg::Matrixd m_matrix;
     FlyCompletedCallback m_flyFinishedCallback = nullptr;
     int m_flyIndex = -1;
+    std::atomic<bool> m_moving { false };
     int m_timeNum = -1;
     double m_eaTime = 0;
     double m_timeOffset = 0;
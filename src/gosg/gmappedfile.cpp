@@ -0,0 +1,86 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gmappedfile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+osg::ref_ptr<GMappedFile> GMappedFile::open(const std::string& path)
+{
+    osg::ref_ptr<GMappedFile> file = new GMappedFile;
+    // Pages are mapped copy-on-write so a stray write never reaches the cache on disk.
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    file->m_file = handle;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        return nullptr;
+    }
+    file->m_size = (size_t)size.QuadPart;
+    file->m_mapping = CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (!file->m_mapping) {
+        return nullptr;
+    }
+    file->m_data = static_cast<unsigned char*>(MapViewOfFile(file->m_mapping, FILE_MAP_COPY, 0, 0, 0));
+#else
+    file->m_fd = ::open(path.c_str(), O_RDONLY);
+    if (file->m_fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(file->m_fd, &info) != 0 || info.st_size == 0) {
+        return nullptr;
+    }
+    file->m_size = (size_t)info.st_size;
+    void* data = mmap(nullptr, file->m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file->m_fd, 0);
+    file->m_data = data == MAP_FAILED ? nullptr : static_cast<unsigned char*>(data);
+#endif
+    if (!file->m_data) {
+        return nullptr;
+    }
+    return file;
+}
+
+GMappedFile::~GMappedFile()
+{
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file) {
+        CloseHandle(m_file);
+    }
+#else
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#endif
+}
@@ -0,0 +1,41 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GMAPPEDFILE_H
+#define GMAPPEDFILE_H
+
+#include <osg/Referenced>
+#include <osg/ref_ptr>
+#include <string>
+
+class GMappedFile : public osg::Referenced {
+public:
+    static osg::ref_ptr<GMappedFile> open(const std::string& path);
+    inline unsigned char* data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+
+protected:
+    GMappedFile() = default;
+    virtual ~GMappedFile();
+
+private:
+    unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+
+#endif // GMAPPEDFILE_H
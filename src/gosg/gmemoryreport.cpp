@@ -0,0 +1,331 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gmemoryreport.h"
+#include "gnodevisitor.h"
+#include <QJsonArray>
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <osg/Geode>
+#include <osg/MatrixTransform>
+#include <osg/Texture>
+#include <osgAnimation/AnimationManagerBase>
+#include <osgAnimation/Channel>
+#include <set>
+
+namespace GMemoryReport {
+
+enum Category {
+    VertexArrays = 0,
+    IndexArrays,
+    Images,
+    Textures,
+    AnimationChannels,
+    Nodes,
+    StateSets,
+    CategoryCount
+};
+
+static const char* const s_categoryNames[CategoryCount] = {
+    "vertexArrays",
+    "indexArrays",
+    "images",
+    "textures",
+    "animationChannels",
+    "nodes",
+    "stateSets",
+};
+
+using Bytes = std::array<unsigned long long, CategoryCount>;
+
+struct Part {
+    std::string name;
+    std::string className;
+    Bytes self {};
+    Bytes total {};
+    std::vector<std::unique_ptr<Part>> children;
+};
+
+template <typename T>
+static bool keyframeBytes(const osgAnimation::KeyframeContainer* container, unsigned long long& bytes)
+{
+    const T* typed = dynamic_cast<const T*>(container);
+    if (typed) {
+        bytes = container->size() * sizeof(typename T::value_type);
+    }
+    return typed != nullptr;
+}
+
+static unsigned long long channelBytes(const osgAnimation::Channel* channel)
+{
+    const osgAnimation::Sampler* sampler = channel->getSampler();
+    const osgAnimation::KeyframeContainer* container = sampler ? const_cast<osgAnimation::Sampler*>(sampler)->getKeyframeContainer() : nullptr;
+    unsigned long long bytes = 0;
+    if (!container) {
+        return bytes;
+    }
+    keyframeBytes<osgAnimation::FloatKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::DoubleKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec2KeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec3KeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec4KeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::QuatKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::MatrixKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec3PackedKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::FloatCubicBezierKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::DoubleCubicBezierKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec2CubicBezierKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec3CubicBezierKeyframeContainer>(container, bytes)
+        || keyframeBytes<osgAnimation::Vec4CubicBezierKeyframeContainer>(container, bytes);
+    return bytes;
+}
+
+static unsigned long long nodeBytes(const osg::Node& node)
+{
+    if (node.asDrawable()) {
+        return sizeof(osg::Geometry);
+    } else if (node.asTransform()) {
+        return sizeof(osg::MatrixTransform);
+    } else if (node.asGeode()) {
+        return sizeof(osg::Geode);
+    } else if (node.asGroup()) {
+        return sizeof(osg::Group) + node.asGroup()->getNumChildren() * sizeof(osg::ref_ptr<osg::Node>);
+    }
+    return sizeof(osg::Node);
+}
+
+class GMemoryVisitor : public osg::NodeVisitor {
+public:
+    explicit GMemoryVisitor(Part* root)
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+        , m_part(root)
+    {
+    }
+    inline unsigned int count(const std::string& name) const
+    {
+        auto it = m_countList.find(name);
+        return it == m_countList.end() ? 0 : it->second;
+    }
+    inline unsigned int sharedCount() const { return m_sharedCount; }
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        Part* parent = m_part;
+        if (!node.getName().empty() && getNodePath().size() > 1) {
+            std::unique_ptr<Part> part(new Part);
+            part->name = node.getName();
+            part->className = node.className();
+            m_part->children.push_back(std::move(part));
+            m_part = m_part->children.back().get();
+        }
+        if (first(&node)) {
+            m_part->self[Nodes] += nodeBytes(node);
+            m_countList["nodes"]++;
+            addStateSet(node.getStateSet());
+            addAnimations(node.getUpdateCallback());
+            osg::Geometry* geometry = node.asGeometry();
+            if (geometry) {
+                addGeometry(*geometry);
+            }
+        }
+        traverse(node);
+        m_part = parent;
+    }
+
+private:
+    bool first(const osg::Referenced* object)
+    {
+        if (!object) {
+            return false;
+        }
+        if (m_seen.insert(object).second) {
+            return true;
+        }
+        m_sharedCount++;
+        return false;
+    }
+    void addGeometry(const osg::Geometry& geometry)
+    {
+        m_countList["geometries"]++;
+        GGeometryVisitor::forEachArray(geometry, [this](const osg::Array* array) {
+            if (first(array)) {
+                m_part->self[VertexArrays] += array->getTotalDataSize();
+                m_countList["arrays"]++;
+            }
+        });
+        for (unsigned int i = 0; i < geometry.getNumPrimitiveSets(); i++) {
+            const osg::PrimitiveSet* primitiveSet = geometry.getPrimitiveSet(i);
+            if (first(primitiveSet)) {
+                const osg::DrawElements* elements = primitiveSet->getDrawElements();
+                m_part->self[IndexArrays] += elements ? elements->getTotalDataSize() : sizeof(osg::DrawArrays);
+                m_countList["primitiveSets"]++;
+            }
+        }
+    }
+    void addStateSet(const osg::StateSet* stateSet)
+    {
+        if (!first(stateSet)) {
+            return;
+        }
+        m_countList["stateSets"]++;
+        m_part->self[StateSets] += sizeof(osg::StateSet) + stateSet->getModeList().size() * sizeof(osg::StateSet::ModeList::value_type);
+        for (const auto& attribute : stateSet->getAttributeList()) {
+            if (first(attribute.second.first.get())) {
+                m_part->self[StateSets] += sizeof(osg::StateAttribute);
+            }
+        }
+        for (const auto& unit : stateSet->getTextureAttributeList()) {
+            for (const auto& attribute : unit) {
+                const osg::Texture* texture = attribute.second.first->asTexture();
+                if (!first(attribute.second.first.get())) {
+                    continue;
+                }
+                if (!texture) {
+                    m_part->self[StateSets] += sizeof(osg::StateAttribute);
+                    continue;
+                }
+                addTexture(*texture);
+            }
+        }
+    }
+    void addTexture(const osg::Texture& texture)
+    {
+        m_countList["textures"]++;
+        unsigned long long gpuBytes = 0;
+        for (unsigned int i = 0; i < texture.getNumImages(); i++) {
+            const osg::Image* image = texture.getImage(i);
+            if (!image) {
+                continue;
+            }
+            unsigned long long imageBytes = image->data() ? image->getTotalSizeInBytesIncludingMipmaps() : 0;
+            gpuBytes += imageBytes;
+            if (first(image) && imageBytes > 0) {
+                m_part->self[Images] += imageBytes;
+                m_countList["images"]++;
+            }
+        }
+        if (gpuBytes == 0 && texture.getTextureWidth() > 0) {
+            // The CPU copy was released after upload, estimate RGBA8 with a full mip chain.
+            gpuBytes = (unsigned long long)texture.getTextureWidth() * std::max(1, texture.getTextureHeight()) * std::max(1, texture.getTextureDepth()) * 4 * 4 / 3;
+        }
+        m_part->self[Textures] += gpuBytes;
+    }
+    void addAnimations(const osg::Callback* callback)
+    {
+        for (; callback; callback = callback->getNestedCallback()) {
+            const osgAnimation::AnimationManagerBase* manager = dynamic_cast<const osgAnimation::AnimationManagerBase*>(callback);
+            if (!manager) {
+                continue;
+            }
+            for (const auto& animation : manager->getAnimationList()) {
+                if (!first(animation.get())) {
+                    continue;
+                }
+                m_countList["animations"]++;
+                for (const auto& channel : animation->getChannels()) {
+                    if (first(channel.get())) {
+                        m_part->self[AnimationChannels] += channelBytes(channel);
+                        m_countList["channels"]++;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    Part* m_part = nullptr;
+    std::set<const osg::Referenced*> m_seen;
+    std::map<std::string, unsigned int> m_countList;
+    unsigned int m_sharedCount = 0;
+};
+
+static unsigned long long sum(const Bytes& bytes)
+{
+    unsigned long long total = 0;
+    for (unsigned long long value : bytes) {
+        total += value;
+    }
+    return total;
+}
+
+static void accumulate(Part& part)
+{
+    part.total = part.self;
+    for (auto& child : part.children) {
+        accumulate(*child);
+        for (int i = 0; i < CategoryCount; i++) {
+            part.total[i] += child->total[i];
+        }
+    }
+}
+
+static QJsonObject toJson(const Bytes& bytes)
+{
+    QJsonObject object;
+    for (int i = 0; i < CategoryCount; i++) {
+        object.insert(s_categoryNames[i], (double)bytes[i]);
+    }
+    object.insert("total", (double)sum(bytes));
+    return object;
+}
+
+static QJsonObject toJson(Part& part)
+{
+    std::sort(part.children.begin(), part.children.end(), [](const std::unique_ptr<Part>& a, const std::unique_ptr<Part>& b) {
+        return sum(a->total) > sum(b->total);
+    });
+    QJsonObject object;
+    object.insert("name", QString::fromStdString(part.name));
+    object.insert("class", QString::fromStdString(part.className));
+    object.insert("self", toJson(part.self));
+    object.insert("total", toJson(part.total));
+    QJsonArray children;
+    for (auto& child : part.children) {
+        // Subtrees that own nothing are noise in a memory report.
+        if (sum(child->total) > 0) {
+            children.append(toJson(*child));
+        }
+    }
+    if (!children.isEmpty()) {
+        object.insert("children", children);
+    }
+    return object;
+}
+
+QJsonObject create(osg::Node* node)
+{
+    QJsonObject report;
+    if (!node) {
+        return report;
+    }
+    Part root;
+    root.name = node->getName();
+    root.className = node->className();
+    GMemoryVisitor visitor(&root);
+    node->accept(visitor);
+    accumulate(root);
+    QJsonObject counts;
+    for (const char* name : { "nodes", "geometries", "arrays", "primitiveSets", "stateSets", "textures", "images", "animations", "channels" }) {
+        counts.insert(name, (int)visitor.count(name));
+    }
+    counts.insert("shared", (int)visitor.sharedCount());
+    report.insert("version", 1);
+    report.insert("totals", toJson(root.total));
+    report.insert("counts", counts);
+    report.insert("root", toJson(root));
+    return report;
+}
+
+};
@@ -0,0 +1,25 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GMEMORYREPORT_H
+#define GMEMORYREPORT_H
+
+#include <QJsonObject>
+#include <osg/Node>
+
+namespace GMemoryReport {
+
+extern QJsonObject create(osg::Node* node);
+
+};
+
+#endif // GMEMORYREPORT_H
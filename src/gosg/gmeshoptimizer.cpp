@@ -0,0 +1,373 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gmeshoptimizer.h"
+#include "gnodevisitor.h"
+#include "gparallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#define SCORE_CACHE_SIZE 32
+#define MIN_CLUSTER_SIZE 32
+
+namespace GMeshOptimizer {
+
+static unsigned int countCacheMisses(const std::vector<unsigned int>& indices, unsigned int cacheSize, std::vector<unsigned char>* triangleMisses = nullptr)
+{
+    unsigned int maxIndex = 0;
+    for (unsigned int index : indices) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    std::vector<unsigned int> stamps(indices.empty() ? 0 : maxIndex + 1, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+    for (size_t i = 0; i < indices.size(); i++) {
+        unsigned int index = indices[i];
+        bool miss = time - stamps[index] > cacheSize;
+        if (miss) {
+            stamps[index] = time++;
+            misses++;
+        }
+        if (triangleMisses) {
+            if (i % 3 == 0) {
+                triangleMisses->push_back(0);
+            }
+            triangleMisses->back() += miss ? 1 : 0;
+        }
+    }
+    return misses;
+}
+
+double computeAcmr(const std::vector<unsigned int>& indices, unsigned int cacheSize)
+{
+    if (indices.size() < 3) {
+        return 0;
+    }
+    return (double)countCacheMisses(indices, cacheSize) / (double)(indices.size() / 3);
+}
+
+static float vertexScore(int cachePosition, unsigned int remaining)
+{
+    if (remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f;
+        } else {
+            score = std::pow(1.0f - (float)(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+    return score + 2.0f * std::pow((float)remaining, -0.5f);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation.
+static std::vector<unsigned int> optimizeTriangleOrder(const std::vector<unsigned int>& indices, unsigned int numVertices)
+{
+    size_t numTriangles = indices.size() / 3;
+    std::vector<unsigned int> remaining(numVertices, 0);
+    for (unsigned int index : indices) {
+        remaining[index]++;
+    }
+    std::vector<unsigned int> offsets(numVertices + 1, 0);
+    for (unsigned int v = 0; v < numVertices; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[cursor[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    }
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> scores(numVertices);
+    for (unsigned int v = 0; v < numVertices; v++) {
+        scores[v] = vertexScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScores(numTriangles);
+    std::vector<char> emitted(numTriangles, 0);
+    int best = -1;
+    float bestScore = -1;
+    for (size_t t = 0; t < numTriangles; t++) {
+        triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+        if (triangleScores[t] > bestScore) {
+            bestScore = triangleScores[t];
+            best = (int)t;
+        }
+    }
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    size_t scanCursor = 0;
+    for (size_t n = 0; n < numTriangles; n++) {
+        if (best < 0) {
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            best = (int)scanCursor;
+        }
+        emitted[best] = 1;
+        newCache.clear();
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[best * 3 + k];
+            result.push_back(v);
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            unsigned int* it = std::find(begin, end, (unsigned int)best);
+            if (it != end) {
+                *it = *(end - 1);
+                remaining[v]--;
+            }
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+                newCache.push_back(v);
+            }
+        }
+        size_t triangleVertices = newCache.size();
+        for (unsigned int v : cache) {
+            if (std::find(newCache.begin(), newCache.begin() + triangleVertices, v) == newCache.begin() + triangleVertices) {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < newCache.size(); i++) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < SCORE_CACHE_SIZE ? (int)i : -1;
+            scores[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        bestScore = -1;
+        for (unsigned int v : newCache) {
+            for (unsigned int i = offsets[v]; i < offsets[v] + remaining[v]; i++) {
+                unsigned int t = adjacency[i];
+                triangleScores[t] = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] + scores[indices[t * 3 + 2]];
+                if (cachePosition[v] >= 0 && triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = (int)t;
+                }
+            }
+        }
+        if (newCache.size() > SCORE_CACHE_SIZE) {
+            newCache.resize(SCORE_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+    }
+    return result;
+}
+
+// Splits the cache-optimised order into clusters at cache restarts and draws outward-facing clusters first.
+static std::vector<unsigned int> sortClusters(const std::vector<unsigned int>& indices, const osg::Vec3Array& positions, unsigned int cacheSize, double threshold)
+{
+    std::vector<unsigned char> triangleMisses;
+    unsigned int misses = countCacheMisses(indices, cacheSize, &triangleMisses);
+    std::vector<size_t> starts;
+    for (size_t t = 0; t < triangleMisses.size(); t++) {
+        if (starts.empty() || (triangleMisses[t] == 3 && t - starts.back() >= MIN_CLUSTER_SIZE)) {
+            starts.push_back(t);
+        }
+    }
+    if (starts.size() < 2) {
+        return indices;
+    }
+    osg::Vec3d meshCenter;
+    for (unsigned int index : indices) {
+        meshCenter += positions[index];
+    }
+    meshCenter /= (double)indices.size();
+    std::vector<std::pair<double, size_t>> keys;
+    for (size_t c = 0; c < starts.size(); c++) {
+        size_t end = c + 1 < starts.size() ? starts[c + 1] : triangleMisses.size();
+        osg::Vec3d center;
+        osg::Vec3d normal;
+        for (size_t t = starts[c]; t < end; t++) {
+            const osg::Vec3& a = positions[indices[t * 3]];
+            const osg::Vec3& b = positions[indices[t * 3 + 1]];
+            const osg::Vec3& c3 = positions[indices[t * 3 + 2]];
+            center += osg::Vec3d(a + b + c3) / 3.0;
+            normal += osg::Vec3d((b - a) ^ (c3 - a));
+        }
+        center /= (double)(end - starts[c]);
+        normal.normalize();
+        keys.emplace_back((center - meshCenter) * normal, c);
+    }
+    std::stable_sort(keys.begin(), keys.end(), [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+        return a.first > b.first;
+    });
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const auto& key : keys) {
+        size_t end = key.second + 1 < starts.size() ? starts[key.second + 1] : triangleMisses.size();
+        result.insert(result.end(), indices.begin() + starts[key.second] * 3, indices.begin() + end * 3);
+    }
+    if (countCacheMisses(result, cacheSize) > misses * threshold) {
+        return indices;
+    }
+    return result;
+}
+
+static bool canReorderVertices(const osg::Geometry* geometry, unsigned int numVertices)
+{
+    bool ok = true;
+    GGeometryVisitor::forEachArray(*geometry, [&ok, numVertices](const osg::Array* array) {
+        if (array->referenceCount() > 1) {
+            ok = false;
+        } else if (array->getBinding() == osg::Array::BIND_PER_VERTEX || array->getBinding() == osg::Array::BIND_UNDEFINED) {
+            ok = ok && array->getNumElements() == numVertices;
+        } else if (array->getBinding() != osg::Array::BIND_OVERALL && array->getBinding() != osg::Array::BIND_OFF) {
+            ok = false;
+        }
+    });
+    for (unsigned int i = 0; ok && i < geometry->getNumPrimitiveSets(); i++) {
+        const osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+        if (!primitiveSet->getDrawElements() || primitiveSet->referenceCount() > 1) {
+            ok = false;
+        } else if (primitiveSet->getType() == osg::PrimitiveSet::DrawElementsUBytePrimitiveType) {
+            ok = numVertices <= 256;
+        } else if (primitiveSet->getType() == osg::PrimitiveSet::DrawElementsUShortPrimitiveType) {
+            ok = numVertices <= 65536;
+        }
+    }
+    return ok;
+}
+
+static void reorderVertices(osg::Geometry* geometry, unsigned int numVertices)
+{
+    std::vector<unsigned int> remap(numVertices, ~0u);
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); i++) {
+        osg::DrawElements* elements = geometry->getPrimitiveSet(i)->getDrawElements();
+        for (unsigned int j = 0; j < elements->getNumIndices(); j++) {
+            unsigned int index = elements->index(j);
+            if (index < numVertices && remap[index] == ~0u) {
+                remap[index] = next++;
+            }
+        }
+    }
+    for (unsigned int v = 0; v < numVertices; v++) {
+        if (remap[v] == ~0u) {
+            remap[v] = next++;
+        }
+    }
+    GGeometryVisitor::replaceArrays(*geometry, [&remap, numVertices](osg::Array* array) -> osg::Array* {
+        if (array->getNumElements() != numVertices || array->getBinding() == osg::Array::BIND_OVERALL) {
+            return array;
+        }
+        osg::ref_ptr<osg::Array> reordered = static_cast<osg::Array*>(array->clone(osg::CopyOp::DEEP_COPY_ALL));
+        unsigned int elementSize = array->getElementSize();
+        const unsigned char* src = static_cast<const unsigned char*>(array->getDataPointer());
+        unsigned char* dst = static_cast<unsigned char*>(const_cast<GLvoid*>(reordered->getDataPointer()));
+        for (unsigned int v = 0; v < numVertices; v++) {
+            std::memcpy(dst + remap[v] * elementSize, src + v * elementSize, elementSize);
+        }
+        return reordered.release();
+    });
+    for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); i++) {
+        osg::DrawElements* elements = geometry->getPrimitiveSet(i)->getDrawElements();
+        for (unsigned int j = 0; j < elements->getNumIndices(); j++) {
+            elements->setElement(j, remap[elements->index(j)]);
+        }
+        elements->dirty();
+    }
+}
+
+struct GeometryResult {
+    unsigned long long triangles = 0;
+    unsigned long long missesBefore = 0;
+    unsigned long long missesAfter = 0;
+};
+
+static GeometryResult optimizeGeometry(osg::Geometry* geometry, const Options& options)
+{
+    GeometryResult result;
+    const osg::Array* vertices = geometry->getVertexArray();
+    if (!vertices) {
+        return result;
+    }
+    unsigned int numVertices = vertices->getNumElements();
+    const osg::Vec3Array* positions = dynamic_cast<const osg::Vec3Array*>(vertices);
+    for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); i++) {
+        osg::DrawElements* elements = geometry->getPrimitiveSet(i)->getDrawElements();
+        if (!elements || elements->getMode() != GL_TRIANGLES || elements->getNumIndices() < 3 || elements->referenceCount() > 1) {
+            continue;
+        }
+        std::vector<unsigned int> indices(elements->getNumIndices() / 3 * 3);
+        bool valid = true;
+        for (unsigned int j = 0; j < indices.size(); j++) {
+            indices[j] = elements->index(j);
+            valid = valid && indices[j] < numVertices;
+        }
+        if (!valid) {
+            continue;
+        }
+        unsigned int before = countCacheMisses(indices, options.cacheSize);
+        std::vector<unsigned int> optimized = optimizeTriangleOrder(indices, numVertices);
+        if (options.reduceOverdraw && positions) {
+            optimized = sortClusters(optimized, *positions, options.cacheSize, options.overdrawThreshold);
+        }
+        unsigned int after = countCacheMisses(optimized, options.cacheSize);
+        if (after > before && !options.reduceOverdraw) {
+            optimized.swap(indices);
+            after = before;
+        }
+        for (unsigned int j = 0; j < optimized.size(); j++) {
+            elements->setElement(j, optimized[j]);
+        }
+        elements->dirty();
+        result.triangles += indices.size() / 3;
+        result.missesBefore += before;
+        result.missesAfter += after;
+    }
+    if (options.reorderVertices && result.triangles > 0 && canReorderVertices(geometry, numVertices)) {
+        reorderVertices(geometry, numVertices);
+    }
+    return result;
+}
+
+Report optimize(osg::Node* node, const Options& options)
+{
+    Report report;
+    if (!node) {
+        return report;
+    }
+    GGeometryVisitor geometryVisitor;
+    geometryVisitor.collect(node);
+    std::vector<osg::Geometry*> geometryList;
+    for (const auto& geometry : geometryVisitor.geometryList()) {
+        if (GGeometryVisitor::isPlainGeometry(geometry)) {
+            geometryList.push_back(geometry);
+        }
+    }
+    std::vector<GeometryResult> results(geometryList.size());
+    GParallel::forEach(geometryList.size(), [&](size_t i) {
+        results[i] = optimizeGeometry(geometryList[i], options);
+    });
+    unsigned long long missesBefore = 0;
+    unsigned long long missesAfter = 0;
+    for (const auto& result : results) {
+        if (result.triangles > 0) {
+            report.geometries++;
+        }
+        report.triangles += result.triangles;
+        missesBefore += result.missesBefore;
+        missesAfter += result.missesAfter;
+    }
+    if (report.triangles > 0) {
+        report.acmrBefore = (double)missesBefore / (double)report.triangles;
+        report.acmrAfter = (double)missesAfter / (double)report.triangles;
+    }
+    return report;
+}
+
+};
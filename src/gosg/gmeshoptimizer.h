@@ -0,0 +1,40 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GMESHOPTIMIZER_H
+#define GMESHOPTIMIZER_H
+
+#include <osg/Node>
+#include <vector>
+
+namespace GMeshOptimizer {
+
+struct Options {
+    unsigned int cacheSize = 16;
+    bool reorderVertices = true;
+    bool reduceOverdraw = false;
+    double overdrawThreshold = 1.05;
+};
+
+struct Report {
+    unsigned int geometries = 0;
+    unsigned long long triangles = 0;
+    double acmrBefore = 0;
+    double acmrAfter = 0;
+};
+
+extern double computeAcmr(const std::vector<unsigned int>& indices, unsigned int cacheSize);
+extern Report optimize(osg::Node* node, const Options& options = Options());
+
+};
+
+#endif // GMESHOPTIMIZER_H
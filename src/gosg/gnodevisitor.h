@@ -13,8 +13,12 @@
 #ifndef GNODEVISITOR_H
 #define GNODEVISITOR_H
 
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <osg/Geometry>
 #include <osg/NodeVisitor>
+#include <set>
 
 class GNameNodeVisitor : public osg::NodeVisitor {
 public:
@@ -44,36 +48,98 @@ private:
     osg::ref_ptr<osg::Node> m_node = nullptr;
 };
 
-template <typename TARGET, typename BASE>
-class GAnimationNodeVisitor : public osg::NodeVisitor {
+class GGeometryVisitor : public osg::NodeVisitor {
 public:
-    explicit GAnimationNodeVisitor()
-        : osg::NodeVisitor(TRAVERSE_NONE)
+    using ArrayFunction = std::function<osg::Array*(osg::Array*)>;
+    using ConstArrayFunction = std::function<void(const osg::Array*)>;
+    explicit GGeometryVisitor()
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
     {
     }
-    osg::ref_ptr<TARGET> getNode(const osg::ref_ptr<osg::Node>& node)
+    void collect(const osg::ref_ptr<osg::Node>& node)
     {
-        osg::ref_ptr<TARGET> manager;
-        this->apply(*node);
-        if (m_node.valid()) {
-            manager = new TARGET(*m_node);
-            node->setUpdateCallback(manager);
+        node->accept(*this);
+    }
+    inline const std::vector<osg::ref_ptr<osg::Geometry>>& geometryList() const { return m_geometryList; }
+    inline const std::vector<osg::ref_ptr<osg::StateSet>>& nodeStateSetList() const { return m_nodeStateSetList; }
+    inline const std::vector<osg::ref_ptr<osg::StateSet>>& drawableStateSetList() const { return m_drawableStateSetList; }
+    static bool isPlainGeometry(const osg::Geometry* geometry)
+    {
+        // Rig and morph geometries read their source arrays as float vectors,
+        // mapped scene file arrays have a fixed size and no typed vector behind them.
+        return std::strcmp(geometry->libraryName(), "osg") == 0
+            && std::strcmp(geometry->className(), "Geometry") == 0
+            && (!geometry->getVertexArray() || std::strcmp(geometry->getVertexArray()->libraryName(), "osg") == 0)
+            && geometry->getDataVariance() != osg::Object::DYNAMIC
+            && !geometry->getUpdateCallback();
+    }
+    static void replaceArrays(osg::Geometry& geometry, const ArrayFunction& function)
+    {
+        auto replace = [&function](osg::Array* array, const std::function<void(osg::Array*)>& setter) {
+            if (array) {
+                osg::Array* result = function(array);
+                if (result != array) {
+                    setter(result);
+                }
+            }
+        };
+        replace(geometry.getVertexArray(), [&geometry](osg::Array* array) { geometry.setVertexArray(array); });
+        replace(geometry.getNormalArray(), [&geometry](osg::Array* array) { geometry.setNormalArray(array); });
+        replace(geometry.getColorArray(), [&geometry](osg::Array* array) { geometry.setColorArray(array); });
+        replace(geometry.getSecondaryColorArray(), [&geometry](osg::Array* array) { geometry.setSecondaryColorArray(array); });
+        replace(geometry.getFogCoordArray(), [&geometry](osg::Array* array) { geometry.setFogCoordArray(array); });
+        for (unsigned int i = 0; i < geometry.getNumTexCoordArrays(); i++) {
+            replace(geometry.getTexCoordArray(i), [&geometry, i](osg::Array* array) { geometry.setTexCoordArray(i, array); });
+        }
+        for (unsigned int i = 0; i < geometry.getNumVertexAttribArrays(); i++) {
+            replace(geometry.getVertexAttribArray(i), [&geometry, i](osg::Array* array) { geometry.setVertexAttribArray(i, array); });
+        }
+    }
+    static void forEachArray(const osg::Geometry& geometry, const ConstArrayFunction& function)
+    {
+        const osg::Array* arrays[] = { geometry.getVertexArray(), geometry.getNormalArray(), geometry.getColorArray(), geometry.getSecondaryColorArray(), geometry.getFogCoordArray() };
+        for (const osg::Array* array : arrays) {
+            if (array) {
+                function(array);
+            }
+        }
+        for (const auto& array : geometry.getTexCoordArrayList()) {
+            if (array.valid()) {
+                function(array);
+            }
+        }
+        for (const auto& array : geometry.getVertexAttribArrayList()) {
+            if (array.valid()) {
+                function(array);
+            }
         }
-        return manager;
     }
 
 protected:
     virtual void apply(osg::Node& node) override
     {
-        if (node.getUpdateCallback()) {
-            m_node = dynamic_cast<BASE*>(node.getUpdateCallback());
-            return;
+        if (node.getStateSet() && m_stateSets.insert(node.getStateSet()).second) {
+            m_nodeStateSetList.push_back(node.getStateSet());
         }
         traverse(node);
     }
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        if (drawable.getStateSet() && m_stateSets.insert(drawable.getStateSet()).second) {
+            m_drawableStateSetList.push_back(drawable.getStateSet());
+        }
+        osg::Geometry* geometry = drawable.asGeometry();
+        if (geometry && m_geometries.insert(geometry).second) {
+            m_geometryList.push_back(geometry);
+        }
+    }
 
 private:
-    osg::ref_ptr<BASE> m_node = nullptr;
+    std::set<osg::Geometry*> m_geometries;
+    std::set<osg::StateSet*> m_stateSets;
+    std::vector<osg::ref_ptr<osg::Geometry>> m_geometryList;
+    std::vector<osg::ref_ptr<osg::StateSet>> m_nodeStateSetList;
+    std::vector<osg::ref_ptr<osg::StateSet>> m_drawableStateSetList;
 };
 
 #endif // GNODEVISITOR_H
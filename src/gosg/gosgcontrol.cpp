@@ -16,10 +16,9 @@
 #include <QCoreApplication>
 #include <QDir>
 #include <QThread>
-#include <osg/ComputeBoundsVisitor>
+#include <algorithm>
 #include <osg/CullFace>
 #include <osg/Fog>
-#include <osg/Material>
 #include <osg/MatrixTransform>
 #include <osg/PositionAttitudeTransform>
 #include <osgDB/ReadFile>
@@ -35,12 +34,56 @@
 #define USE_GPLATFORM 1
 #define USE_GPARTICLE 1
 #define USE_GANIMATION 1
+#define USE_GIMAGELOADER 1
+#define USE_GTEXTURECACHE 1
+#define USE_GDEDUP 1
+#define USE_GQUANTIZE 1
+#define USE_GBATCH 1
+#define USE_GMESHOPTIMIZER 1
+#define USE_GCOMPILE 1
+#define USE_GTEXTUREMANAGER 1
+#define USE_GSCENEFILE 1
+#define USE_GPAGER 1
+#define USE_GKDTREE 1
+
+#define CACHE_DIR ".gcache"
+#define SCENE_UPDATE_MASK 0xffffffff
+#define SKY_DIR "./sources/sky"
+
+class GActivityCallback : public osg::NodeCallback {
+public:
+    explicit GActivityCallback(const std::function<void()>& update)
+        : m_update(update)
+    {
+    }
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv) override
+    {
+        m_update();
+        traverse(node, nv);
+    }
+
+private:
+    std::function<void()> m_update;
+};
 
 GOsgControl::GOsgControl(QObject* parent)
     : QObject(parent)
     , m_rootGroup(new osg::Group)
     , m_rootNodeGroup(new osg::MatrixTransform)
+    , m_textureManager(new GTextureManager)
+    , m_simulation(new GSimulation)
+    , m_commandQueue(new GCommandQueue)
 {
+    m_textureManager->setBudget((unsigned long long)m_textureBudget * 1024 * 1024);
+    m_textureManager->setResidentChangedCallback([this](unsigned long long bytes) {
+        // Reported from the update traversal, the property belongs to the GUI thread.
+        QMetaObject::invokeMethod(
+            this, [this, bytes]() {
+                m_textureResidentBytes = (qint64)bytes;
+                emit textureResidentBytesChanged();
+            },
+            Qt::QueuedConnection);
+    });
     auto loadErrorFunction = [this]() {
         m_hasError = true;
         m_loading = false;
@@ -52,14 +95,32 @@ GOsgControl::GOsgControl(QObject* parent)
     };
     auto loadFinishedFunction = [this]() {
         m_loading = false;
-        m_viewer->home();
         emit rootNodeChanged();
         emit loadingChanged();
     };
     m_loadThread = QThread::create([=]() {
         m_loading = true;
         emit loadingChanged();
-        osg::ref_ptr<osg::Node> loadNode = osgDB::readNodeFile(m_rootNodeUrl.toLocalFile().toStdString());
+        const std::string modelFile = m_rootNodeUrl.toLocalFile().toStdString();
+        GPipeline::Options pipelineOptions;
+        {
+            QMutexLocker locker(&m_mutex);
+            (void)locker;
+            for (const QString& name : m_batchExcludeList) {
+                pipelineOptions.excludeNames.insert(name.toStdString());
+            }
+            pipelineOptions.compress = m_textureCompression;
+        }
+        pipelineOptions.cacheDirectory = GPipeline::cacheDirectory(modelFile);
+        pipelineOptions.decodeImages = USE_GIMAGELOADER;
+        pipelineOptions.textureCache = USE_GTEXTURECACHE;
+        pipelineOptions.sceneCache = USE_GSCENEFILE;
+        pipelineOptions.dedup = USE_GDEDUP;
+        pipelineOptions.quantize = USE_GQUANTIZE;
+        pipelineOptions.batch = USE_GBATCH;
+        pipelineOptions.meshOptimizer = USE_GMESHOPTIMIZER;
+        GPipeline::Report pipelineReport;
+        osg::ref_ptr<osg::Node> loadNode = GPipeline::load(modelFile, pipelineOptions, pipelineReport);
         //        osgUtil::Simplifier simplifier(0.1, 4.0);
         //        loadNode->accept(simplifier);
         //        osgUtil::Optimizer optimzer1;
@@ -70,17 +131,33 @@ GOsgControl::GOsgControl(QObject* parent)
         }
         QMutexLocker locker(&m_mutex);
         (void)locker;
+        // No view has a frame in flight and no pipeline worker updates or culls while the graph is swapped.
+        std::unique_lock<std::shared_timed_mutex> frameLocker(m_frameLock);
+        std::unique_lock<std::shared_timed_mutex> sceneLocker(m_sceneLock);
+        if (m_rootNode.valid()) {
+            m_rootNodeGroup->removeChild(m_rootNode);
+            m_rootNode = nullptr;
+            m_glowNode = nullptr;
+            m_nameIndex.clear();
+            m_simulation->clearGlows();
+        }
         if (!loadNode.valid()) {
             loadErrorFunction();
             return;
         }
         m_rootNode = loadNode;
         m_rootNodeGroup->addChild(m_rootNode);
+#if USE_GPAGER
+        m_tileBytes = GTiler::tileBytes(m_rootNode);
+        if (m_tileBytes > 0) {
+            GTiler::setPagerMemoryCap(m_viewer->getDatabasePager(), (unsigned long long)m_pagerMemoryCap * 1024 * 1024, m_tileBytes);
+        }
+#endif
         double vectorSize = -1;
+        const GSceneAnalysis::Result& analysis = GSceneAnalysis::analyze(m_rootNode, m_sceneRootMatrix);
+        m_nameIndex = analysis.names;
         {
-            osg::ComputeBoundsVisitor boundVisitor;
-            m_rootNodeGroup->accept(boundVisitor);
-            const osg::BoundingBox& box = boundVisitor.getBoundingBox();
+            const osg::BoundingBox& box = analysis.bound;
             double length = box.xMax() - box.xMin();
             double width = box.yMax() - box.yMin();
             double height = box.zMax() - box.zMin();
@@ -91,7 +168,8 @@ GOsgControl::GOsgControl(QObject* parent)
             loadErrorFunction();
             return;
         }
-        m_rootNodeGroup->setMatrix(GCommon::getMatrix(m_rootNodeMatrix) * osg::Matrix::translate(m_platformTranslate));
+        m_rootNodeGroup->setMatrix(m_sceneRootMatrix * osg::Matrix::translate(m_platformTranslate));
+        m_simulation->setRootMatrix(m_rootNodeGroup->getMatrix());
 #if USE_CULLFACE
         osg::ref_ptr<osg::CullFace> cullface = new osg::CullFace(osg::CullFace::BACK);
         m_rootNode->getOrCreateStateSet()->setAttribute(cullface);
@@ -116,11 +194,11 @@ GOsgControl::GOsgControl(QObject* parent)
 #if USE_GSKY_BOX
         {
             if (m_skyNode.valid()) {
-                m_rootGroup->removeChild(m_skyNode);
-                m_skyNode = nullptr;
+                GSkyBox::setSize(m_skyNode, vectorSize * 15);
+            } else {
+                m_skyNode = GSkyBox::create(SKY_DIR, vectorSize * 15);
+                m_rootGroup->addChild(m_skyNode);
             }
-            m_skyNode = GSkyBox::create("./sources/sky", vectorSize * 15);
-            m_rootGroup->addChild(m_skyNode);
         }
 #endif
 #if USE_GLIGHT
@@ -150,14 +228,19 @@ GOsgControl::GOsgControl(QObject* parent)
                 m_particle = nullptr;
             }
             m_particle = new GParticle(vectorSize / 5);
-            m_particle->setMatrix(GCommon::getMatrix(m_particleMatrix));
+            m_particle->setMatrix(m_sceneParticleMatrix);
             m_rootGroup->addChild(m_particle);
+            m_simulation->setParticleMatrix(m_particle->getMatrix());
+            m_simulation->setTargets(m_rootNodeGroup, m_particle, m_manipulator);
         }
 #endif
 #if USE_GANIMATION
         {
-            GAnimationNodeVisitor<GAnimationManager, osgAnimation::AnimationManagerBase> animationNodeVisitor;
-            m_animationManager = animationNodeVisitor.getNode(m_rootNode);
+            m_animationManager = nullptr;
+            if (analysis.animationManager.valid()) {
+                m_animationManager = new GAnimationManager(*analysis.animationManager);
+                analysis.animationNode->setUpdateCallback(m_animationManager);
+            }
             if (m_animationManager.valid()) {
                 m_animationList.clear();
                 m_animationsStatus.clear();
@@ -171,8 +254,12 @@ GOsgControl::GOsgControl(QObject* parent)
                     emit animationsStatusChanged();
                 }
                 m_animationManager->setAnimationFinishedCallback([this](int index) {
-                    m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", false } });
-                    emit animationsStatusChanged();
+                    QMetaObject::invokeMethod(
+                        this, [this, index]() {
+                            m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", false } });
+                            emit animationsStatusChanged();
+                        },
+                        Qt::QueuedConnection);
                 });
             } else if (!m_animationList.empty()) {
                 m_animationList.clear();
@@ -182,22 +269,39 @@ GOsgControl::GOsgControl(QObject* parent)
             }
         }
 #endif
-        if (m_manipulator.valid()) {
+        m_viewSize = vectorSize;
+        const bool defaultHome = m_homePos.empty();
+        pushHome([this, vectorSize, defaultHome]() {
             m_manipulator->setLimit(vectorSize * 2, vectorSize * 10, vectorSize / 20);
-            if (m_homePos.empty()) {
+            if (defaultHome) {
                 m_manipulator->setHomePosition(osg::Vec3d(0, -vectorSize * 2, vectorSize / 2), osg::Vec3d(0, 0, 0), osg::Vec3d(0, 0, 1));
             }
-        }
+        });
         osgUtil::Optimizer optimzer;
+#if USE_GSCENEFILE
+        optimzer.setIsOperationPermissibleForObjectCallback(GSceneFile::permissibleCallback().get());
+#endif
         optimzer.optimize(m_rootGroup);
-        m_viewer->updateTraversal();
-        m_viewer->home();
+#if USE_GKDTREE
+        GSceneAnalysis::buildKdTrees(analysis.kdTreeItems);
+#endif
+#if USE_GTEXTUREMANAGER
+        m_textureManager->clear();
+        m_textureManager->attach(m_rootNode);
+#endif
+#if USE_GCOMPILE
+        // Compiles run on the primary context, a model loaded while another view owns the scene is drawn uncompiled.
+        if (m_sceneOwner == m_viewer) {
+            GCompile::add(m_compileOperation, m_rootNodeGroup, m_rootNode);
+        }
+#endif
         loadFinishedFunction();
     });
 }
 
 GOsgControl::~GOsgControl()
 {
+    m_simulation->stop();
     if (m_loadThread) {
         m_loadThread->requestInterruption();
         m_loadThread->terminate();
@@ -220,10 +324,7 @@ void GOsgControl::setRootNode(const QUrl& rootNodeUrl)
     (void)locker;
     if (m_rootNodeUrl != rootNodeUrl) {
         m_rootNodeUrl = rootNodeUrl;
-        if (m_rootNode.valid()) {
-            m_rootNodeGroup->removeChild(m_rootNode);
-            m_rootNode = nullptr;
-        }
+        // The load thread drops the old model when it swaps the new one in.
         if (m_loadThread) {
             m_loadThread->terminate();
             m_loadThread->wait();
@@ -238,11 +339,10 @@ void GOsgControl::setHomePos(const QVariantMap& homePos)
     (void)locker;
     if (m_homePos != homePos) {
         m_homePos = homePos;
-        if (m_manipulator.valid()) {
-            const auto& pos = GCommon::getHomePos(homePos);
+        const auto pos = GCommon::getHomePos(homePos);
+        pushHome([this, pos]() {
             m_manipulator->setHomePosition(std::get<0>(pos), std::get<1>(pos), std::get<2>(pos));
-            m_viewer->home();
-        }
+        });
         emit homePosChanged();
     }
 }
@@ -253,52 +353,221 @@ void GOsgControl::setFlyPosList(const QVariantList& flyPosList)
     (void)locker;
     if (m_flyPosList != flyPosList) {
         m_flyPosList = flyPosList;
-        if (m_manipulator.valid()) {
-            m_manipulator->setFlyList(GCommon::getFlyList(flyPosList));
-        }
+        const auto flyList = GCommon::getFlyList(flyPosList);
+        pushCommand([this, flyList]() {
+            if (!m_manipulator.valid()) {
+                return false;
+            }
+            m_manipulator->setFlyList(flyList);
+            return true;
+        });
         emit flyPosListChanged();
     }
 }
 
-void GOsgControl::setParticleMatrix(const QVariantMap& particleMatrix)
+void GOsgControl::setBatchExcludeList(const QStringList& batchExcludeList)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    if (m_batchExcludeList != batchExcludeList) {
+        m_batchExcludeList = batchExcludeList;
+        emit batchExcludeListChanged();
+    }
+}
+
+void GOsgControl::setCompileBudget(double compileBudget)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    if (m_compileBudget != compileBudget) {
+        m_compileBudget = compileBudget;
+        GCompile::setBudget(m_compileOperation, m_compileBudget);
+        emit compileBudgetChanged();
+    }
+}
+
+void GOsgControl::setTextureCompression(bool textureCompression)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    if (m_textureCompression != textureCompression) {
+        m_textureCompression = textureCompression;
+        emit textureCompressionChanged();
+    }
+}
+
+void GOsgControl::setTextureBudget(int textureBudget)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    if (m_textureBudget != textureBudget) {
+        m_textureBudget = textureBudget;
+        m_textureManager->setBudget((unsigned long long)std::max(0, m_textureBudget) * 1024 * 1024);
+        emit textureBudgetChanged();
+    }
+}
+
+void GOsgControl::setPagerThreads(int pagerThreads)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    if (m_pagerThreads != pagerThreads) {
+        m_pagerThreads = pagerThreads;
+        if (m_viewer) {
+            GTiler::setPagerThreads(m_viewer->getDatabasePager(), (unsigned int)std::max(1, m_pagerThreads));
+        }
+        emit pagerThreadsChanged();
+    }
+}
+
+void GOsgControl::setPagerMemoryCap(int pagerMemoryCap)
 {
     QMutexLocker locker(&m_mutex);
     (void)locker;
+    if (m_pagerMemoryCap != pagerMemoryCap) {
+        m_pagerMemoryCap = pagerMemoryCap;
+        if (m_viewer) {
+            GTiler::setPagerMemoryCap(m_viewer->getDatabasePager(), (unsigned long long)std::max(0, m_pagerMemoryCap) * 1024 * 1024, m_tileBytes);
+        }
+        emit pagerMemoryCapChanged();
+    }
+}
+
+void GOsgControl::setSimulationRate(int simulationRate)
+{
+    if (simulationRate > 0 && m_simulation->tickRate() != simulationRate) {
+        m_simulation->setTickRate(simulationRate);
+        emit simulationRateChanged();
+    }
+}
+
+void GOsgControl::setParticleMatrix(const QVariantMap& particleMatrix)
+{
     if (m_particleMatrix != particleMatrix) {
         m_particleMatrix = particleMatrix;
-        if (m_particle.valid()) {
-            m_particle->setMatrix(GCommon::getMatrix(m_particleMatrix));
-        }
+        const osg::Matrixd matrix = GCommon::getMatrix(m_particleMatrix);
+        pushCommand([this, matrix]() {
+            m_sceneParticleMatrix = matrix;
+            m_simulation->setParticleMatrix(m_sceneParticleMatrix);
+            return true;
+        });
         emit particleMatrixChanged();
     }
 }
 
 void GOsgControl::setRootNodeMatrix(const QVariantMap& rootNodeMatrix)
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
     if (m_rootNodeMatrix != rootNodeMatrix) {
         m_rootNodeMatrix = rootNodeMatrix;
-        m_rootNodeGroup->setMatrix(GCommon::getMatrix(rootNodeMatrix) * osg::Matrix::translate(m_platformTranslate));
+        const osg::Matrixd matrix = GCommon::getMatrix(m_rootNodeMatrix);
+        pushCommand([this, matrix]() {
+            m_sceneRootMatrix = matrix;
+            m_simulation->setRootMatrix(m_sceneRootMatrix * osg::Matrix::translate(m_platformTranslate));
+            return true;
+        });
         emit rootNodeMatrixChanged();
     }
 }
 
 void GOsgControl::init(osgViewer::Viewer* viewer)
 {
+    if (m_viewer) {
+        addView(viewer);
+        return;
+    }
     m_viewer = viewer;
+    m_sceneOwner = viewer;
     m_viewer->addEventHandler(new osgViewer::StatsHandler);
     osg::ref_ptr<GCoord> coord = new GCoord(m_viewer->getCamera());
     m_rootGroup->addChild(coord);
     m_manipulator = new GManipulator;
-    m_manipulator->setFlyFinishedCallback([this](int index) {
-        (void)index;
-        m_flyIndex = -1;
-        emit flyIndexChanged();
-    });
     m_viewer->setCameraManipulator(m_manipulator);
+    m_simulation->setFlyFinishedCallback([this](int index) {
+        QMetaObject::invokeMethod(
+            this, [this, index]() {
+                // A fly started meanwhile keeps its index.
+                if (index < 0) {
+                    m_flyIndex = -1;
+                    emit flyIndexChanged();
+                }
+            },
+            Qt::QueuedConnection);
+    });
+    m_simulation->setTargets(m_rootNodeGroup, m_particle, m_manipulator);
+#if USE_GSKY_BOX
+    GSkyBox::preload(SKY_DIR, std::string(SKY_DIR) + "/" + CACHE_DIR, m_textureCompression);
+#endif
+#if USE_GCOMPILE
+    m_compileOperation = GCompile::create(m_compileBudget);
+    m_viewer->setIncrementalCompileOperation(m_compileOperation);
+#endif
     m_rootGroup->addChild(m_rootNodeGroup);
+    m_rootGroup->addUpdateCallback(m_commandQueue);
+#if USE_GTEXTUREMANAGER
+    m_textureManager->setGraphicsContext(m_viewer->getCamera()->getGraphicsContext());
+    m_rootGroup->addUpdateCallback(m_textureManager);
+#endif
+    m_rootGroup->addUpdateCallback(m_simulation);
+    // Animation state is sampled by the update that changes it, the governor only reads the flag.
+    m_rootGroup->addUpdateCallback(new GActivityCallback([this]() {
+        m_sceneActive = m_animationManager.valid() && m_animationManager->hasAnyPlaying();
+    }));
+    m_simulation->start();
     m_viewer->setSceneData(m_rootGroup);
+#if USE_GPAGER
+    GTiler::setPagerThreads(m_viewer->getDatabasePager(), (unsigned int)std::max(1, m_pagerThreads));
+#endif
+}
+
+void GOsgControl::addView(osgViewer::Viewer* viewer)
+{
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    viewer->setCameraManipulator(new GManipulator);
+    // The scene owner's update traversal advances the shared scene once per frame.
+    viewer->getUpdateVisitor()->setTraversalMask(0);
+    viewer->setSceneData(m_rootGroup);
+    m_viewList.push_back(viewer);
+    setupView(viewer);
+}
+
+void GOsgControl::setupView(osgViewer::Viewer* viewer)
+{
+    GManipulator* manipulator = dynamic_cast<GManipulator*>(viewer->getCameraManipulator());
+    if (!manipulator || !m_manipulator.valid() || m_viewSize < 0) {
+        return;
+    }
+    osg::Vec3d eye, center, up;
+    m_manipulator->getHomePosition(eye, center, up);
+    manipulator->setLimit(m_viewSize * 2, m_viewSize * 10, m_viewSize / 20);
+    manipulator->setHomePosition(eye, center, up);
+    viewer->home();
+}
+
+void GOsgControl::shareContext(QOpenGLContext* context, osg::GraphicsContext* graphicsContext)
+{
+    if (!context || !graphicsContext || !graphicsContext->getState()) {
+        return;
+    }
+    QMutexLocker locker(&m_contextMutex);
+    (void)locker;
+    unsigned int contextID = graphicsContext->getState()->getContextID();
+    auto it = m_contextIds.find(context);
+    if (it == m_contextIds.end()) {
+        m_contextIds.insert(context, contextID);
+        connect(
+            context, &QOpenGLContext::aboutToBeDestroyed, this, [this, context]() {
+                QMutexLocker locker(&m_contextMutex);
+                (void)locker;
+                m_contextIds.remove(context);
+            },
+            Qt::DirectConnection);
+    } else if (it.value() != contextID) {
+        // Views drawing into the same GL context upload textures and buffers once.
+        osg::GraphicsContext::incrementContextIDUsageCount(it.value());
+        graphicsContext->getState()->setContextID(it.value());
+        osg::GraphicsContext::decrementContextIDUsageCount(contextID);
+    }
 }
 
 bool GOsgControl::checkFrameAllowed()
@@ -313,91 +582,305 @@ bool GOsgControl::checkFrameAllowed()
     return true;
 }
 
-void GOsgControl::requestDestroy()
+bool GOsgControl::hasActivity()
 {
-    m_requestDestroy = true;
+    // Queued commands need a frame to run, scene state is only read through flags the frames publish.
+    return m_loading
+        || !m_commandQueue->empty()
+        || m_sceneActive
+        || m_particlePlaying
+        || m_flyIndex >= 0
+        || (m_manipulator.valid() && m_manipulator->isMoving())
+        || isSecondaryViewMoving()
+        || GCompile::pendingCount(m_compileOperation) > 0
+        || (m_viewer && m_viewer->getDatabasePager() && m_viewer->getDatabasePager()->getRequestsInProgress());
 }
 
-QUrl GOsgControl::getUrlForLocal(const QString& path)
+bool GOsgControl::isViewMoving()
 {
-    return QUrl::fromLocalFile(path);
+    // Called from the render thread, the lock keeps the view list still.
+    if (!m_mutex.tryLock()) {
+        return false;
+    }
+    bool moving = m_flyIndex >= 0 || (m_manipulator.valid() && m_manipulator->isMoving()) || isSecondaryViewMoving();
+    m_mutex.unlock();
+    return moving;
+}
+
+double GOsgControl::simulationTime() const
+{
+    return m_simulation->time();
 }
 
-bool GOsgControl::playAnimation(int index, bool reset, double duration, double end, double start)
+unsigned int GOsgControl::nextFrameNumber(osgViewer::Viewer* viewer)
+{
+    // The scene owner advances the count, the other views stamp the frame it is on.
+    if (viewer == m_sceneOwner) {
+        return ++m_frameNumber;
+    }
+    return m_frameNumber;
+}
+
+QJsonObject GOsgControl::memoryReport()
 {
     QMutexLocker locker(&m_mutex);
     (void)locker;
-    if (!m_animationManager.valid()) {
-        return false;
-    }
-    bool ok = m_animationManager->playAnimation(index, reset, duration, end, start);
-    if (ok) {
-        m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", true } });
-        emit animationsStatusChanged();
+    // The walk reads the live graph, which update, cull and the pager change under the scene lock.
+    std::shared_lock<std::shared_timed_mutex> sceneLocker(m_sceneLock);
+    if (!m_rootNode.valid()) {
+        return QJsonObject();
     }
-    return ok;
+    return GMemoryReport::create(m_rootNode);
 }
 
-bool GOsgControl::playAnimationForName(const QString& name, bool reset, double duration, double end, double start)
+QVariantMap GOsgControl::sceneStatistics(const QStringList& names)
 {
-    int index = m_animationList.indexOf(name);
-    return playAnimation(index, reset, duration, end, start);
+    auto toMap = [](const GSceneStats::Stats& stats) {
+        return QVariantMap {
+            { "triangles", (double)stats.triangles },
+            { "vertices", (double)stats.vertices },
+            { "drawables", stats.drawables },
+            { "drawCalls", stats.drawCalls },
+            { "stateSets", stats.stateSets },
+        };
+    };
+    QMutexLocker locker(&m_mutex);
+    (void)locker;
+    std::shared_lock<std::shared_timed_mutex> sceneLocker(m_sceneLock);
+    if (!m_rootNode.valid()) {
+        return QVariantMap();
+    }
+    QVariantMap parts;
+    if (names.isEmpty()) {
+        for (const auto& part : GSceneStats::parts(m_rootNode)) {
+            parts.insert(QString::fromStdString(part->getName()), toMap(GSceneStats::collect(part)));
+        }
+    } else {
+        for (const QString& name : names) {
+            osg::ref_ptr<osg::Node> part = GSceneAnalysis::findNode(m_nameIndex, m_rootNode, name.toStdString());
+            if (part.valid()) {
+                parts.insert(name, toMap(GSceneStats::collect(part)));
+            }
+        }
+    }
+    return QVariantMap {
+        { "total", toMap(GSceneStats::collect(m_rootNode)) },
+        { "parts", parts },
+    };
 }
 
-bool GOsgControl::stopAnimation(int index, bool reset)
+QVariantMap GOsgControl::visibleStatistics()
 {
     QMutexLocker locker(&m_mutex);
     (void)locker;
-    if (!m_animationManager.valid()) {
-        return false;
+    QVariantMap result;
+    if (m_viewer) {
+        for (const auto& value : GSceneStats::visible(m_viewer->getCamera())) {
+            result.insert(QString::fromStdString(value.first), value.second);
+        }
     }
-    bool ok = m_animationManager->stopAnimation(index, reset);
-    if (ok) {
-        m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", false } });
-        emit animationsStatusChanged();
+    return result;
+}
+
+void GOsgControl::requestDestroy(osgViewer::Viewer* viewer)
+{
+    m_suspendedViews.erase(viewer);
+    if (viewer != m_viewer) {
+        QMutexLocker locker(&m_mutex);
+        (void)locker;
+        m_viewList.erase(std::remove(m_viewList.begin(), m_viewList.end(), viewer), m_viewList.end());
+        updatePaused();
+        return;
     }
-    return ok;
+    m_requestDestroy = true;
 }
 
-bool GOsgControl::stopAnimationForName(const QString& name, bool reset)
+void GOsgControl::suspendView(osgViewer::Viewer* viewer, bool suspended)
 {
-    int index = m_animationList.indexOf(name);
-    return stopAnimation(index, reset);
+    if (suspended) {
+        m_suspendedViews.insert(viewer);
+    } else {
+        m_suspendedViews.erase(viewer);
+    }
+    updatePaused();
 }
 
-bool GOsgControl::stopAnimationAll(bool reset)
+void GOsgControl::updatePaused()
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_animationManager.valid()) {
-        return false;
+    // Time only stands still while no view shows the scene.
+    bool paused = m_viewer && m_suspendedViews.size() > m_viewList.size();
+    if (m_simulation->paused() != paused) {
+        m_simulation->setPaused(paused);
+    }
+    updateSceneOwner();
+}
+
+void GOsgControl::updateSceneOwner()
+{
+    if (!m_viewer) {
+        return;
     }
-    bool ok = m_animationManager->stopAnimationAll(reset);
-    if (ok) {
-        m_animationsStatus.clear();
-        for (int i = 0; i < m_animationList.length(); i++) {
-            m_animationsStatus.insert(QString::number(i), QVariantMap { { "running", false } });
+    // The primary view updates the shared scene, a shown secondary view takes over while it is suspended.
+    osgViewer::Viewer* owner = m_viewer;
+    if (m_suspendedViews.count(m_viewer) > 0) {
+        for (osgViewer::Viewer* view : m_viewList) {
+            if (m_suspendedViews.count(view) == 0) {
+                owner = view;
+                break;
+            }
         }
     }
-    return ok;
+    if (m_sceneOwner == owner) {
+        return;
+    }
+    std::unique_lock<std::shared_timed_mutex> sceneLocker(m_sceneLock);
+    m_sceneOwner = owner;
+    m_viewer->getUpdateVisitor()->setTraversalMask(owner == m_viewer ? SCENE_UPDATE_MASK : 0);
+    for (osgViewer::Viewer* view : m_viewList) {
+        view->getUpdateVisitor()->setTraversalMask(view == owner ? SCENE_UPDATE_MASK : 0);
+    }
+#if USE_GTEXTUREMANAGER
+    m_textureManager->setGraphicsContext(owner->getCamera()->getGraphicsContext());
+#endif
+#if USE_GCOMPILE
+    if (owner != m_viewer) {
+        // Pending compiles only finish on the primary context, they are attached as they are.
+        GCompile::flush(m_compileOperation);
+    }
+#endif
 }
 
-bool GOsgControl::playFly(int index)
+bool GOsgControl::isSecondaryViewMoving() const
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_manipulator.valid()) {
-        return false;
-    }
-    bool ok = m_manipulator->playFly(index);
-    if (ok) {
-        m_flyIndex = index;
-        emit flyIndexChanged();
+    for (osgViewer::Viewer* view : m_viewList) {
+        const GManipulator* manipulator = dynamic_cast<const GManipulator*>(view->getCameraManipulator());
+        if (manipulator && manipulator->isMoving()) {
+            return true;
+        }
     }
-    return ok;
+    return false;
+}
+
+QUrl GOsgControl::getUrlForLocal(const QString& path)
+{
+    return QUrl::fromLocalFile(path);
+}
+
+int GOsgControl::pushCommand(const std::function<bool()>& command, const std::function<void(bool)>& completed)
+{
+    int id = ++m_commandId;
+    m_commandQueue->push([this, id, command, completed]() {
+        bool ok = command();
+        // Results go back to the GUI thread, which owns the QML facing state.
+        QMetaObject::invokeMethod(
+            this, [this, id, ok, completed]() {
+                if (completed) {
+                    completed(ok);
+                }
+                emit commandCompleted(id, ok);
+            },
+            Qt::QueuedConnection);
+    });
+    emit frameRequested();
+    return id;
+}
+
+int GOsgControl::pushHome(const std::function<void()>& setHome)
+{
+    // Views are held weakly, an item destroyed before the command runs is skipped.
+    const std::vector<osg::observer_ptr<osgViewer::Viewer>> views(m_viewList.begin(), m_viewList.end());
+    return pushCommand([this, setHome, views]() {
+        if (!m_manipulator.valid()) {
+            return false;
+        }
+        setHome();
+        m_viewer->home();
+        for (const auto& view : views) {
+            osg::ref_ptr<osgViewer::Viewer> viewer;
+            if (view.lock(viewer)) {
+                setupView(viewer.get());
+            }
+        }
+        return true;
+    });
+}
+
+int GOsgControl::playAnimation(int index, bool reset, double duration, double end, double start)
+{
+    return pushCommand(
+        [=]() {
+            return m_animationManager.valid() && m_animationManager->playAnimation(index, reset, duration, end, start);
+        },
+        [this, index](bool ok) {
+            if (ok) {
+                m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", true } });
+                emit animationsStatusChanged();
+            }
+        });
+}
+
+int GOsgControl::playAnimationForName(const QString& name, bool reset, double duration, double end, double start)
+{
+    int index = m_animationList.indexOf(name);
+    return playAnimation(index, reset, duration, end, start);
 }
 
-bool GOsgControl::playFlyForName(const QString& name)
+int GOsgControl::stopAnimation(int index, bool reset)
+{
+    return pushCommand(
+        [=]() {
+            return m_animationManager.valid() && m_animationManager->stopAnimation(index, reset);
+        },
+        [this, index](bool ok) {
+            if (ok) {
+                m_animationsStatus.insert(QString::number(index), QVariantMap { { "running", false } });
+                emit animationsStatusChanged();
+            }
+        });
+}
+
+int GOsgControl::stopAnimationForName(const QString& name, bool reset)
+{
+    int index = m_animationList.indexOf(name);
+    return stopAnimation(index, reset);
+}
+
+int GOsgControl::stopAnimationAll(bool reset)
+{
+    return pushCommand(
+        [=]() {
+            return m_animationManager.valid() && m_animationManager->stopAnimationAll(reset);
+        },
+        [this](bool ok) {
+            if (ok) {
+                m_animationsStatus.clear();
+                for (int i = 0; i < m_animationList.length(); i++) {
+                    m_animationsStatus.insert(QString::number(i), QVariantMap { { "running", false } });
+                }
+            }
+        });
+}
+
+int GOsgControl::playFly(int index)
+{
+    return pushCommand(
+        [this, index]() {
+            // The fly list is set by a command too, so it is read where it is written.
+            if (!m_manipulator.valid() || index < 0 || index >= (int)m_manipulator->flyList().size()) {
+                return false;
+            }
+            m_simulation->playFly(index, m_manipulator->flyList().at(index));
+            return true;
+        },
+        [this, index](bool ok) {
+            if (ok) {
+                m_flyIndex = index;
+                emit flyIndexChanged();
+            }
+        });
+}
+
+int GOsgControl::playFlyForName(const QString& name)
 {
     int index = -1;
     for (int i = 0; i < m_flyPosList.length(); i++) {
@@ -410,82 +893,91 @@ bool GOsgControl::playFlyForName(const QString& name)
     return playFly(index);
 }
 
-bool GOsgControl::stopFly()
+int GOsgControl::stopFly()
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_manipulator.valid()) {
-        return false;
-    }
-    bool ok = m_manipulator->stopFly();
-    if (ok) {
-        m_flyIndex = -1;
-        emit flyIndexChanged();
-    }
-    return ok;
+    bool flying = m_flyIndex >= 0;
+    return pushCommand(
+        [this, flying]() {
+            m_simulation->stopFly();
+            return flying;
+        },
+        [this](bool ok) {
+            if (ok) {
+                m_flyIndex = -1;
+                emit flyIndexChanged();
+            }
+        });
 }
 
-void GOsgControl::playParticle(const QColor& fromColor, const QColor& toColor, double speed)
+int GOsgControl::playParticle(const QColor& fromColor, const QColor& toColor, double speed)
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_rootNode.valid()) {
-        return;
-    }
-    if (m_particle.valid()) {
-        m_particle->play(osg::Vec4(fromColor.redF(), fromColor.greenF(), fromColor.blueF(), fromColor.alphaF()), osg::Vec4(toColor.redF(), toColor.greenF(), toColor.blueF(), toColor.alphaF()), speed);
-    }
+    osg::Vec4 from(fromColor.redF(), fromColor.greenF(), fromColor.blueF(), fromColor.alphaF());
+    osg::Vec4 to(toColor.redF(), toColor.greenF(), toColor.blueF(), toColor.alphaF());
+    return pushCommand(
+        [=]() {
+            if (!m_rootNode.valid() || !m_particle.valid()) {
+                return false;
+            }
+            m_particle->play(from, to, speed);
+            return true;
+        },
+        [this](bool ok) {
+            if (ok) {
+                m_particlePlaying = true;
+            }
+        });
 }
 
-void GOsgControl::stopParticle()
+int GOsgControl::stopParticle()
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_rootNode.valid()) {
-        return;
-    }
-    if (m_particle.valid()) {
-        m_particle->stop();
-    }
+    return pushCommand(
+        [this]() {
+            if (!m_rootNode.valid() || !m_particle.valid()) {
+                return false;
+            }
+            m_particle->stop();
+            return true;
+        },
+        [this](bool ok) {
+            if (ok) {
+                m_particlePlaying = false;
+            }
+        });
 }
 
-void GOsgControl::playGrow(const QString& name, const QColor& color)
+int GOsgControl::playGrow(const QString& name, const QColor& color)
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_rootNode.valid()) {
-        return;
-    }
-    if (!m_glowNode.valid() || m_glowNode->getName() != name.toStdString()) {
-        GNameNodeVisitor nameNodeVisitor;
-        m_glowNode = nameNodeVisitor.getNode(m_rootNode, name.toStdString());
-    }
-    if (m_glowNode.valid()) {
-        osg::Vec4d osgColor(color.redF(), color.greenF(), color.blueF(), color.alphaF());
-        osg::ref_ptr<osg::Material> material;
-        material = static_cast<osg::Material*>(m_glowNode->getOrCreateStateSet()->getAttribute(osg::StateAttribute::MATERIAL));
-        if (!material.valid()) {
-            material = new osg::Material;
-            m_glowNode->getOrCreateStateSet()->setAttributeAndModes(material, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
+    const std::string nodeName = name.toStdString();
+    osg::Vec4 osgColor(color.redF(), color.greenF(), color.blueF(), color.alphaF());
+    return pushCommand([this, nodeName, osgColor]() {
+        if (!m_rootNode.valid()) {
+            return false;
         }
-        material->setEmission(osg::Material::FRONT, osgColor);
-        material->setShininess(osg::Material::FRONT, 128.0);
-        material->setColorMode(osg::Material::AMBIENT);
-    }
+        if (!m_glowNode.valid() || m_glowNode->getName() != nodeName) {
+            m_glowNode = GSceneAnalysis::findNode(m_nameIndex, m_rootNode, nodeName);
+        }
+        if (!m_glowNode.valid()) {
+            return false;
+        }
+        m_simulation->setGlow(m_glowNode, osgColor);
+        return true;
+    });
 }
 
-void GOsgControl::stopGrow(const QString& name)
+int GOsgControl::stopGrow(const QString& name)
 {
-    QMutexLocker locker(&m_mutex);
-    (void)locker;
-    if (!m_rootNode.valid()) {
-        return;
-    }
-    if (!m_glowNode.valid() || m_glowNode->getName() != name.toStdString()) {
-        GNameNodeVisitor nameNodeVisitor;
-        m_glowNode = nameNodeVisitor.getNode(m_rootNode, name.toStdString());
-    }
-    if (m_glowNode.valid()) {
-        m_glowNode->getOrCreateStateSet()->removeAttribute(osg::StateAttribute::MATERIAL);
-    }
+    const std::string nodeName = name.toStdString();
+    return pushCommand([this, nodeName]() {
+        if (!m_rootNode.valid()) {
+            return false;
+        }
+        if (!m_glowNode.valid() || m_glowNode->getName() != nodeName) {
+            m_glowNode = GSceneAnalysis::findNode(m_nameIndex, m_rootNode, nodeName);
+        }
+        if (!m_glowNode.valid()) {
+            return false;
+        }
+        m_simulation->clearGlow(m_glowNode);
+        return true;
+    });
 }
@@ -14,19 +14,40 @@
 #define GOSGCONTROL_H
 
 #include "ganimationmanager.h"
+#include "gbatch.h"
+#include "gcommandqueue.h"
+#include "gcompile.h"
 #include "gcoord.h"
+#include "gdedup.h"
+#include "gimageloader.h"
 #include "glight.h"
 #include "gmanipulator.h"
+#include "gmemoryreport.h"
+#include "gmeshoptimizer.h"
 #include "gnodevisitor.h"
 #include "gparticle.h"
+#include "gpipeline.h"
 #include "gplatform.h"
+#include "gquantize.h"
+#include "gsceneanalysis.h"
+#include "gscenefile.h"
+#include "gscenestats.h"
+#include "gsimulation.h"
 #include "gskybox.h"
+#include "gtexturemanager.h"
+#include "gtiler.h"
 #include <QColor>
+#include <QHash>
 #include <QMutex>
+#include <QOpenGLContext>
 #include <QObject>
 #include <QQmlParserStatus>
 #include <QUrl>
 #include <QVariantMap>
+#include <atomic>
+#include <osg/observer_ptr>
+#include <set>
+#include <shared_mutex>
 
 class GOsgControl : public QObject, public QQmlParserStatus {
     Q_OBJECT
@@ -35,6 +56,14 @@ class GOsgControl : public QObject, public QQmlParserStatus {
     Q_PROPERTY(QStringList animationList READ animationList NOTIFY animationListChanged)
     Q_PROPERTY(QVariantMap homePos READ homePos WRITE setHomePos NOTIFY homePosChanged)
     Q_PROPERTY(QVariantList flyPosList READ flyPosList WRITE setFlyPosList NOTIFY flyPosListChanged)
+    Q_PROPERTY(QStringList batchExcludeList READ batchExcludeList WRITE setBatchExcludeList NOTIFY batchExcludeListChanged)
+    Q_PROPERTY(double compileBudget READ compileBudget WRITE setCompileBudget NOTIFY compileBudgetChanged)
+    Q_PROPERTY(bool textureCompression READ textureCompression WRITE setTextureCompression NOTIFY textureCompressionChanged)
+    Q_PROPERTY(int textureBudget READ textureBudget WRITE setTextureBudget NOTIFY textureBudgetChanged)
+    Q_PROPERTY(qint64 textureResidentBytes READ textureResidentBytes NOTIFY textureResidentBytesChanged)
+    Q_PROPERTY(int pagerThreads READ pagerThreads WRITE setPagerThreads NOTIFY pagerThreadsChanged)
+    Q_PROPERTY(int pagerMemoryCap READ pagerMemoryCap WRITE setPagerMemoryCap NOTIFY pagerMemoryCapChanged)
+    Q_PROPERTY(int simulationRate READ simulationRate WRITE setSimulationRate NOTIFY simulationRateChanged)
     Q_PROPERTY(QVariantMap animationsStatus READ animationsStatus NOTIFY animationsStatusChanged)
     Q_PROPERTY(QVariantMap rootNodeMatrix READ rootNodeMatrix WRITE setRootNodeMatrix NOTIFY rootNodeMatrixChanged)
     Q_PROPERTY(QVariantMap particleMatrix READ particleMatrix WRITE setParticleMatrix NOTIFY particleMatrixChanged)
@@ -55,46 +84,87 @@ public:
     inline QStringList animationList() const { return m_animationList; }
     inline QVariantMap homePos() const { return m_homePos; }
     inline QVariantList flyPosList() const { return m_flyPosList; }
+    inline QStringList batchExcludeList() const { return m_batchExcludeList; }
+    inline double compileBudget() const { return m_compileBudget; }
+    inline bool textureCompression() const { return m_textureCompression; }
+    inline int textureBudget() const { return m_textureBudget; }
+    inline qint64 textureResidentBytes() const { return m_textureResidentBytes; }
+    inline int pagerThreads() const { return m_pagerThreads; }
+    inline int pagerMemoryCap() const { return m_pagerMemoryCap; }
+    inline int simulationRate() const { return m_simulation->tickRate(); }
     inline QVariantMap animationsStatus() const { return m_animationsStatus; }
     inline QVariantMap rootNodeMatrix() const { return m_rootNodeMatrix; }
     inline QVariantMap particleMatrix() const { return m_particleMatrix; }
     inline int flyIndex() const { return m_flyIndex; }
+    inline std::shared_timed_mutex* sceneLock() { return &m_sceneLock; }
+    inline std::shared_timed_mutex* frameLock() { return &m_frameLock; }
+    inline bool isPrimaryView(osgViewer::Viewer* viewer) const { return viewer == m_viewer; }
     inline bool loading() const { return m_loading; }
     inline bool hasError() const { return m_hasError; }
     inline QString errorMessage() const { return m_errorMessage; }
     void setRootNode(const QUrl& rootNodeUrl);
     void setHomePos(const QVariantMap& homePos);
     void setFlyPosList(const QVariantList& flyPosList);
+    void setBatchExcludeList(const QStringList& batchExcludeList);
+    void setCompileBudget(double compileBudget);
+    void setTextureCompression(bool textureCompression);
+    void setTextureBudget(int textureBudget);
+    void setPagerThreads(int pagerThreads);
+    void setPagerMemoryCap(int pagerMemoryCap);
+    void setSimulationRate(int simulationRate);
     void setRootNodeMatrix(const QVariantMap& rootNodeMatrix);
     void setParticleMatrix(const QVariantMap& particleMatrix);
 
 public:
     void init(osgViewer::Viewer* viewer);
+    void shareContext(QOpenGLContext* context, osg::GraphicsContext* graphicsContext);
     bool checkFrameAllowed();
-    void requestDestroy();
+    bool hasActivity();
+    bool isViewMoving();
+    double simulationTime() const;
+    unsigned int nextFrameNumber(osgViewer::Viewer* viewer);
+    void requestDestroy(osgViewer::Viewer* viewer);
+    void suspendView(osgViewer::Viewer* viewer, bool suspended);
+    Q_INVOKABLE QJsonObject memoryReport();
+    Q_INVOKABLE QVariantMap sceneStatistics(const QStringList& names = QStringList());
+    Q_INVOKABLE QVariantMap visibleStatistics();
 
 public slots:
     QUrl getUrlForLocal(const QString& path);
-    bool playAnimation(int index, bool reset = true, double duration = -1, double end = -1, double start = -1);
-    bool playAnimationForName(const QString& name, bool reset = true, double duration = -1, double end = -1, double start = -1);
-    bool stopAnimation(int index, bool reset = true);
-    bool stopAnimationForName(const QString& name, bool reset = true);
-    bool stopAnimationAll(bool reset = true);
-    bool playFly(int index);
-    bool playFlyForName(const QString& name);
-    bool stopFly();
-    void playParticle(const QColor& fromColor, const QColor& toColor, double speed);
-    void stopParticle();
-    void playGrow(const QString& name, const QColor& color);
-    void stopGrow(const QString& name);
+    int playAnimation(int index, bool reset = true, double duration = -1, double end = -1, double start = -1);
+    int playAnimationForName(const QString& name, bool reset = true, double duration = -1, double end = -1, double start = -1);
+    int stopAnimation(int index, bool reset = true);
+    int stopAnimationForName(const QString& name, bool reset = true);
+    int stopAnimationAll(bool reset = true);
+    int playFly(int index);
+    int playFlyForName(const QString& name);
+    int stopFly();
+    int playParticle(const QColor& fromColor, const QColor& toColor, double speed);
+    int stopParticle();
+    int playGrow(const QString& name, const QColor& color);
+    int stopGrow(const QString& name);
+
+private:
+    void addView(osgViewer::Viewer* viewer);
+    void setupView(osgViewer::Viewer* viewer);
+    bool isSecondaryViewMoving() const;
+    void updatePaused();
+    void updateSceneOwner();
+    int pushCommand(const std::function<bool()>& command, const std::function<void(bool)>& completed = nullptr);
+    int pushHome(const std::function<void()>& setHome);
 
 private:
     osgViewer::Viewer* m_viewer = nullptr;
+    std::atomic<osgViewer::Viewer*> m_sceneOwner { nullptr };
+    std::atomic<unsigned int> m_frameNumber { 0 };
+    std::vector<osgViewer::Viewer*> m_viewList;
+    std::set<osgViewer::Viewer*> m_suspendedViews;
     QThread* m_loadThread = nullptr;
     QUrl m_rootNodeUrl;
     QStringList m_animationList;
     QVariantMap m_homePos;
     QVariantList m_flyPosList;
+    QStringList m_batchExcludeList;
     QVariantMap m_animationsStatus;
     QVariantMap m_rootNodeMatrix;
     QVariantMap m_particleMatrix;
@@ -108,19 +178,49 @@ private:
     osg::ref_ptr<GParticle> m_particle;
     osg::ref_ptr<GManipulator> m_manipulator;
     osg::ref_ptr<GAnimationManager> m_animationManager;
+    osg::ref_ptr<osgUtil::IncrementalCompileOperation> m_compileOperation;
+    osg::ref_ptr<GTextureManager> m_textureManager;
+    osg::ref_ptr<GSimulation> m_simulation;
+    osg::ref_ptr<GCommandQueue> m_commandQueue;
+    GSceneAnalysis::NameIndex m_nameIndex;
     osg::Vec3d m_platformTranslate;
+    double m_viewSize = -1;
+    osg::Matrixd m_sceneRootMatrix;
+    osg::Matrixd m_sceneParticleMatrix;
+    double m_compileBudget = 4.0;
+    bool m_textureCompression = true;
+    int m_textureBudget = 256;
+    qint64 m_textureResidentBytes = 0;
+    int m_pagerThreads = 2;
+    int m_pagerMemoryCap = 1024;
+    unsigned long long m_tileBytes = 0;
     int m_flyIndex = -1;
-    bool m_loading = false;
+    int m_commandId = 0;
+    std::atomic<bool> m_loading { false };
     bool m_hasError = false;
-    bool m_requestDestroy = false;
+    std::atomic<bool> m_requestDestroy { false };
+    std::atomic<bool> m_sceneActive { false };
+    bool m_particlePlaying = false;
     QString m_errorMessage;
     QMutex m_mutex;
+    QMutex m_contextMutex;
+    QHash<QOpenGLContext*, unsigned int> m_contextIds;
+    std::shared_timed_mutex m_sceneLock;
+    std::shared_timed_mutex m_frameLock;
 
 signals:
     void rootNodeChanged();
     void animationListChanged();
     void homePosChanged();
     void flyPosListChanged();
+    void batchExcludeListChanged();
+    void compileBudgetChanged();
+    void textureCompressionChanged();
+    void textureBudgetChanged();
+    void textureResidentBytesChanged();
+    void pagerThreadsChanged();
+    void pagerMemoryCapChanged();
+    void simulationRateChanged();
     void animationsStatusChanged();
     void rootNodeMatrixChanged();
     void particleMatrixChanged();
@@ -128,6 +228,8 @@ signals:
     void loadingChanged();
     void hasErrorChanged();
     void errorMessageChanged();
+    void frameRequested();
+    void commandCompleted(int id, bool ok);
 };
 
 #endif // GOSGCONTROL_H
@@ -11,15 +11,28 @@
  **********************************************************************************/
 
 #include "gosgrenderitem.h"
+#include "gcompile.h"
 #include "gosgcontrol.h"
 #include "gosgkeymap.h"
 #include <QKeyEvent>
 #include <QOpenGLFramebufferObjectFormat>
 #include <QOpenGLFunctions>
 #include <QQuickWindow>
+#include <QScreen>
 #include <QTimer>
+#include <cmath>
 
 #define RENDER_SAMPLES 4
+#define DEFAULT_BUDGET_FPS 60
+#define GOVERNOR_INTERVAL 50
+#define GOVERNOR_HOLD 500
+#define GOVERNOR_HALF_LIFE 1000
+#define RESOLUTION_HOLD 300
+#define RESOLUTION_INTERVAL 250
+#define RESOLUTION_STEP 0.1
+#define RESOLUTION_HEADROOM 0.6
+
+static const std::vector<double> INPUT_LATENCY_BOUNDS = { 8, 16, 33, 50, 100, 200 };
 
 class GOsgRenderItemPrivate : public QQuickFramebufferObject::Renderer {
 public:
@@ -33,30 +46,53 @@ private:
     {
         if (m_osgRender) {
             m_osgRender->doFrame();
-            if (m_osgRender->targetFpsRate() <= 0) {
+            QElapsedTimer captureTime;
+            captureTime.start();
+            // Screenshots and recordings read back the frame just drawn, mapped frames later.
+            m_readback.read(framebufferObject(), m_osgRender->frameCapture(), m_osgRender->mirrorVertically());
+            if (m_readback.isPending()) {
+                m_osgRender->recordCaptureCost(captureTime.nsecsElapsed() / 1000000.0);
+            }
+            if (m_osgRender->continuousFrames() || m_readback.isPending()) {
                 this->update();
             }
         }
     }
     QOpenGLFramebufferObject* createFramebufferObject(const QSize& size)
     {
+        Q_UNUSED(size);
+        // The item picks the size and samples, Qt stretches the texture over the item.
+        m_size = m_osgRender->framebufferSize();
+        m_samples = m_osgRender->renderSamples();
+        m_osgRender->resizeFramebuffer(m_size);
         QOpenGLFramebufferObjectFormat format;
-        format.setSamples(RENDER_SAMPLES);
+        format.setSamples(m_samples);
         format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-        return new QOpenGLFramebufferObject(size, format);
+        return new QOpenGLFramebufferObject(m_size, format);
     }
     void synchronize(QQuickFramebufferObject* item)
     {
         Q_UNUSED(item);
+        if (m_osgRender) {
+            m_osgRender->flushInput();
+            m_osgRender->updateResolution();
+            if (framebufferObject() && (m_size != m_osgRender->framebufferSize() || m_samples != m_osgRender->renderSamples())) {
+                invalidateFramebufferObject();
+            }
+        }
     }
 
 private:
     GOsgRenderItem* m_osgRender;
+    GFrameReadback m_readback;
+    QSize m_size;
+    int m_samples = 0;
 };
 
 GOsgRenderItem::GOsgRenderItem(QQuickItem* parent)
     : QQuickFramebufferObject(parent)
     , m_viewer(new osgViewer::Viewer())
+    , m_framePipeline(m_viewer)
     , m_osgControl(nullptr)
 {
     init();
@@ -68,7 +104,7 @@ GOsgRenderItem::~GOsgRenderItem()
 {
     m_viewer->setDone(true);
     if (m_osgControl) {
-        m_osgControl->requestDestroy();
+        m_osgControl->requestDestroy(m_viewer);
     }
 }
 
@@ -81,6 +117,74 @@ void GOsgRenderItem::setTargetFpsRate(int targetFpsRate)
     }
 }
 
+void GOsgRenderItem::setFrameGovernor(bool frameGovernor)
+{
+    if (m_frameGovernor != frameGovernor) {
+        m_frameGovernor = frameGovernor;
+        if (m_governorTimerId >= 0) {
+            this->killTimer(m_governorTimerId);
+            m_governorTimerId = -1;
+        }
+        m_vsyncFrames = false;
+        m_governedFpsRate = 0;
+        if (m_frameGovernor) {
+            m_governorTime.start();
+            wakeGovernor();
+        } else {
+            configFrameTimer();
+            this->update();
+        }
+        emit frameGovernorChanged();
+    }
+}
+
+void GOsgRenderItem::setTargetFrameTime(double targetFrameTime)
+{
+    if (m_targetFrameTime != targetFrameTime && targetFrameTime > 0) {
+        m_targetFrameTime = targetFrameTime;
+        wakeGovernor();
+        emit targetFrameTimeChanged();
+    }
+}
+
+void GOsgRenderItem::setIdleFpsRate(int idleFpsRate)
+{
+    if (m_idleFpsRate != idleFpsRate && idleFpsRate >= 0) {
+        m_idleFpsRate = idleFpsRate;
+        wakeGovernor();
+        emit idleFpsRateChanged();
+    }
+}
+
+void GOsgRenderItem::setDynamicResolution(bool dynamicResolution)
+{
+    if (m_dynamicResolution != dynamicResolution) {
+        m_dynamicResolution = dynamicResolution;
+        this->update();
+        emit dynamicResolutionChanged();
+    }
+}
+
+void GOsgRenderItem::setMinResolutionScale(double minResolutionScale)
+{
+    minResolutionScale = qBound(0.1, minResolutionScale, 1.0);
+    if (m_minResolutionScale != minResolutionScale) {
+        m_minResolutionScale = minResolutionScale;
+        emit minResolutionScaleChanged();
+    }
+}
+
+void GOsgRenderItem::setPipelined(bool pipelined)
+{
+    if (m_pipelined != pipelined) {
+        m_pipelined = pipelined;
+        m_latencyStats.clear();
+        m_inputLatency->clear();
+        this->update();
+        emit pipelinedChanged();
+    }
+}
+
 void GOsgRenderItem::setBackgroundColor(const QColor& color)
 {
     if (m_backgroundColor != color) {
@@ -95,10 +199,58 @@ void GOsgRenderItem::setOsgControl(GOsgControl* osgControl)
     if (m_osgControl != osgControl) {
         m_osgControl = osgControl;
         osgControl->init(m_viewer);
+        osgControl->suspendView(m_viewer, m_suspended);
+        // Frames are stamped with the simulation clock so animation advances in fixed ticks.
+        m_framePipeline.setClock([osgControl]() { return osgControl->simulationTime(); });
+        // Views share the pager and texture manager, so their frames are numbered from one count.
+        osgViewer::Viewer* viewer = m_viewer.get();
+        m_framePipeline.setFrameCounter([osgControl, viewer]() { return osgControl->nextFrameNumber(viewer); });
+        m_framePipeline.setSceneLock(osgControl->sceneLock(), !osgControl->isPrimaryView(m_viewer));
+        // State changes made from QML need a frame even when the governor has gone idle.
+        connect(osgControl, &GOsgControl::loadingChanged, this, &GOsgRenderItem::wakeGovernor);
+        connect(osgControl, &GOsgControl::flyIndexChanged, this, &GOsgRenderItem::wakeGovernor);
+        connect(osgControl, &GOsgControl::animationsStatusChanged, this, &GOsgRenderItem::wakeGovernor);
+        connect(osgControl, &GOsgControl::rootNodeMatrixChanged, this, &GOsgRenderItem::wakeGovernor);
+        connect(osgControl, &GOsgControl::particleMatrixChanged, this, &GOsgRenderItem::wakeGovernor);
+        connect(osgControl, &GOsgControl::frameRequested, this, &GOsgRenderItem::wakeGovernor);
         emit osgControlChanged();
     }
 }
 
+bool GOsgRenderItem::grabFrame(const QString& path)
+{
+    if (!m_frameCapture.grab(path)) {
+        return false;
+    }
+    this->update();
+    return true;
+}
+
+bool GOsgRenderItem::startRecording(const QString& path, bool raw)
+{
+    if (!m_frameCapture.startRecording(path, raw)) {
+        return false;
+    }
+    this->update();
+    emit recordingChanged();
+    return true;
+}
+
+void GOsgRenderItem::stopRecording()
+{
+    if (m_frameCapture.isRecording()) {
+        m_frameCapture.stopRecording();
+        // The next frame hands the finish marker to the writer.
+        this->update();
+        emit recordingChanged();
+    }
+}
+
+void GOsgRenderItem::recordCaptureCost(double time)
+{
+    m_captureCost = m_captureCost.load() * 0.9 + time * 0.1;
+}
+
 QQuickFramebufferObject::Renderer* GOsgRenderItem::createRenderer() const
 {
     return new GOsgRenderItemPrivate(this);
@@ -106,11 +258,59 @@ QQuickFramebufferObject::Renderer* GOsgRenderItem::createRenderer() const
 
 void GOsgRenderItem::doFrame()
 {
+    // The control swaps a loaded model in between frames, never while one is in flight.
+    std::shared_lock<std::shared_timed_mutex> frameLocker;
+    if (m_osgControl) {
+        frameLocker = std::shared_lock<std::shared_timed_mutex>(*m_osgControl->frameLock());
+    }
     if (m_osgControl && m_osgControl->checkFrameAllowed()) {
         QOpenGLContext::currentContext()->functions()->glUseProgram(0);
-        m_viewer->frame();
+        if (m_frameClock.isValid() && m_frameClock.elapsed() < 250) {
+            m_frameInterval = m_frameInterval.load() * 0.9 + m_frameClock.nsecsElapsed() / 1000000.0 * 0.1;
+        }
+        m_frameClock.start();
+        // The first frame realizes the viewer serially, the pipeline takes over after it.
+        if (m_pipelined != m_framePipeline.isRunning() && m_viewer->getFrameStamp()->getFrameNumber() > 0) {
+            if (m_pipelined) {
+                m_framePipeline.start();
+            } else {
+                m_framePipeline.stop();
+            }
+        }
+        QElapsedTimer frameTime;
+        frameTime.start();
+        double latency = 0;
+        if (m_framePipeline.isRunning()) {
+            latency = m_framePipeline.frame();
+        } else if (m_viewer->getFrameStamp()->getFrameNumber() == 0) {
+            // Views on one Qt context share its GL objects, the first frame realizes with that id.
+            m_osgControl->shareContext(QOpenGLContext::currentContext(), m_gw);
+            std::unique_lock<std::shared_timed_mutex> sceneLocker(*m_osgControl->sceneLock());
+            m_viewer->frame(m_osgControl->simulationTime());
+            latency = frameTime.nsecsElapsed() / 1000000.0;
+        } else {
+            m_viewer->advance(m_osgControl->simulationTime());
+            m_viewer->getFrameStamp()->setFrameNumber(m_osgControl->nextFrameNumber(m_viewer.get()));
+            m_viewer->eventTraversal();
+            {
+                std::unique_lock<std::shared_timed_mutex> sceneLocker(*m_osgControl->sceneLock());
+                m_viewer->updateTraversal();
+            }
+            {
+                std::shared_lock<std::shared_timed_mutex> sceneLocker(*m_osgControl->sceneLock());
+                m_viewer->renderingTraversals();
+            }
+            latency = frameTime.nsecsElapsed() / 1000000.0;
+        }
+        double time = frameTime.nsecsElapsed() / 1000000.0;
+        m_frameCost = m_frameCost.load() * 0.9 + time * 0.1;
+        m_latencyStats.addFrame(latency);
+        m_inputLatency->frameDrawn(m_framePipeline.isRunning() ? m_framePipeline.drawnFrameNumber() : m_viewer->getFrameStamp()->getFrameNumber());
+        recordFrameTime(time);
         computerFpsRate(true);
     } else {
+        // Nothing may stay in flight while the control reloads the scene.
+        m_framePipeline.stop();
         computerFpsRate(false);
     }
 }
@@ -122,7 +322,16 @@ void GOsgRenderItem::init()
     this->setAcceptHoverEvents(true);
     this->setFocus(true);
     this->setMirrorVertically(true);
+    this->setTextureFollowsItemSize(false);
     m_fpsTime.restart();
+    m_resolutionTime.start();
+    m_renderSamples = RENDER_SAMPLES;
+    m_frameCapture.setSavedCallback([this](const QString& path) {
+        QMetaObject::invokeMethod(
+            this, [this, path]() { emit frameSaved(path); }, Qt::QueuedConnection);
+    });
+    connect(this, &QQuickItem::visibleChanged, this, &GOsgRenderItem::updateSuspended);
+    connect(this, &QQuickItem::opacityChanged, this, &GOsgRenderItem::updateSuspended);
 }
 
 void GOsgRenderItem::initOsg()
@@ -142,6 +351,9 @@ void GOsgRenderItem::initOsg()
     traits->windowDecoration = false;
     traits->useCursor = false;
     m_gw = new osgViewer::GraphicsWindowEmbedded(traits);
+    m_inputQueue.setEventQueue(m_gw->getEventQueue());
+    m_inputLatency = new GInputLatency;
+    m_viewer->addEventHandler(m_inputLatency);
     m_viewer->getCamera()->setGraphicsContext(m_gw);
     m_viewer->getCamera()->setViewport(0, 0, this->width(), this->height());
     m_viewer->getCamera()->setClearColor(osg::Vec4(m_backgroundColor.red(), m_backgroundColor.green(), m_backgroundColor.blue(), m_backgroundColor.alpha()));
@@ -153,14 +365,25 @@ void GOsgRenderItem::initOsg()
 
 void GOsgRenderItem::initWindow()
 {
+    if (m_window) {
+        m_window->removeEventFilter(this);
+        disconnect(m_window, nullptr, this, nullptr);
+    }
+    m_window = this->window();
     if (this->window()) {
         //        QSurfaceFormat format = this->window()->requestedFormat();
         //        format.setVersion(3, 2);
         //        format.setSamples(RENDER_SAMPLES);
         //        format.setSwapBehavior(QSurfaceFormat::DoubleBuffer);
         //        this->window()->setFormat(format);
+        // Emitted on the thread that swapped the buffers, directly after the swap.
+        connect(this->window(), &QQuickWindow::frameSwapped, this, &GOsgRenderItem::recordSwap, Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection));
+        connect(this->window(), &QWindow::visibilityChanged, this, &GOsgRenderItem::updateSuspended);
+        // Exposure has no signal, occlusion and minimizing arrive as expose events.
+        this->window()->installEventFilter(this);
         configFrameTimer();
     }
+    updateSuspended();
 }
 
 void GOsgRenderItem::setKeyboardModifiers(QInputEvent* event)
@@ -173,17 +396,71 @@ void GOsgRenderItem::setKeyboardModifiers(QInputEvent* event)
         mask |= osgGA::GUIEventAdapter::MODKEY_CTRL;
     if (modkey & Qt::AltModifier)
         mask |= osgGA::GUIEventAdapter::MODKEY_ALT;
-    m_gw->getEventQueue()->getCurrentEventState()->setModKeyMask(mask);
+    m_inputQueue.setModKeyMask(mask);
+}
+
+void GOsgRenderItem::flushInput()
+{
+    m_inputQueue.flush();
 }
 
 void GOsgRenderItem::updateOsgSize(const QSizeF& size)
 {
+    // Input stays in item coordinates, the context and viewport follow the framebuffer.
     m_gw->getEventQueue()->windowResize(0, 0, size.width(), size.height());
+    this->update();
+}
+
+void GOsgRenderItem::resizeFramebuffer(const QSize& size)
+{
+    m_framePipeline.wait();
     m_gw->resized(0, 0, size.width(), size.height());
-    m_viewer->getCamera()->resize(size.width(), size.height());
+    m_viewer->getCamera()->setViewport(0, 0, size.width(), size.height());
     m_viewer->getCamera()->setProjectionMatrixAsPerspective(45, (double)size.width() / (double)size.height(), 1.0f, 10000.0f);
 }
 
+QSize GOsgRenderItem::framebufferSize() const
+{
+    qreal ratio = window() ? window()->effectiveDevicePixelRatio() : 1.0;
+    return QSize(qMax(1, qRound(this->width() * ratio * m_resolutionScale)), qMax(1, qRound(this->height() * ratio * m_resolutionScale)));
+}
+
+void GOsgRenderItem::updateResolution()
+{
+    double scale = 1.0;
+    int samples = RENDER_SAMPLES;
+    bool moving = (m_interactionTime.isValid() && m_interactionTime.elapsed() < RESOLUTION_HOLD) || (m_osgControl && m_osgControl->isViewMoving());
+    // A recording keeps one frame size, full resolution and MSAA stay on until it stops.
+    if (m_dynamicResolution && moving && !m_frameCapture.isRecording()) {
+        scale = m_resolutionScale;
+        samples = m_renderSamples;
+        if (m_resolutionTime.elapsed() >= RESOLUTION_INTERVAL) {
+            m_resolutionTime.restart();
+            // Frames paced by vsync hide the GPU cost in the interval, timed frames only show CPU cost.
+            double cost = continuousFrames() ? std::max(m_frameCost.load(), m_frameInterval.load()) : m_frameCost.load();
+            double budget = frameBudget();
+            if (cost > budget) {
+                // MSAA goes first, then the resolution in steps down to the minimum.
+                if (samples > 0) {
+                    samples = 0;
+                } else {
+                    scale = std::max(m_minResolutionScale, scale - RESOLUTION_STEP);
+                }
+            } else if (cost < budget * RESOLUTION_HEADROOM) {
+                scale = std::min(1.0, scale + RESOLUTION_STEP);
+            }
+        }
+    }
+    if (m_resolutionScale != scale) {
+        m_resolutionScale = scale;
+        emit resolutionScaleChanged();
+    }
+    if (m_renderSamples != samples) {
+        m_renderSamples = samples;
+        emit renderSamplesChanged();
+    }
+}
+
 void GOsgRenderItem::computerFpsRate(bool enable)
 {
     if (enable) {
@@ -196,7 +473,80 @@ void GOsgRenderItem::computerFpsRate(bool enable)
             emit currentFpsRateChanged();
         }
         m_fpsCount = 0;
+        emit frameStatsChanged();
+    }
+}
+
+void GOsgRenderItem::recordFrameTime(double time)
+{
+    m_frameStats.addFrame(time);
+    bool compiling = GCompile::pendingCount(m_viewer->getIncrementalCompileOperation()) > 0;
+    if (compiling && !m_warmup) {
+        m_warmup = true;
+        m_warmupStats.clear();
+    }
+    if (m_warmup) {
+        m_warmupStats.addFrame(time);
+    }
+    if (m_warmup && !compiling) {
+        m_warmup = false;
+    }
+}
+
+double GOsgRenderItem::frameBudget() const
+{
+    if (m_frameGovernor) {
+        return m_targetFrameTime;
+    }
+    return 1000.0 / (m_targetFpsRate > 0 ? m_targetFpsRate : DEFAULT_BUDGET_FPS);
+}
+
+QVariantList GOsgRenderItem::inputLatencyHistogram() const
+{
+    const std::vector<unsigned int>& buckets = m_inputLatency->swapStats().histogram(INPUT_LATENCY_BOUNDS);
+    QVariantList histogram;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        if (i < INPUT_LATENCY_BOUNDS.size()) {
+            histogram.append(QVariantMap { { "max", INPUT_LATENCY_BOUNDS.at(i) }, { "count", buckets.at(i) } });
+        } else {
+            histogram.append(QVariantMap { { "min", INPUT_LATENCY_BOUNDS.back() }, { "count", buckets.at(i) } });
+        }
     }
+    return histogram;
+}
+
+QVariantMap GOsgRenderItem::frameStats() const
+{
+    double budget = frameBudget();
+    return QVariantMap {
+        { "budget", budget },
+        { "p50", m_frameStats.percentile(50) },
+        { "p95", m_frameStats.percentile(95) },
+        { "p99", m_frameStats.percentile(99) },
+        { "max", m_frameStats.maximum() },
+        { "overBudget", m_frameStats.framesOver(budget) },
+        { "warmup", m_warmup.load() },
+        { "warmupFrames", m_warmupStats.total() },
+        { "warmupP95", m_warmupStats.percentile(95) },
+        { "warmupMax", m_warmupStats.maximum() },
+        { "warmupOverBudget", m_warmupStats.framesOver(budget) },
+        { "pipelined", m_framePipeline.isRunning() },
+        { "suspended", m_suspended.load() },
+        { "recording", m_frameCapture.isRecording() },
+        { "captureFrames", m_frameCapture.capturedFrames() },
+        { "captureDropped", m_frameCapture.droppedFrames() },
+        { "captureCost", m_captureCost.load() },
+        { "latencyP50", m_latencyStats.percentile(50) },
+        { "latencyP95", m_latencyStats.percentile(95) },
+        { "inputRaw", (double)m_inputQueue.rawEvents() },
+        { "inputDelivered", (double)m_inputQueue.deliveredEvents() },
+        { "inputToDrawP50", m_inputLatency->drawStats().percentile(50) },
+        { "inputToDrawP95", m_inputLatency->drawStats().percentile(95) },
+        { "inputToSwapP50", m_inputLatency->swapStats().percentile(50) },
+        { "inputToSwapP95", m_inputLatency->swapStats().percentile(95) },
+        { "inputToSwapMax", m_inputLatency->swapStats().maximum() },
+        { "inputToSwapHistogram", inputLatencyHistogram() },
+    };
 }
 
 void GOsgRenderItem::configFrameTimer()
@@ -205,10 +555,103 @@ void GOsgRenderItem::configFrameTimer()
         this->killTimer(m_frameTimerId);
         m_frameTimerId = -1;
     }
-    if (window() && m_targetFpsRate > 0) {
-        m_frameTimerId = this->startTimer(qRound(1000.0 / m_targetFpsRate), Qt::CoarseTimer);
+    int fpsRate = m_frameGovernor ? m_governedFpsRate : m_targetFpsRate;
+    if (window() && fpsRate > 0 && !m_suspended && !continuousFrames()) {
+        m_frameTimerId = this->startTimer(qRound(1000.0 / fpsRate), Qt::PreciseTimer);
+    }
+}
+
+void GOsgRenderItem::updateSuspended()
+{
+    QQuickWindow* window = this->window();
+    bool suspended = !isVisible() || opacity() <= 0 || !window || !window->isExposed()
+        || window->visibility() == QWindow::Hidden || window->visibility() == QWindow::Minimized;
+    if (m_suspended == suspended) {
+        return;
+    }
+    m_suspended = suspended;
+    if (m_osgControl) {
+        m_osgControl->suspendView(m_viewer, suspended);
+    }
+    if (m_governorTimerId >= 0) {
+        this->killTimer(m_governorTimerId);
+        m_governorTimerId = -1;
+    }
+    if (m_frameGovernor) {
+        setGovernedFpsRate(0);
+    }
+    configFrameTimer();
+    if (!suspended) {
+        // Resumes at full rate, the governor settles from there.
+        if (m_frameGovernor) {
+            wakeGovernor();
+        }
+        this->update();
+    }
+    emit suspendedChanged();
+}
+
+void GOsgRenderItem::interact()
+{
+    m_interactionTime.start();
+    wakeGovernor();
+}
+
+void GOsgRenderItem::recordSwap()
+{
+    m_inputLatency->frameSwapped();
+}
+
+void GOsgRenderItem::wakeGovernor()
+{
+    if (!m_frameGovernor || m_suspended) {
+        return;
+    }
+    m_lastActivity = m_governorTime.elapsed();
+    if (m_governorTimerId < 0) {
+        m_governorTimerId = this->startTimer(GOVERNOR_INTERVAL, Qt::PreciseTimer);
+    }
+    updateGovernor();
+}
+
+void GOsgRenderItem::updateGovernor()
+{
+    qint64 now = m_governorTime.elapsed();
+    if (m_osgControl && m_osgControl->hasActivity()) {
+        m_lastActivity = now;
+    }
+    // The measured frame cost caps the rate, scheduling faster only queues frames.
+    double fpsRate = 1000.0 / std::max(m_targetFrameTime, m_frameCost.load());
+    qint64 idleTime = now - m_lastActivity - GOVERNOR_HOLD;
+    if (idleTime > 0) {
+        // Halves once per half-life so the frame timer is not restarted every tick.
+        fpsRate = std::max((double)m_idleFpsRate, fpsRate / std::pow(2.0, (double)(idleTime / GOVERNOR_HALF_LIFE + 1)));
+    }
+    setGovernedFpsRate(fpsRate < 1 ? 0 : qRound(fpsRate));
+    if (m_governedFpsRate == 0 && m_governorTimerId >= 0) {
+        // Fully idle, input and GOsgControl signals wake the governor again.
+        this->killTimer(m_governorTimerId);
+        m_governorTimerId = -1;
     }
 }
+
+void GOsgRenderItem::setGovernedFpsRate(int governedFpsRate)
+{
+    if (m_governedFpsRate == governedFpsRate) {
+        return;
+    }
+    m_governedFpsRate = governedFpsRate;
+    // At the display refresh rate the scene graph render loop paces frames on vsync.
+    qreal refreshRate = window() && window()->screen() ? window()->screen()->refreshRate() : DEFAULT_BUDGET_FPS;
+    bool vsyncFrames = governedFpsRate > 0 && governedFpsRate >= refreshRate - 1;
+    bool startFrames = vsyncFrames && !m_vsyncFrames;
+    m_vsyncFrames = vsyncFrames;
+    configFrameTimer();
+    if (startFrames) {
+        this->update();
+    }
+    emit governedFpsRateChanged();
+}
 #if QT_VERSION_MAJOR >= 6
 void GOsgRenderItem::geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry)
 {
@@ -228,6 +671,7 @@ void GOsgRenderItem::mousePressEvent(QMouseEvent* event)
     this->setFocus(true);
     QQuickItem::mousePressEvent(event);
     event->accept();
+    interact();
     int button = 0;
     switch (event->button()) {
     case Qt::LeftButton:
@@ -247,13 +691,14 @@ void GOsgRenderItem::mousePressEvent(QMouseEvent* event)
         break;
     }
     setKeyboardModifiers(event);
-    m_gw->getEventQueue()->mouseButtonPress(event->localPos().x(), event->localPos().y(), button);
+    m_inputQueue.mouseButtonPress(event->localPos().x(), event->localPos().y(), button);
 }
 
 void GOsgRenderItem::mouseReleaseEvent(QMouseEvent* event)
 {
     QQuickItem::mouseReleaseEvent(event);
     event->accept();
+    interact();
     int button = 0;
     switch (event->button()) {
     case Qt::LeftButton:
@@ -273,21 +718,23 @@ void GOsgRenderItem::mouseReleaseEvent(QMouseEvent* event)
         break;
     }
     setKeyboardModifiers(event);
-    m_gw->getEventQueue()->mouseButtonRelease(event->localPos().x(), event->localPos().y(), button);
+    m_inputQueue.mouseButtonRelease(event->localPos().x(), event->localPos().y(), button);
 }
 
 void GOsgRenderItem::mouseMoveEvent(QMouseEvent* event)
 {
     QQuickItem::mouseMoveEvent(event);
     event->accept();
+    interact();
     setKeyboardModifiers(event);
-    m_gw->getEventQueue()->mouseMotion(event->localPos().x(), event->localPos().y());
+    m_inputQueue.mouseMotion(event->localPos().x(), event->localPos().y());
 }
 
 void GOsgRenderItem::mouseDoubleClickEvent(QMouseEvent* event)
 {
     QQuickItem::mouseDoubleClickEvent(event);
     event->accept();
+    interact();
     int button = 0;
     switch (event->button()) {
     case Qt::LeftButton:
@@ -307,38 +754,34 @@ void GOsgRenderItem::mouseDoubleClickEvent(QMouseEvent* event)
         break;
     }
     setKeyboardModifiers(event);
-    m_gw->getEventQueue()->mouseDoubleButtonPress(event->localPos().x(), event->localPos().y(), button);
+    m_inputQueue.mouseDoubleButtonPress(event->localPos().x(), event->localPos().y(), button);
 }
 
 void GOsgRenderItem::touchEvent(QTouchEvent* event)
 {
     QQuickItem::touchEvent(event);
     event->accept();
+    interact();
     const QList<QTouchEvent::TouchPoint>& touchPoints = static_cast<QTouchEvent*>(event)->touchPoints();
     if (touchPoints.count() >= 2) {
-        osg::ref_ptr<osgGA::GUIEventAdapter> osg_event(NULL);
+        std::vector<GInputQueue::TouchPoint> points;
         for (const QTouchEvent::TouchPoint& touchPoint : touchPoints) {
-            const QPointF& touchPos = touchPoint.pos();
+            GInputQueue::TouchPoint point;
+            point.id = touchPoint.id();
+            point.x = touchPoint.pos().x();
+            point.y = touchPoint.pos().y();
             if ((Qt::TouchPointState)touchPoint.state() == Qt::TouchPointPressed) {
-                if (!osg_event) {
-                    osg_event = m_gw->getEventQueue()->touchBegan(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_BEGAN, touchPos.x(), touchPos.y());
-                } else {
-                    osg_event->addTouchPoint(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_BEGAN, touchPos.x(), touchPos.y());
-                }
+                point.phase = osgGA::GUIEventAdapter::TOUCH_BEGAN;
             } else if ((Qt::TouchPointState)touchPoint.state() == Qt::TouchPointMoved) {
-                if (!osg_event) {
-                    osg_event = m_gw->getEventQueue()->touchMoved(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_MOVED, touchPos.x(), touchPos.y());
-                } else {
-                    osg_event->addTouchPoint(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_MOVED, touchPos.x(), touchPos.y());
-                }
+                point.phase = osgGA::GUIEventAdapter::TOUCH_MOVED;
             } else if ((Qt::TouchPointState)touchPoint.state() == Qt::TouchPointReleased) {
-                if (!osg_event) {
-                    osg_event = m_gw->getEventQueue()->touchEnded(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_ENDED, touchPos.x(), touchPos.y(), 1);
-                } else {
-                    osg_event->addTouchPoint(touchPoint.id(), osgGA::GUIEventAdapter::TOUCH_ENDED, touchPos.x(), touchPos.y());
-                }
+                point.phase = osgGA::GUIEventAdapter::TOUCH_ENDED;
+            } else {
+                continue;
             }
+            points.push_back(point);
         }
+        m_inputQueue.touch(points);
     }
 }
 
@@ -346,15 +789,16 @@ void GOsgRenderItem::wheelEvent(QWheelEvent* event)
 {
     QQuickItem::wheelEvent(event);
     event->accept();
+    interact();
     setKeyboardModifiers(event);
     if (event->angleDelta().x() < 0) {
-        m_gw->getEventQueue()->mouseScroll(osgGA::GUIEventAdapter::SCROLL_LEFT);
+        m_inputQueue.mouseScroll(osgGA::GUIEventAdapter::SCROLL_LEFT);
     } else if (event->angleDelta().x() > 0) {
-        m_gw->getEventQueue()->mouseScroll(osgGA::GUIEventAdapter::SCROLL_RIGHT);
+        m_inputQueue.mouseScroll(osgGA::GUIEventAdapter::SCROLL_RIGHT);
     } else if (event->angleDelta().y() < 0) {
-        m_gw->getEventQueue()->mouseScroll(osgGA::GUIEventAdapter::SCROLL_UP);
+        m_inputQueue.mouseScroll(osgGA::GUIEventAdapter::SCROLL_UP);
     } else if (event->angleDelta().y() > 0) {
-        m_gw->getEventQueue()->mouseScroll(osgGA::GUIEventAdapter::SCROLL_DOWN);
+        m_inputQueue.mouseScroll(osgGA::GUIEventAdapter::SCROLL_DOWN);
     }
 }
 
@@ -362,27 +806,37 @@ void GOsgRenderItem::keyPressEvent(QKeyEvent* event)
 {
     QQuickItem::keyPressEvent(event);
     event->accept();
+    interact();
     setKeyboardModifiers(event);
-    m_gw->getEventQueue()->keyPress(GOsgKeyMap::transKey(event->key(), event->text().toLocal8Bit()));
+    m_inputQueue.keyPress(GOsgKeyMap::transKey(event->key(), event->text().toLocal8Bit()));
 }
 
 void GOsgRenderItem::keyReleaseEvent(QKeyEvent* event)
 {
     QQuickItem::keyReleaseEvent(event);
     event->accept();
+    interact();
     if (event->isAutoRepeat()) {
         event->ignore();
     } else {
         setKeyboardModifiers(event);
-        m_gw->getEventQueue()->keyRelease(GOsgKeyMap::transKey(event->key(), event->text().toLocal8Bit()));
+        m_inputQueue.keyRelease(GOsgKeyMap::transKey(event->key(), event->text().toLocal8Bit()));
     }
 }
 
 void GOsgRenderItem::timerEvent(QTimerEvent* event)
 {
     if (event->timerId() == m_frameTimerId) {
-        if (m_targetFpsRate > 0) {
-            this->update();
-        }
+        this->update();
+    } else if (event->timerId() == m_governorTimerId) {
+        updateGovernor();
+    }
+}
+
+bool GOsgRenderItem::eventFilter(QObject* watched, QEvent* event)
+{
+    if (watched == m_window && event->type() == QEvent::Expose) {
+        updateSuspended();
     }
+    return QQuickFramebufferObject::eventFilter(watched, event);
 }
@@ -13,8 +13,16 @@
 #ifndef GOSGRENDERITEM_H
 #define GOSGRENDERITEM_H
 
+#include "gframecapture.h"
+#include "gframepipeline.h"
+#include "gframestats.h"
+#include "ginputlatency.h"
+#include "ginputqueue.h"
 #include <QElapsedTimer>
+#include <QPointer>
+#include <QVariantMap>
 #include <QtQuick/QQuickFramebufferObject>
+#include <atomic>
 #include <osgViewer/Viewer>
 
 class GOsgControl;
@@ -24,6 +32,18 @@ class GOsgRenderItem : public QQuickFramebufferObject {
     Q_DISABLE_COPY(GOsgRenderItem)
     Q_PROPERTY(int targetFpsRate READ targetFpsRate WRITE setTargetFpsRate NOTIFY targetFpsRateChanged)
     Q_PROPERTY(int currentFpsRate READ currentFpsRate NOTIFY currentFpsRateChanged)
+    Q_PROPERTY(bool frameGovernor READ frameGovernor WRITE setFrameGovernor NOTIFY frameGovernorChanged)
+    Q_PROPERTY(double targetFrameTime READ targetFrameTime WRITE setTargetFrameTime NOTIFY targetFrameTimeChanged)
+    Q_PROPERTY(int idleFpsRate READ idleFpsRate WRITE setIdleFpsRate NOTIFY idleFpsRateChanged)
+    Q_PROPERTY(int governedFpsRate READ governedFpsRate NOTIFY governedFpsRateChanged)
+    Q_PROPERTY(bool dynamicResolution READ dynamicResolution WRITE setDynamicResolution NOTIFY dynamicResolutionChanged)
+    Q_PROPERTY(double minResolutionScale READ minResolutionScale WRITE setMinResolutionScale NOTIFY minResolutionScaleChanged)
+    Q_PROPERTY(double resolutionScale READ resolutionScale NOTIFY resolutionScaleChanged)
+    Q_PROPERTY(int renderSamples READ renderSamples NOTIFY renderSamplesChanged)
+    Q_PROPERTY(bool pipelined READ pipelined WRITE setPipelined NOTIFY pipelinedChanged)
+    Q_PROPERTY(bool suspended READ suspended NOTIFY suspendedChanged)
+    Q_PROPERTY(bool recording READ recording NOTIFY recordingChanged)
+    Q_PROPERTY(QVariantMap frameStats READ frameStats NOTIFY frameStatsChanged)
     Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor NOTIFY backgroundColorChanged)
     Q_PROPERTY(GOsgControl* osgControl READ osgControl WRITE setOsgControl NOTIFY osgControlChanged)
 public:
@@ -33,14 +53,42 @@ public:
 public:
     inline int targetFpsRate() const { return m_targetFpsRate; }
     inline int currentFpsRate() const { return m_currentFpsRate; }
+    inline bool frameGovernor() const { return m_frameGovernor; }
+    inline double targetFrameTime() const { return m_targetFrameTime; }
+    inline int idleFpsRate() const { return m_idleFpsRate; }
+    inline int governedFpsRate() const { return m_governedFpsRate; }
+    inline bool continuousFrames() const { return !m_suspended && (m_frameGovernor ? m_vsyncFrames.load() : m_targetFpsRate <= 0); }
+    inline bool dynamicResolution() const { return m_dynamicResolution; }
+    inline double minResolutionScale() const { return m_minResolutionScale; }
+    inline double resolutionScale() const { return m_resolutionScale; }
+    inline int renderSamples() const { return m_renderSamples; }
+    inline bool pipelined() const { return m_pipelined; }
+    inline bool suspended() const { return m_suspended; }
+    inline bool recording() const { return m_frameCapture.isRecording(); }
+    QVariantMap frameStats() const;
     inline QColor backgroundColor() { return m_backgroundColor; }
     inline GOsgControl* osgControl() { return m_osgControl; }
     void setTargetFpsRate(int targetFpsRate);
+    void setFrameGovernor(bool frameGovernor);
+    void setTargetFrameTime(double targetFrameTime);
+    void setIdleFpsRate(int idleFpsRate);
+    void setDynamicResolution(bool dynamicResolution);
+    void setMinResolutionScale(double minResolutionScale);
+    void setPipelined(bool pipelined);
     void setBackgroundColor(const QColor& color);
     void setOsgControl(GOsgControl* osgControl);
+    Q_INVOKABLE bool grabFrame(const QString& path);
+    Q_INVOKABLE bool startRecording(const QString& path, bool raw = false);
+    Q_INVOKABLE void stopRecording();
     //
     osgViewer::Viewer* getViewer() const { return m_viewer.get(); }
     void doFrame();
+    void updateResolution();
+    void flushInput();
+    QSize framebufferSize() const;
+    inline GFrameCapture* frameCapture() { return &m_frameCapture; }
+    void recordCaptureCost(double time);
+    void resizeFramebuffer(const QSize& size);
 
 protected:
     Renderer* createRenderer() const override;
@@ -58,6 +106,7 @@ protected:
     virtual void keyPressEvent(QKeyEvent* event) override;
     virtual void keyReleaseEvent(QKeyEvent* event) override;
     virtual void timerEvent(QTimerEvent* event) override;
+    virtual bool eventFilter(QObject* watched, QEvent* event) override;
 
 private:
     void init();
@@ -67,21 +116,72 @@ private:
     void updateOsgSize(const QSizeF& size);
     void computerFpsRate(bool enable);
     void configFrameTimer();
+    void updateSuspended();
+    void interact();
+    void recordSwap();
+    void wakeGovernor();
+    void updateGovernor();
+    void setGovernedFpsRate(int governedFpsRate);
+    void recordFrameTime(double time);
+    double frameBudget() const;
+    QVariantList inputLatencyHistogram() const;
 
 private:
     osg::ref_ptr<osgViewer::Viewer> m_viewer;
     osg::ref_ptr<osgViewer::GraphicsWindowEmbedded> m_gw;
+    GInputQueue m_inputQueue;
+    osg::ref_ptr<GInputLatency> m_inputLatency;
     QElapsedTimer m_fpsTime;
+    GFrameStats m_frameStats;
+    GFrameStats m_warmupStats;
+    GFrameStats m_latencyStats;
+    GFramePipeline m_framePipeline;
+    GFrameCapture m_frameCapture;
+    std::atomic<double> m_captureCost { 0 };
+    std::atomic<bool> m_pipelined { false };
+    std::atomic<bool> m_suspended { false };
+    QPointer<QQuickWindow> m_window;
+    std::atomic<bool> m_warmup { false };
     GOsgControl* m_osgControl = nullptr;
     QColor m_backgroundColor = Qt::black;
     int m_targetFpsRate = 0;
     int m_currentFpsRate = 0;
     int m_fpsCount = 0;
     int m_frameTimerId = -1;
+    bool m_frameGovernor = false;
+    double m_targetFrameTime = 1000.0 / 60;
+    int m_idleFpsRate = 5;
+    int m_governedFpsRate = 0;
+    int m_governorTimerId = -1;
+    QElapsedTimer m_governorTime;
+    qint64 m_lastActivity = 0;
+    std::atomic<double> m_frameCost { 0 };
+    std::atomic<bool> m_vsyncFrames { false };
+    bool m_dynamicResolution = false;
+    double m_minResolutionScale = 0.5;
+    double m_resolutionScale = 1.0;
+    int m_renderSamples = 0;
+    QElapsedTimer m_interactionTime;
+    QElapsedTimer m_resolutionTime;
+    QElapsedTimer m_frameClock;
+    std::atomic<double> m_frameInterval { 0 };
 
 signals:
     void targetFpsRateChanged();
     void currentFpsRateChanged();
+    void frameGovernorChanged();
+    void targetFrameTimeChanged();
+    void idleFpsRateChanged();
+    void governedFpsRateChanged();
+    void dynamicResolutionChanged();
+    void minResolutionScaleChanged();
+    void resolutionScaleChanged();
+    void renderSamplesChanged();
+    void pipelinedChanged();
+    void suspendedChanged();
+    void recordingChanged();
+    void frameSaved(const QString& path);
+    void frameStatsChanged();
     void backgroundColorChanged();
     void osgControlChanged();
 };
@@ -0,0 +1,55 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gparallel.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace GParallel {
+
+unsigned int threadCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void forEach(size_t count, const std::function<void(size_t)>& function, unsigned int threads)
+{
+    if (threads == 0) {
+        threads = threadCount();
+    }
+    threads = (unsigned int)std::min<size_t>(threads, count);
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned int i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+};
@@ -0,0 +1,26 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GPARALLEL_H
+#define GPARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+namespace GParallel {
+
+extern unsigned int threadCount();
+extern void forEach(size_t count, const std::function<void(size_t)>& function, unsigned int threads = 0);
+
+};
+
+#endif // GPARALLEL_H
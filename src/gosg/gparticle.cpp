@@ -28,7 +28,8 @@ GParticle::GParticle(double size)
     particleTempalte.setMass(0.01f);
     particleTempalte.setRadius(0.1f);
     osg::ref_ptr<osgParticle::ParticleSystem> particleSystem = new osgParticle::ParticleSystem;
-    particleSystem->setDataVariance(osg::Node::STATIC);
+    // Updated every frame while the previous frame draws, the update waits for its draw.
+    particleSystem->setDataVariance(osg::Node::DYNAMIC);
     particleSystem->setDefaultAttributes("./sources/particle/sphere.png", false, true);
     particleSystem->setDefaultParticleTemplate(particleTempalte);
     osg::ref_ptr<osg::Geode> geode = new osg::Geode;
@@ -0,0 +1,177 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gpipeline.h"
+#include "gscenefile.h"
+#include <chrono>
+#include <fstream>
+#include <osg/NodeVisitor>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+
+#define CACHE_DIR ".gcache"
+#define SCENE_FILE_EXTENSION "gscene"
+#define NAME_FILE_EXTENSION "names"
+
+namespace GPipeline {
+
+static double elapsed(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+class GNameListVisitor : public osg::NodeVisitor {
+public:
+    explicit GNameListVisitor()
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+    {
+    }
+    inline const std::set<std::string>& nameList() const { return m_nameList; }
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        if (!node.getName().empty()) {
+            m_nameList.insert(node.getName());
+        }
+        traverse(node);
+    }
+
+private:
+    std::set<std::string> m_nameList;
+};
+
+// Node names of the source model, stored beside its scene caches so the cache key can be built before loading.
+static std::string nameListPath(const std::string& file, const Options& options)
+{
+    std::string path = GSceneFile::cachePath(options.cacheDirectory, file, std::string());
+    return path.empty() ? path : osgDB::getNameLessExtension(path) + "." + NAME_FILE_EXTENSION;
+}
+
+static bool readNameList(const std::string& path, std::set<std::string>& nameList)
+{
+    std::ifstream stream(path);
+    if (path.empty() || !stream) {
+        return false;
+    }
+    std::string name;
+    while (std::getline(stream, name)) {
+        nameList.insert(name);
+    }
+    return true;
+}
+
+static void writeNameList(const std::string& path, osg::Node* node)
+{
+    if (path.empty()) {
+        return;
+    }
+    GNameListVisitor visitor;
+    node->accept(visitor);
+    osgDB::makeDirectoryForFile(path);
+    std::ofstream stream(path, std::ios::trunc);
+    for (const std::string& name : visitor.nameList()) {
+        stream << name << "\n";
+    }
+}
+
+std::string cacheDirectory(const std::string& file)
+{
+    return osgDB::concatPaths(osgDB::getFilePath(osgDB::getRealPath(file)), CACHE_DIR);
+}
+
+std::string sceneCachePath(const std::string& file, const Options& options)
+{
+    if (!options.sceneCache || options.cacheDirectory.empty() || osgDB::getLowerCaseFileExtension(file) == SCENE_FILE_EXTENSION) {
+        return std::string();
+    }
+    // Processing depends only on excluded names the model has, names of other models or
+    // camera paths must not split the cache. Without a name list there is no cache yet.
+    std::set<std::string> nameList;
+    readNameList(nameListPath(file, options), nameList);
+    std::string variant;
+    for (const std::string& name : options.excludeNames) {
+        if (nameList.count(name) > 0) {
+            variant += name + "\n";
+        }
+    }
+    return GSceneFile::cachePath(options.cacheDirectory, file, variant);
+}
+
+osg::ref_ptr<osg::Node> load(const std::string& file, const Options& options, Report& report)
+{
+    auto start = std::chrono::steady_clock::now();
+    osg::ref_ptr<osgDB::Options> loadOptions = new osgDB::Options;
+    loadOptions->setObjectCache(new osgDB::ObjectCache);
+    loadOptions->setObjectCacheHint(osgDB::Options::CACHE_IMAGES);
+    if (options.decodeImages) {
+        GImageLoader::defer(loadOptions);
+    }
+    report.sceneFile = sceneCachePath(file, options);
+    osg::ref_ptr<osg::Node> node = GSceneFile::read(report.sceneFile, loadOptions);
+    report.sceneCached = node.valid();
+    if (!node.valid()) {
+        node = osgDB::readNodeFile(file, loadOptions);
+    }
+    if (!node.valid()) {
+        return nullptr;
+    }
+    if (options.decodeImages) {
+        GImageLoader::Options decodeOptions;
+        if (options.textureCache) {
+            decodeOptions.cacheDirectory = options.cacheDirectory;
+        }
+        decodeOptions.compress = options.compress;
+        report.images = GImageLoader::decode(loadOptions, node, decodeOptions);
+    }
+    report.readTime = elapsed(start);
+    if (report.sceneCached) {
+        return node;
+    }
+    if (!report.sceneFile.empty()) {
+        std::set<std::string> nameList;
+        if (!readNameList(nameListPath(file, options), nameList)) {
+            writeNameList(nameListPath(file, options), node);
+            report.sceneFile = sceneCachePath(file, options);
+        }
+    }
+    start = std::chrono::steady_clock::now();
+    if (options.dedup) {
+        report.dedup = GDedup::optimize(node, options.excludeNames);
+    }
+    if (options.quantize) {
+        GQuantize::Options quantizeOptions;
+        quantizeOptions.halfTexCoords = options.halfTexCoords;
+        report.quantize = GQuantize::optimize(node, quantizeOptions);
+    }
+    if (options.batch) {
+        GBatch::Options batchOptions;
+        batchOptions.excludeNames = options.excludeNames;
+        report.batch = GBatch::optimize(node, batchOptions);
+    }
+    if (options.meshOptimizer) {
+        GMeshOptimizer::Options meshOptions;
+        meshOptions.reduceOverdraw = options.reduceOverdraw;
+        report.meshOptimizer = GMeshOptimizer::optimize(node, meshOptions);
+    }
+    report.processTime = elapsed(start);
+    if (!report.sceneFile.empty()) {
+        start = std::chrono::steady_clock::now();
+        report.sceneWritten = GSceneFile::write(node, report.sceneFile, file);
+        report.writeTime = elapsed(start);
+    }
+    return node;
+}
+
+};
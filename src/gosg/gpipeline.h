@@ -0,0 +1,65 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GPIPELINE_H
+#define GPIPELINE_H
+
+#include "gbatch.h"
+#include "gdedup.h"
+#include "gimageloader.h"
+#include "gmeshoptimizer.h"
+#include "gquantize.h"
+#include <osg/Node>
+#include <set>
+#include <string>
+
+namespace GPipeline {
+
+struct Options {
+    std::string cacheDirectory;
+    std::set<std::string> excludeNames;
+    bool compress = true;
+    bool decodeImages = true;
+    bool textureCache = true;
+    bool sceneCache = true;
+    bool dedup = true;
+    bool quantize = true;
+    // Half float UVs for geometry the scene file stores natively, see GQuantize::Options.
+    bool halfTexCoords = false;
+    bool batch = true;
+    bool meshOptimizer = true;
+    // Also sorts triangle clusters front to back, rebuilt scene files only.
+    bool reduceOverdraw = false;
+};
+
+struct Report {
+    bool sceneCached = false;
+    bool sceneWritten = false;
+    std::string sceneFile;
+    GImageLoader::Report images;
+    GDedup::Report dedup;
+    GQuantize::Report quantize;
+    GBatch::Report batch;
+    GMeshOptimizer::Report meshOptimizer;
+    double readTime = 0;
+    double processTime = 0;
+    double writeTime = 0;
+};
+
+extern std::string cacheDirectory(const std::string& file);
+extern std::string sceneCachePath(const std::string& file, const Options& options);
+extern osg::ref_ptr<osg::Node> load(const std::string& file, const Options& options, Report& report);
+
+};
+
+#endif // GPIPELINE_H
@@ -32,7 +32,7 @@ osg::ref_ptr<osg::Node> create(double size, int count)
         osg::ref_ptr<osg::Vec3Array> lineVertex = new osg::Vec3Array();
         osg::ref_ptr<osg::LineWidth> lineLength = new osg::LineWidth(2);
         osg::ref_ptr<osg::DrawArrays> linePrimitive = new osg::DrawArrays(osg::PrimitiveSet::LINES, 0, (count + 1) * 4);
-        osg::ref_ptr<osg::Vec4dArray> lineColor = new osg::Vec4dArray();
+        osg::ref_ptr<osg::Vec4Array> lineColor = new osg::Vec4Array();
         osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
         for (int x = 0; x <= count; x++) {
             lineVertex->push_back(osg::Vec3(-size / 2 + x * pm, -size / 2, 0));
@@ -42,7 +42,7 @@ osg::ref_ptr<osg::Node> create(double size, int count)
             lineVertex->push_back(osg::Vec3(-size / 2, -size / 2 + y * pm, 0));
             lineVertex->push_back(osg::Vec3(size / 2, -size / 2 + y * pm, 0));
         }
-        lineColor->push_back(osg::Vec4d(0.6, 0.6, 0.6, 0.2));
+        lineColor->push_back(osg::Vec4(0.6f, 0.6f, 0.6f, 0.2f));
         normals->push_back(osg::Vec3(0.0f, 0.0f, 1.0f));
         lineGeo->setVertexArray(lineVertex);
         lineGeo->getOrCreateStateSet()->setAttribute(lineLength, osg::StateAttribute::ON);
@@ -59,13 +59,13 @@ osg::ref_ptr<osg::Node> create(double size, int count)
         osg::ref_ptr<osg::Geometry> rectGeo = new osg::Geometry();
         osg::ref_ptr<osg::Vec3Array> rectVertex = new osg::Vec3Array();
         osg::ref_ptr<osg::DrawArrays> rectPrimitive = new osg::DrawArrays(osg::PrimitiveSet::QUADS, 0, 4);
-        osg::ref_ptr<osg::Vec4dArray> rectColor = new osg::Vec4dArray();
+        osg::ref_ptr<osg::Vec4Array> rectColor = new osg::Vec4Array();
         osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
         rectVertex->push_back(osg::Vec3(-size / 2, -size / 2, min));
         rectVertex->push_back(osg::Vec3(-size / 2, size / 2, min));
         rectVertex->push_back(osg::Vec3(size / 2, size / 2, min));
         rectVertex->push_back(osg::Vec3(size / 2, -size / 2, min));
-        rectColor->push_back(osg::Vec4d(0.0, 0.0, 0.0, 0.5));
+        rectColor->push_back(osg::Vec4(0.0f, 0.0f, 0.0f, 0.5f));
         normals->push_back(osg::Vec3(0.0f, 0.0f, 1.0f));
         rectGeo->setVertexArray(rectVertex);
         rectGeo->addPrimitiveSet(rectPrimitive);
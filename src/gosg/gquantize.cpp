@@ -0,0 +1,264 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gquantize.h"
+#include "gdedup.h"
+#include "gnodevisitor.h"
+#include "gscenefile.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#define HALF_TEXCOORD_LIMIT 2.0f
+
+namespace GQuantize {
+
+unsigned short toHalf(float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return (unsigned short)sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        return (unsigned short)(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    if (exponent >= 31) {
+        return (unsigned short)(sign | 0x7c00);
+    }
+    return (unsigned short)(sign + ((uint32_t)exponent << 10) + ((mantissa + 0x1000) >> 13));
+}
+
+float fromHalf(unsigned short value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits = 0;
+    if (exponent == 0) {
+        float result = std::ldexp((float)mantissa, -24);
+        return sign ? -result : result;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float result = 0;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+template <typename FROM, typename TO, typename FUNCTION>
+static osg::ref_ptr<osg::Array> convertArray(const osg::Array* array, bool normalize, FUNCTION convert)
+{
+    const FROM* from = static_cast<const FROM*>(array);
+    osg::ref_ptr<TO> to = new TO(array->getBinding(), (unsigned int)from->size());
+    for (unsigned int i = 0; i < from->size(); i++) {
+        (*to)[i] = convert((*from)[i]);
+    }
+    to->setName(array->getName());
+    to->setNormalize(normalize);
+    to->setPreserveDataType(array->getPreserveDataType());
+    return to;
+}
+
+static osg::ref_ptr<osg::Array> demoteArray(const osg::Array* array)
+{
+    switch (array->getType()) {
+    case osg::Array::DoubleArrayType:
+        return convertArray<osg::DoubleArray, osg::FloatArray>(array, array->getNormalize(), [](double v) { return (float)v; });
+    case osg::Array::Vec2dArrayType:
+        return convertArray<osg::Vec2dArray, osg::Vec2Array>(array, array->getNormalize(), [](const osg::Vec2d& v) { return osg::Vec2(v); });
+    case osg::Array::Vec3dArrayType:
+        return convertArray<osg::Vec3dArray, osg::Vec3Array>(array, array->getNormalize(), [](const osg::Vec3d& v) { return osg::Vec3(v); });
+    case osg::Array::Vec4dArrayType:
+        return convertArray<osg::Vec4dArray, osg::Vec4Array>(array, array->getNormalize(), [](const osg::Vec4d& v) { return osg::Vec4(v); });
+    default:
+        return nullptr;
+    }
+}
+
+static osg::ref_ptr<osg::Array> quantizeNormals(const osg::Array* array)
+{
+    if (array->getType() != osg::Array::Vec3ArrayType) {
+        return nullptr;
+    }
+    auto toByte = [](float v) {
+        return (signed char)std::lround(osg::clampBetween(v, -1.0f, 1.0f) * 127.0f);
+    };
+    return convertArray<osg::Vec3Array, osg::Vec3bArray>(array, true, [&toByte](const osg::Vec3& v) {
+        osg::Vec3 n = v;
+        n.normalize();
+        return osg::Vec3b(toByte(n.x()), toByte(n.y()), toByte(n.z()));
+    });
+}
+
+static osg::ref_ptr<osg::Array> quantizeColors(const osg::Array* array)
+{
+    if (array->getType() != osg::Array::Vec4ArrayType) {
+        return nullptr;
+    }
+    const osg::Vec4Array* colors = static_cast<const osg::Vec4Array*>(array);
+    for (const auto& color : *colors) {
+        for (int i = 0; i < 4; i++) {
+            if (!(color[i] >= 0.0f && color[i] <= 1.0f)) {
+                return nullptr;
+            }
+        }
+    }
+    auto toByte = [](float v) {
+        return (unsigned char)std::lround(v * 255.0f);
+    };
+    return convertArray<osg::Vec4Array, osg::Vec4ubArray>(array, true, [&toByte](const osg::Vec4& v) {
+        return osg::Vec4ub(toByte(v.r()), toByte(v.g()), toByte(v.b()), toByte(v.a()));
+    });
+}
+
+static osg::ref_ptr<osg::Array> quantizeTexCoords(const osg::Array* array)
+{
+    if (array->getType() != osg::Array::Vec2ArrayType) {
+        return nullptr;
+    }
+    const osg::Vec2Array* texCoords = static_cast<const osg::Vec2Array*>(array);
+    for (const auto& texCoord : *texCoords) {
+        if (!(std::fabs(texCoord.x()) <= HALF_TEXCOORD_LIMIT && std::fabs(texCoord.y()) <= HALF_TEXCOORD_LIMIT)) {
+            return nullptr;
+        }
+    }
+    return convertArray<osg::Vec2Array, Vec2hArray>(array, false, [](const osg::Vec2& v) {
+        return osg::Vec2us(toHalf(v.x()), toHalf(v.y()));
+    });
+}
+
+static osg::ref_ptr<osg::PrimitiveSet> narrowIndices(const osg::PrimitiveSet* primitiveSet, unsigned int numVertices)
+{
+    if (primitiveSet->getType() != osg::PrimitiveSet::DrawElementsUIntPrimitiveType || numVertices > 65536) {
+        return nullptr;
+    }
+    const osg::DrawElementsUInt* from = static_cast<const osg::DrawElementsUInt*>(primitiveSet);
+    for (GLuint index : *from) {
+        if (index > 65535) {
+            return nullptr;
+        }
+    }
+    osg::ref_ptr<osg::DrawElementsUShort> to = new osg::DrawElementsUShort(from->getMode(), from->begin(), from->end());
+    to->setName(from->getName());
+    to->setNumInstances(from->getNumInstances());
+    return to;
+}
+
+static bool isNativePath(const osg::Geometry* geometry)
+{
+    if (!GSceneFile::isNative(geometry)) {
+        return false;
+    }
+    for (const auto& nodePath : geometry->getParentalNodePaths()) {
+        for (const osg::Node* node : nodePath) {
+            if (!GSceneFile::isNative(node)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+class GArrayCache {
+public:
+    using ConvertFunction = osg::ref_ptr<osg::Array> (*)(const osg::Array*);
+    GArrayCache(ConvertFunction convertFunction, unsigned int& counter)
+        : m_convertFunction(convertFunction)
+        , m_counter(counter)
+    {
+    }
+    osg::Array* operator()(osg::Array* array)
+    {
+        auto it = m_converted.find(array);
+        if (it == m_converted.end()) {
+            osg::ref_ptr<osg::Array> converted = m_convertFunction(array);
+            if (converted.valid()) {
+                m_counter++;
+            }
+            it = m_converted.emplace(array, converted.valid() ? converted : osg::ref_ptr<osg::Array>(array)).first;
+        }
+        return it->second.get();
+    }
+
+private:
+    ConvertFunction m_convertFunction;
+    unsigned int& m_counter;
+    std::map<osg::Array*, osg::ref_ptr<osg::Array>> m_converted;
+};
+
+Report optimize(osg::Node* node, const Options& options)
+{
+    Report report;
+    if (!node) {
+        return report;
+    }
+    report.bytesBefore = GDedup::residentBytes(node);
+    GGeometryVisitor geometryVisitor;
+    geometryVisitor.collect(node);
+    GArrayCache demoteCache(demoteArray, report.demotedArrays);
+    GArrayCache normalCache(quantizeNormals, report.quantizedArrays);
+    GArrayCache colorCache(quantizeColors, report.quantizedArrays);
+    GArrayCache texCoordCache(quantizeTexCoords, report.quantizedArrays);
+    std::map<osg::PrimitiveSet*, osg::ref_ptr<osg::PrimitiveSet>> indexCache;
+    for (const auto& geometry : geometryVisitor.geometryList()) {
+        if (!GGeometryVisitor::isPlainGeometry(geometry)) {
+            continue;
+        }
+        GGeometryVisitor::replaceArrays(*geometry, [&demoteCache](osg::Array* array) {
+            return demoteCache(array);
+        });
+        if (options.normals && geometry->getNormalArray()) {
+            geometry->setNormalArray(normalCache(geometry->getNormalArray()));
+        }
+        if (options.colors && geometry->getColorArray()) {
+            geometry->setColorArray(colorCache(geometry->getColorArray()));
+        }
+        if (options.halfTexCoords && isNativePath(geometry)) {
+            for (unsigned int i = 0; i < geometry->getNumTexCoordArrays(); i++) {
+                if (geometry->getTexCoordArray(i)) {
+                    geometry->setTexCoordArray(i, texCoordCache(geometry->getTexCoordArray(i)));
+                }
+            }
+        }
+        if (options.indices && geometry->getVertexArray()) {
+            for (unsigned int i = 0; i < geometry->getNumPrimitiveSets(); i++) {
+                osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+                auto it = indexCache.find(primitiveSet);
+                if (it == indexCache.end()) {
+                    osg::ref_ptr<osg::PrimitiveSet> narrowed = narrowIndices(primitiveSet, geometry->getVertexArray()->getNumElements());
+                    if (narrowed.valid()) {
+                        report.narrowedIndices++;
+                    }
+                    it = indexCache.emplace(primitiveSet, narrowed).first;
+                }
+                if (it->second.valid()) {
+                    geometry->setPrimitiveSet(i, it->second);
+                }
+            }
+        }
+    }
+    report.bytesAfter = GDedup::residentBytes(node);
+    return report;
+}
+
+};
@@ -0,0 +1,48 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GQUANTIZE_H
+#define GQUANTIZE_H
+
+#include <osg/Array>
+#include <osg/Node>
+#include <osg/Texture>
+
+namespace GQuantize {
+
+// Reports Vec2usArrayType, so only the .gscene tables keep GL_HALF_FLOAT, an osgb round trip reads plain unsigned shorts.
+typedef osg::TemplateArray<osg::Vec2us, osg::Array::Vec2usArrayType, 2, GL_HALF_FLOAT> Vec2hArray;
+
+struct Options {
+    bool normals = true;
+    bool colors = true;
+    // Applied only to geometry GSceneFile stores natively, subgraphs embedded as osgb keep float UVs.
+    // Tiles are written as osgb, tile builds must leave this off.
+    bool halfTexCoords = false;
+    bool indices = true;
+};
+
+struct Report {
+    unsigned int demotedArrays = 0;
+    unsigned int quantizedArrays = 0;
+    unsigned int narrowedIndices = 0;
+    unsigned long long bytesBefore = 0;
+    unsigned long long bytesAfter = 0;
+};
+
+extern unsigned short toHalf(float value);
+extern float fromHalf(unsigned short value);
+extern Report optimize(osg::Node* node, const Options& options = Options());
+
+};
+
+#endif // GQUANTIZE_H
@@ -0,0 +1,396 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gsceneanalysis.h"
+#include "gnodevisitor.h"
+#include "gparallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <osg/KdTree>
+#include <osg/Switch>
+#include <osg/Transform>
+#include <set>
+
+#define TASKS_PER_THREAD 8
+#define KDTREE_MIN_TRIANGLES 256
+
+namespace GSceneAnalysis {
+
+struct GSeed {
+    osg::Matrix matrix;
+    unsigned int depth = 0;
+    int part = -1;
+    bool inactive = false;
+    bool shared = false;
+};
+
+struct GTask {
+    osg::ref_ptr<osg::Node> node;
+    GSeed seed;
+};
+
+struct GPartAccumulator {
+    osg::ref_ptr<osg::Node> node;
+    GSceneStats::Stats stats;
+    std::set<const osg::StateSet*> stateSets;
+};
+
+struct GNameEntry {
+    size_t order;
+    osg::Node* node;
+};
+
+static void accumulate(GSceneStats::Stats& stats, const GSceneStats::Stats& other)
+{
+    stats.triangles += other.triangles;
+    stats.vertices += other.vertices;
+    stats.drawables += other.drawables;
+    stats.drawCalls += other.drawCalls;
+}
+
+static std::mutex& boundMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Collects everything the loader needs from one traversal. Subtrees
+// past the split depth are handed back as tasks for other visitors, each
+// record carries an order key so merged results keep the serial preorder.
+class GAnalysisVisitor : public osg::NodeVisitor {
+public:
+    explicit GAnalysisVisitor(unsigned int splitDepth = 0)
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+        , m_splitDepth(splitDepth)
+    {
+    }
+    void run(osg::Node* node, const GSeed& seed, size_t order)
+    {
+        m_matrixStack.assign(1, seed.matrix);
+        m_depth = seed.depth;
+        m_part = seed.part >= 0 ? &inherited[seed.part] : nullptr;
+        m_partIndex = -1;
+        m_inactive = seed.inactive;
+        m_shared = seed.shared;
+        m_order = order;
+        node->accept(*this);
+    }
+
+    osg::BoundingBox bound;
+    std::vector<GNameEntry> names;
+    size_t animationOrder = (size_t)-1;
+    osg::ref_ptr<osg::Node> animationNode;
+    osg::ref_ptr<osgAnimation::AnimationManagerBase> animationManager;
+    GPartAccumulator total;
+    std::deque<GPartAccumulator> parts;
+    std::map<int, GPartAccumulator> inherited;
+    std::vector<KdTreeItem> kdTreeItems;
+    std::vector<GTask> tasks;
+    unsigned int nodes = 0;
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        enter(node);
+        traverseChildren(node);
+        leave();
+    }
+    virtual void apply(osg::Transform& transform) override
+    {
+        enter(transform);
+        osg::Matrix matrix = m_matrixStack.back();
+        transform.computeLocalToWorldMatrix(matrix, this);
+        m_matrixStack.push_back(matrix);
+        traverseChildren(transform);
+        m_matrixStack.pop_back();
+        leave();
+    }
+    virtual void apply(osg::Switch& node) override
+    {
+        enter(node);
+        bool inactive = m_inactive;
+        for (unsigned int i = 0; i < node.getNumChildren(); i++) {
+            // Switched off children count for names and statistics but not for the bound.
+            m_inactive = inactive || !node.getValue(i);
+            traverseChild(node.getChild(i));
+        }
+        m_inactive = inactive;
+        leave();
+    }
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        enter(drawable);
+        const GSceneStats::Stats& stats = GSceneStats::drawableStats(drawable);
+        accumulate(total.stats, stats);
+        if (m_part) {
+            accumulate(m_part->stats, stats);
+        }
+        if (!m_inactive) {
+            osg::BoundingBox box;
+            if (m_shared || drawable.getNumParents() > 1) {
+                // Drawables reachable from several tasks compute their lazy bound under a lock.
+                std::lock_guard<std::mutex> locker(boundMutex());
+                box = drawable.getBoundingBox();
+            } else {
+                box = drawable.getBoundingBox();
+            }
+            if (box.valid()) {
+                for (unsigned int i = 0; i < 8; i++) {
+                    bound.expandBy(box.corner(i) * m_matrixStack.back());
+                }
+            }
+        }
+        osg::Geometry* geometry = drawable.asGeometry();
+        if (geometry && stats.triangles >= KDTREE_MIN_TRIANGLES && GGeometryVisitor::isPlainGeometry(geometry)
+            && !dynamic_cast<osg::KdTree*>(geometry->getShape()) && m_geometries.insert(geometry).second) {
+            const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+            if (vertices) {
+                KdTreeItem item;
+                item.geometry = geometry;
+                item.vertices = (unsigned int)vertices->size();
+                kdTreeItems.push_back(item);
+            }
+        }
+        leave();
+    }
+
+private:
+    struct GScope {
+        GPartAccumulator* part;
+        int partIndex;
+        bool shared;
+    };
+    void enter(osg::Node& node)
+    {
+        m_scopes.push_back({ m_part, m_partIndex, m_shared });
+        nodes++;
+        m_shared = m_shared || node.getNumParents() > 1;
+        if (!node.getName().empty()) {
+            // Parts are the top-level named nodes, as in GSceneStats::parts().
+            if (!m_part && m_depth > 0) {
+                parts.emplace_back();
+                parts.back().node = &node;
+                m_part = &parts.back();
+                m_partIndex = (int)parts.size() - 1;
+            }
+            names.push_back({ m_order, &node });
+        }
+        if (!animationNode.valid() && node.getUpdateCallback()) {
+            osgAnimation::AnimationManagerBase* manager = dynamic_cast<osgAnimation::AnimationManagerBase*>(node.getUpdateCallback());
+            if (manager) {
+                animationOrder = m_order;
+                animationNode = &node;
+                animationManager = manager;
+            }
+        }
+        if (node.getStateSet()) {
+            total.stateSets.insert(node.getStateSet());
+            if (m_part) {
+                m_part->stateSets.insert(node.getStateSet());
+            }
+        }
+    }
+    void leave()
+    {
+        const GScope& scope = m_scopes.back();
+        m_part = scope.part;
+        m_partIndex = scope.partIndex;
+        m_shared = scope.shared;
+        m_scopes.pop_back();
+    }
+    void traverseChildren(osg::Node& node)
+    {
+        osg::Group* group = node.asGroup();
+        if (!group) {
+            traverse(node);
+            return;
+        }
+        for (unsigned int i = 0; i < group->getNumChildren(); i++) {
+            traverseChild(group->getChild(i));
+        }
+    }
+    void traverseChild(osg::Node* child)
+    {
+        if (m_splitDepth > 0 && m_depth + 1 == m_splitDepth) {
+            GTask task;
+            task.node = child;
+            task.seed.matrix = m_matrixStack.back();
+            task.seed.depth = m_depth + 1;
+            task.seed.part = m_part ? m_partIndex : -1;
+            task.seed.inactive = m_inactive;
+            task.seed.shared = m_shared;
+            tasks.push_back(task);
+            m_order = tasks.size() * 2;
+            return;
+        }
+        m_depth++;
+        child->accept(*this);
+        m_depth--;
+    }
+
+    unsigned int m_splitDepth = 0;
+    unsigned int m_depth = 0;
+    size_t m_order = 0;
+    std::vector<osg::Matrix> m_matrixStack;
+    std::vector<GScope> m_scopes;
+    GPartAccumulator* m_part = nullptr;
+    int m_partIndex = -1;
+    bool m_inactive = false;
+    bool m_shared = false;
+    std::set<osg::Geometry*> m_geometries;
+};
+
+static unsigned int splitDepth(osg::Node* node, size_t tasks)
+{
+    std::vector<osg::Node*> level { node };
+    unsigned int depth = 0;
+    while (level.size() < tasks) {
+        std::vector<osg::Node*> next;
+        for (osg::Node* current : level) {
+            osg::Group* group = current->asGroup();
+            for (unsigned int i = 0; group && i < group->getNumChildren(); i++) {
+                next.push_back(group->getChild(i));
+            }
+        }
+        if (next.empty()) {
+            // Too small to be worth splitting.
+            return 0;
+        }
+        level.swap(next);
+        depth++;
+    }
+    return depth;
+}
+
+static GSceneStats::Stats toStats(const GPartAccumulator& accumulator)
+{
+    GSceneStats::Stats stats = accumulator.stats;
+    stats.stateSets = (unsigned int)accumulator.stateSets.size();
+    return stats;
+}
+
+Result analyze(osg::Node* node, const osg::Matrix& matrix, unsigned int threads)
+{
+    Result result;
+    if (!node) {
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (threads == 0) {
+        threads = GParallel::threadCount();
+    }
+    osg::ref_ptr<GAnalysisVisitor> serial = new GAnalysisVisitor(threads > 1 ? splitDepth(node, threads * TASKS_PER_THREAD) : 0);
+    GSeed seed;
+    seed.matrix = matrix;
+    serial->run(node, seed, 0);
+    const std::vector<GTask>& tasks = serial->tasks;
+    // Consecutive tasks share a visitor so a wide level does not cost one visitor per child.
+    const size_t chunkCount = std::min(tasks.size(), (size_t)threads * TASKS_PER_THREAD);
+    std::vector<osg::ref_ptr<GAnalysisVisitor>> chunks(chunkCount);
+    GParallel::forEach(chunkCount, [&](size_t i) {
+        chunks[i] = new GAnalysisVisitor;
+        for (size_t k = tasks.size() * i / chunkCount; k < tasks.size() * (i + 1) / chunkCount; k++) {
+            chunks[i]->run(tasks[k].node, tasks[k].seed, k * 2 + 1);
+        }
+    }, threads);
+    std::vector<osg::ref_ptr<GAnalysisVisitor>> visitors { serial };
+    visitors.insert(visitors.end(), chunks.begin(), chunks.end());
+    std::vector<GNameEntry> names;
+    std::set<const osg::StateSet*> stateSets;
+    std::set<osg::Geometry*> geometries;
+    size_t animationOrder = (size_t)-1;
+    for (const auto& visitor : visitors) {
+        result.bound.expandBy(visitor->bound);
+        result.nodes += visitor->nodes;
+        names.insert(names.end(), visitor->names.begin(), visitor->names.end());
+        if (visitor->animationNode.valid() && visitor->animationOrder < animationOrder) {
+            animationOrder = visitor->animationOrder;
+            result.animationNode = visitor->animationNode;
+            result.animationManager = visitor->animationManager;
+        }
+        accumulate(result.total, visitor->total.stats);
+        stateSets.insert(visitor->total.stateSets.begin(), visitor->total.stateSets.end());
+        for (const auto& item : visitor->kdTreeItems) {
+            if (geometries.insert(item.geometry.get()).second) {
+                result.kdTreeItems.push_back(item);
+            }
+        }
+        for (auto& inherited : visitor->inherited) {
+            GPartAccumulator& part = serial->parts[inherited.first];
+            accumulate(part.stats, inherited.second.stats);
+            part.stateSets.insert(inherited.second.stateSets.begin(), inherited.second.stateSets.end());
+        }
+    }
+    result.total.stateSets = (unsigned int)stateSets.size();
+    for (const auto& visitor : visitors) {
+        for (const auto& part : visitor->parts) {
+            result.parts.push_back({ part.node, toStats(part) });
+        }
+    }
+    // The first node of a name in preorder wins, as with GNameNodeVisitor.
+    std::stable_sort(names.begin(), names.end(), [](const GNameEntry& a, const GNameEntry& b) {
+        return a.order < b.order;
+    });
+    for (const auto& entry : names) {
+        result.names.emplace(entry.node->getName(), entry.node);
+    }
+    result.tasks = (unsigned int)tasks.size();
+    result.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+osg::ref_ptr<osg::Node> findNode(const NameIndex& names, osg::Node* root, const std::string& name)
+{
+    if (!root) {
+        return nullptr;
+    }
+    auto it = names.find(name);
+    if (it != names.end() && it->second->getName() == name) {
+        if (it->second == root) {
+            return root;
+        }
+        // The optimizer may have removed the node after the index was built.
+        for (const auto& path : it->second->getParentalNodePaths(root)) {
+            if (!path.empty() && path.front() == root) {
+                return it->second;
+            }
+        }
+    }
+    GNameNodeVisitor nameNodeVisitor;
+    return nameNodeVisitor.getNode(root, name);
+}
+
+unsigned int buildKdTrees(const std::vector<KdTreeItem>& items, unsigned int threads)
+{
+    std::atomic<unsigned int> built(0);
+    GParallel::forEach(items.size(), [&](size_t i) {
+        osg::Geometry* geometry = items[i].geometry.get();
+        const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+        // Skips geometries the optimizer merged, dropped or rebuilt since the analysis.
+        if (geometry->getNumParents() == 0 || !vertices || vertices->size() != items[i].vertices || dynamic_cast<osg::KdTree*>(geometry->getShape())) {
+            return;
+        }
+        osg::ref_ptr<osg::KdTree> kdTree = new osg::KdTree;
+        osg::KdTree::BuildOptions buildOptions;
+        if (kdTree->build(buildOptions, geometry)) {
+            geometry->setShape(kdTree);
+            built++;
+        }
+    }, threads);
+    return built;
+}
+
+};
@@ -0,0 +1,59 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GSCENEANALYSIS_H
+#define GSCENEANALYSIS_H
+
+#include "gscenestats.h"
+#include <map>
+#include <osg/BoundingBox>
+#include <osg/Geometry>
+#include <osg/Matrix>
+#include <osgAnimation/AnimationManagerBase>
+#include <string>
+#include <vector>
+
+namespace GSceneAnalysis {
+
+using NameIndex = std::map<std::string, osg::ref_ptr<osg::Node>>;
+
+struct Part {
+    osg::ref_ptr<osg::Node> node;
+    GSceneStats::Stats stats;
+};
+
+struct KdTreeItem {
+    osg::ref_ptr<osg::Geometry> geometry;
+    unsigned int vertices = 0;
+};
+
+struct Result {
+    osg::BoundingBox bound;
+    NameIndex names;
+    osg::ref_ptr<osg::Node> animationNode;
+    osg::ref_ptr<osgAnimation::AnimationManagerBase> animationManager;
+    GSceneStats::Stats total;
+    std::vector<Part> parts;
+    std::vector<KdTreeItem> kdTreeItems;
+    unsigned int nodes = 0;
+    unsigned int tasks = 0;
+    double time = 0;
+};
+
+extern Result analyze(osg::Node* node, const osg::Matrix& matrix = osg::Matrix::identity(), unsigned int threads = 0);
+extern osg::ref_ptr<osg::Node> findNode(const NameIndex& names, osg::Node* root, const std::string& name);
+extern unsigned int buildKdTrees(const std::vector<KdTreeItem>& items, unsigned int threads = 0);
+
+};
+
+#endif // GSCENEANALYSIS_H
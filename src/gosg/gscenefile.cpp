@@ -0,0 +1,1182 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gscenefile.h"
+#include "gmappedfile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReaderWriter>
+#include <osgDB/Registry>
+#include <sstream>
+#include <sys/stat.h>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#define SCENE_FILE_MAGIC "GSCENE"
+#define SCENE_FILE_VERSION 1
+#define SCENE_FILE_ALIGNMENT 16
+#define SCENE_FILE_EXTENSION "gscene"
+#define SCENE_BLOB_EXTENSION "osgb"
+#define SCENE_BLOB_OPTIONS "WriteImageHint=UseExternal"
+
+// Array types stored as raw blobs, everything else is embedded as osgb.
+#define SCENE_ARRAY_TYPES(X)  \
+    X(ByteArrayType, GLbyte)  \
+    X(ShortArrayType, GLshort) \
+    X(IntArrayType, GLint)    \
+    X(UByteArrayType, GLubyte) \
+    X(UShortArrayType, GLushort) \
+    X(UIntArrayType, GLuint)  \
+    X(FloatArrayType, GLfloat) \
+    X(DoubleArrayType, GLdouble) \
+    X(Vec2bArrayType, osg::Vec2b) \
+    X(Vec3bArrayType, osg::Vec3b) \
+    X(Vec4bArrayType, osg::Vec4b) \
+    X(Vec2sArrayType, osg::Vec2s) \
+    X(Vec3sArrayType, osg::Vec3s) \
+    X(Vec4sArrayType, osg::Vec4s) \
+    X(Vec2ubArrayType, osg::Vec2ub) \
+    X(Vec3ubArrayType, osg::Vec3ub) \
+    X(Vec4ubArrayType, osg::Vec4ub) \
+    X(Vec2usArrayType, osg::Vec2us) \
+    X(Vec3usArrayType, osg::Vec3us) \
+    X(Vec4usArrayType, osg::Vec4us) \
+    X(Vec2ArrayType, osg::Vec2)   \
+    X(Vec3ArrayType, osg::Vec3)   \
+    X(Vec4ArrayType, osg::Vec4)   \
+    X(Vec2dArrayType, osg::Vec2d) \
+    X(Vec3dArrayType, osg::Vec3d) \
+    X(Vec4dArrayType, osg::Vec4d)
+
+namespace GSceneFile {
+
+// On-disk layout, native byte order. Every table and blob starts on a 16 byte boundary.
+struct GSceneTable {
+    uint64_t offset;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct GSceneHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t root;
+    uint32_t source;
+    uint32_t reserved;
+    GSceneTable strings;
+    GSceneTable nodes;
+    GSceneTable children;
+    GSceneTable materials;
+    GSceneTable blobs;
+    GSceneTable matrices;
+    GSceneTable geometries;
+    GSceneTable slots;
+    GSceneTable primitives;
+    GSceneTable arrays;
+};
+
+enum GNodeType : uint32_t {
+    GroupNode,
+    TransformNode,
+    GeodeNode,
+    GeometryNode,
+    EmbeddedNode
+};
+
+enum GSlotKind : uint32_t {
+    VertexSlot,
+    NormalSlot,
+    ColorSlot,
+    SecondaryColorSlot,
+    FogCoordSlot,
+    TexCoordSlot,
+    VertexAttribSlot
+};
+
+enum GPrimitiveType : uint32_t {
+    ArraysPrimitive,
+    ElementsPrimitive
+};
+
+enum GGeometryFlag : uint32_t {
+    DisplayListFlag = 1,
+    VertexBufferObjectFlag = 2
+};
+
+struct GSceneString {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+struct GSceneBlob {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct GSceneNode {
+    uint32_t type;
+    uint32_t name;
+    uint32_t nodeMask;
+    uint32_t dataVariance;
+    int32_t material;
+    int32_t callback;
+    uint32_t data;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t reserved[3];
+};
+
+struct GSceneMatrix {
+    double value[16];
+};
+
+struct GSceneGeometry {
+    uint32_t flags;
+    uint32_t firstSlot;
+    uint32_t slotCount;
+    uint32_t firstPrimitive;
+    uint32_t primitiveCount;
+    uint32_t reserved[3];
+};
+
+struct GSceneSlot {
+    uint32_t kind;
+    uint32_t unit;
+    uint32_t array;
+    uint32_t reserved;
+};
+
+struct GScenePrimitive {
+    uint32_t type;
+    uint32_t mode;
+    uint32_t first;
+    uint32_t count;
+    uint32_t array;
+    int32_t numInstances;
+    uint32_t reserved[2];
+};
+
+struct GSceneArray {
+    uint32_t type;
+    uint32_t dataSize;
+    uint32_t dataType;
+    uint32_t binding;
+    uint32_t normalize;
+    uint32_t count;
+    uint32_t elementSize;
+    uint32_t reserved;
+    GSceneBlob blob;
+};
+
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t alignSize(uint64_t size)
+{
+    return (size + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT;
+}
+
+static unsigned int elementSize(osg::Array::Type type)
+{
+    switch (type) {
+#define SCENE_ARRAY_SIZE(TYPE, ELEMENT) \
+    case osg::Array::TYPE:              \
+        return sizeof(ELEMENT);
+        SCENE_ARRAY_TYPES(SCENE_ARRAY_SIZE)
+#undef SCENE_ARRAY_SIZE
+    default:
+        return 0;
+    }
+}
+
+template <typename T, osg::Array::Type ARRAYTYPE>
+class GMappedArray : public osg::Array {
+public:
+    GMappedArray(GMappedFile* file, T* data, const GSceneArray& entry)
+        : osg::Array(ARRAYTYPE, (GLint)entry.dataSize, (GLenum)entry.dataType, (Binding)entry.binding)
+        , m_file(file)
+        , m_data(data)
+        , m_count(entry.count)
+    {
+        setNormalize(entry.normalize != 0);
+    }
+    // Copies share the mapping, the pages are copy-on-write and never reach the file.
+    GMappedArray(const GMappedArray& array, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY)
+        : osg::Array(array, copyop)
+        , m_file(array.m_file)
+        , m_data(array.m_data)
+        , m_count(array.m_count)
+    {
+    }
+    virtual osg::Object* cloneType() const override { return new GMappedArray(*this); }
+    virtual osg::Object* clone(const osg::CopyOp& copyop) const override { return new GMappedArray(*this, copyop); }
+    virtual bool isSameKindAs(const osg::Object* object) const override { return dynamic_cast<const GMappedArray*>(object) != nullptr; }
+    virtual const char* libraryName() const override { return "gosg"; }
+    virtual const char* className() const override { return "MappedArray"; }
+    virtual void accept(osg::ArrayVisitor& visitor) override { visitor.apply(*this); }
+    virtual void accept(osg::ConstArrayVisitor& visitor) const override { visitor.apply(*this); }
+    virtual void accept(unsigned int index, osg::ValueVisitor& visitor) override { visitor.apply(m_data[index]); }
+    virtual void accept(unsigned int index, osg::ConstValueVisitor& visitor) const override { visitor.apply(m_data[index]); }
+    virtual int compare(unsigned int lhs, unsigned int rhs) const override
+    {
+        if (m_data[lhs] < m_data[rhs]) {
+            return -1;
+        }
+        if (m_data[rhs] < m_data[lhs]) {
+            return 1;
+        }
+        return 0;
+    }
+    virtual unsigned int getElementSize() const override { return sizeof(T); }
+    virtual const GLvoid* getDataPointer() const override { return m_count ? m_data : nullptr; }
+    virtual const GLvoid* getDataPointer(unsigned int index) const override { return m_count ? m_data + index : nullptr; }
+    virtual unsigned int getTotalDataSize() const override { return m_count * (unsigned int)sizeof(T); }
+    virtual unsigned int getNumElements() const override { return m_count; }
+    virtual void reserveArray(unsigned int) override { }
+    // The mapping has a fixed size, arrays can only shrink in place.
+    virtual void resizeArray(unsigned int num) override { m_count = std::min(m_count, num); }
+
+protected:
+    virtual ~GMappedArray() = default;
+
+private:
+    osg::ref_ptr<GMappedFile> m_file;
+    T* m_data = nullptr;
+    unsigned int m_count = 0;
+};
+
+template <typename T, GLenum DATATYPE>
+class GMappedDrawElements : public osg::DrawElements {
+public:
+    GMappedDrawElements(GMappedFile* file, T* data, unsigned int count, GLenum mode, int numInstances)
+        : osg::DrawElements(osg::PrimitiveSet::PrimitiveType, mode, numInstances)
+        , m_file(file)
+        , m_data(data)
+        , m_count(count)
+    {
+    }
+    GMappedDrawElements(const GMappedDrawElements& drawElements, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY)
+        : osg::DrawElements(drawElements, copyop)
+        , m_file(drawElements.m_file)
+        , m_data(drawElements.m_data)
+        , m_count(drawElements.m_count)
+    {
+    }
+    virtual osg::Object* cloneType() const override { return new GMappedDrawElements(*this); }
+    virtual osg::Object* clone(const osg::CopyOp& copyop) const override { return new GMappedDrawElements(*this, copyop); }
+    virtual bool isSameKindAs(const osg::Object* object) const override { return dynamic_cast<const GMappedDrawElements*>(object) != nullptr; }
+    virtual const char* libraryName() const override { return "gosg"; }
+    virtual const char* className() const override { return "MappedDrawElements"; }
+    virtual const GLvoid* getDataPointer() const override { return m_count ? m_data : nullptr; }
+    virtual unsigned int getTotalDataSize() const override { return m_count * (unsigned int)sizeof(T); }
+    virtual bool supportsBufferObject() const override { return false; }
+    virtual void draw(osg::State& state, bool useVertexBufferObjects) const override
+    {
+        const GLvoid* indices = m_data;
+        if (useVertexBufferObjects) {
+            osg::GLBufferObject* ebo = getOrCreateGLBufferObject(state.getContextID());
+            if (ebo) {
+                state.getCurrentVertexArrayState()->bindElementBufferObject(ebo);
+                indices = (const GLvoid*)(ebo->getOffset(getBufferIndex()));
+            } else {
+                state.getCurrentVertexArrayState()->unbindElementBufferObject();
+            }
+        }
+        if (_numInstances >= 1) {
+            state.glDrawElementsInstanced(_mode, (GLsizei)m_count, DATATYPE, indices, _numInstances);
+        } else {
+            glDrawElements(_mode, (GLsizei)m_count, DATATYPE, indices);
+        }
+    }
+    virtual void accept(osg::PrimitiveFunctor& functor) const override
+    {
+        if (m_count) {
+            functor.drawElements(_mode, (GLsizei)m_count, m_data);
+        }
+    }
+    virtual void accept(osg::PrimitiveIndexFunctor& functor) const override
+    {
+        if (m_count) {
+            functor.drawElements(_mode, (GLsizei)m_count, m_data);
+        }
+    }
+    virtual unsigned int getNumIndices() const override { return m_count; }
+    virtual unsigned int index(unsigned int pos) const override { return m_data[pos]; }
+    virtual void offsetIndices(int offset) override
+    {
+        for (unsigned int i = 0; i < m_count; i++) {
+            m_data[i] = (T)(m_data[i] + offset);
+        }
+    }
+    virtual GLenum getDataType() override { return DATATYPE; }
+    virtual void resizeElements(unsigned int numIndices) override { m_count = std::min(m_count, numIndices); }
+    virtual void reserveElements(unsigned int) override { }
+    virtual void setElement(unsigned int i, unsigned int v) override { m_data[i] = (T)v; }
+    virtual unsigned int getElement(unsigned int i) override { return m_data[i]; }
+    virtual void addElement(unsigned int) override { }
+
+protected:
+    virtual ~GMappedDrawElements() = default;
+
+private:
+    osg::ref_ptr<GMappedFile> m_file;
+    T* m_data = nullptr;
+    unsigned int m_count = 0;
+};
+
+class GMemoryBuffer : public std::streambuf {
+public:
+    GMemoryBuffer(const unsigned char* data, size_t size)
+    {
+        char* begin = reinterpret_cast<char*>(const_cast<unsigned char*>(data));
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    virtual pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode) override
+    {
+        char* position = dir == std::ios_base::beg ? eback() : (dir == std::ios_base::cur ? gptr() : egptr());
+        position += offset;
+        if (position < eback() || position > egptr()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), position, egptr());
+        return pos_type(position - eback());
+    }
+    virtual pos_type seekpos(pos_type position, std::ios_base::openmode mode) override
+    {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+};
+
+bool isNative(const osg::Node* node)
+{
+    // Only plain core nodes are flattened into tables, anything with behaviour travels as osgb.
+    if (std::strcmp(node->libraryName(), "osg") != 0 || node->getCullCallback() || node->getEventCallback() || node->getUserDataContainer()) {
+        return false;
+    }
+    const char* className = node->className();
+    if (std::strcmp(className, "Geometry") == 0) {
+        const osg::Geometry* geometry = node->asGeometry();
+        return !geometry->getUpdateCallback() && !geometry->getDrawCallback() && !geometry->getComputeBoundingBoxCallback() && !geometry->getInitialBound().valid();
+    }
+    if (std::strcmp(className, "MatrixTransform") == 0) {
+        return static_cast<const osg::MatrixTransform*>(node)->getReferenceFrame() == osg::Transform::RELATIVE_RF;
+    }
+    return std::strcmp(className, "Group") == 0 || std::strcmp(className, "Geode") == 0;
+}
+
+class GSceneWriter {
+public:
+    bool write(osg::Node* node, const std::string& path, const std::string& sourceFile)
+    {
+        m_blobWriter = osgDB::Registry::instance()->getReaderWriterForExtension(SCENE_BLOB_EXTENSION);
+        if (!m_blobWriter) {
+            return false;
+        }
+        m_blobOptions = new osgDB::Options(SCENE_BLOB_OPTIONS);
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC));
+        m_header.version = SCENE_FILE_VERSION;
+        m_header.source = addString(sourceFile.empty() ? std::string() : osgDB::getFilePath(osgDB::getRealPath(sourceFile)));
+        int root = addNode(node);
+        if (root < 0) {
+            return false;
+        }
+        m_header.root = (uint32_t)root;
+        return save(path);
+    }
+
+private:
+    uint32_t addString(const std::string& value)
+    {
+        auto it = m_stringMap.find(value);
+        if (it != m_stringMap.end()) {
+            return it->second;
+        }
+        uint32_t index = (uint32_t)m_strings.size();
+        m_strings.push_back({ 0, (uint32_t)value.size(), 0 });
+        m_stringData.push_back(value);
+        m_stringMap.emplace(value, index);
+        return index;
+    }
+    int addBlob(const osg::Object& object, bool node)
+    {
+        std::ostringstream stream(std::ios::out | std::ios::binary);
+        osgDB::ReaderWriter::WriteResult result = node ? m_blobWriter->writeNode(static_cast<const osg::Node&>(object), stream, m_blobOptions)
+                                                       : m_blobWriter->writeObject(object, stream, m_blobOptions);
+        if (!result.success()) {
+            return -1;
+        }
+        m_blobData.push_back(stream.str());
+        m_blobs.push_back({ 0, (uint64_t)m_blobData.back().size() });
+        m_pendingBlobs.push_back({ m_blobs.size() - 1, m_blobData.back().data() });
+        return (int)m_blobs.size() - 1;
+    }
+    int addMaterial(osg::StateSet* stateSet)
+    {
+        if (!stateSet) {
+            return -1;
+        }
+        auto it = m_materialMap.find(stateSet);
+        if (it != m_materialMap.end()) {
+            return it->second;
+        }
+        int blob = addBlob(*stateSet, false);
+        int index = blob < 0 ? -1 : (int)m_materials.size();
+        if (blob >= 0) {
+            m_materials.push_back((uint32_t)blob);
+        }
+        m_materialMap.emplace(stateSet, index);
+        return index;
+    }
+    int addArray(const osg::Array* array)
+    {
+        auto it = m_arrayMap.find(array);
+        if (it != m_arrayMap.end()) {
+            return it->second;
+        }
+        unsigned int size = elementSize(array->getType());
+        int index = -1;
+        if (size && size == array->getElementSize() && array->getTotalDataSize() == size * array->getNumElements()) {
+            GSceneArray entry;
+            std::memset(&entry, 0, sizeof(entry));
+            entry.type = array->getType();
+            entry.dataSize = (uint32_t)array->getDataSize();
+            entry.dataType = array->getDataType();
+            entry.binding = (uint32_t)array->getBinding();
+            entry.normalize = array->getNormalize() ? 1 : 0;
+            entry.count = array->getNumElements();
+            entry.elementSize = size;
+            entry.blob.size = array->getTotalDataSize();
+            index = addDataArray(entry, array->getDataPointer());
+        }
+        m_arrayMap.emplace(array, index);
+        return index;
+    }
+    int addIndexArray(const osg::DrawElements* drawElements)
+    {
+        auto it = m_arrayMap.find(drawElements);
+        if (it != m_arrayMap.end()) {
+            return it->second;
+        }
+        GSceneArray entry;
+        std::memset(&entry, 0, sizeof(entry));
+        int index = -1;
+        osg::DrawElements* elements = const_cast<osg::DrawElements*>(drawElements);
+        switch (elements->getDataType()) {
+        case GL_UNSIGNED_BYTE:
+            entry.type = osg::Array::UByteArrayType;
+            break;
+        case GL_UNSIGNED_SHORT:
+            entry.type = osg::Array::UShortArrayType;
+            break;
+        case GL_UNSIGNED_INT:
+            entry.type = osg::Array::UIntArrayType;
+            break;
+        default:
+            break;
+        }
+        entry.elementSize = elementSize((osg::Array::Type)entry.type);
+        if (entry.elementSize && drawElements->getTotalDataSize() == entry.elementSize * drawElements->getNumIndices()) {
+            entry.dataSize = 1;
+            entry.dataType = elements->getDataType();
+            entry.count = drawElements->getNumIndices();
+            entry.blob.size = drawElements->getTotalDataSize();
+            index = addDataArray(entry, drawElements->getDataPointer());
+        }
+        m_arrayMap.emplace(drawElements, index);
+        return index;
+    }
+    int addDataArray(const GSceneArray& entry, const void* data)
+    {
+        m_arrays.push_back(entry);
+        m_pendingArrays.push_back(data);
+        return (int)m_arrays.size() - 1;
+    }
+    bool addSlot(std::vector<GSceneSlot>& slots, GSlotKind kind, unsigned int unit, const osg::Array* array)
+    {
+        if (!array) {
+            return true;
+        }
+        int index = addArray(array);
+        if (index < 0) {
+            return false;
+        }
+        slots.push_back({ kind, unit, (uint32_t)index, 0 });
+        return true;
+    }
+    int addGeometry(const osg::Geometry* geometry)
+    {
+        std::vector<GSceneSlot> slots;
+        bool valid = addSlot(slots, VertexSlot, 0, geometry->getVertexArray())
+            && addSlot(slots, NormalSlot, 0, geometry->getNormalArray())
+            && addSlot(slots, ColorSlot, 0, geometry->getColorArray())
+            && addSlot(slots, SecondaryColorSlot, 0, geometry->getSecondaryColorArray())
+            && addSlot(slots, FogCoordSlot, 0, geometry->getFogCoordArray());
+        for (unsigned int i = 0; valid && i < geometry->getNumTexCoordArrays(); i++) {
+            valid = addSlot(slots, TexCoordSlot, i, geometry->getTexCoordArray(i));
+        }
+        for (unsigned int i = 0; valid && i < geometry->getNumVertexAttribArrays(); i++) {
+            valid = addSlot(slots, VertexAttribSlot, i, geometry->getVertexAttribArray(i));
+        }
+        std::vector<GScenePrimitive> primitives;
+        for (unsigned int i = 0; valid && i < geometry->getNumPrimitiveSets(); i++) {
+            const osg::PrimitiveSet* primitiveSet = geometry->getPrimitiveSet(i);
+            GScenePrimitive primitive;
+            std::memset(&primitive, 0, sizeof(primitive));
+            primitive.mode = primitiveSet->getMode();
+            primitive.numInstances = primitiveSet->getNumInstances();
+            const osg::DrawArrays* drawArrays = dynamic_cast<const osg::DrawArrays*>(primitiveSet);
+            if (drawArrays) {
+                primitive.type = ArraysPrimitive;
+                primitive.first = (uint32_t)drawArrays->getFirst();
+                primitive.count = (uint32_t)drawArrays->getCount();
+            } else if (primitiveSet->getDrawElements()) {
+                int array = addIndexArray(primitiveSet->getDrawElements());
+                valid = array >= 0;
+                primitive.type = ElementsPrimitive;
+                primitive.array = (uint32_t)array;
+            } else {
+                valid = false;
+            }
+            primitives.push_back(primitive);
+        }
+        if (!valid) {
+            return -1;
+        }
+        GSceneGeometry entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.flags = (geometry->getUseDisplayList() ? (uint32_t)DisplayListFlag : (uint32_t)0) | (geometry->getUseVertexBufferObjects() ? (uint32_t)VertexBufferObjectFlag : (uint32_t)0);
+        entry.firstSlot = (uint32_t)m_slots.size();
+        entry.slotCount = (uint32_t)slots.size();
+        entry.firstPrimitive = (uint32_t)m_primitives.size();
+        entry.primitiveCount = (uint32_t)primitives.size();
+        m_slots.insert(m_slots.end(), slots.begin(), slots.end());
+        m_primitives.insert(m_primitives.end(), primitives.begin(), primitives.end());
+        m_geometries.push_back(entry);
+        return (int)m_geometries.size() - 1;
+    }
+    int addNode(osg::Node* node)
+    {
+        auto it = m_nodeMap.find(node);
+        if (it != m_nodeMap.end()) {
+            return it->second;
+        }
+        GSceneNode entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.material = -1;
+        entry.callback = -1;
+        int data = -1;
+        if (isNative(node)) {
+            if (node->asGeometry()) {
+                entry.type = GeometryNode;
+                data = addGeometry(node->asGeometry());
+            } else if (node->asTransform()) {
+                entry.type = TransformNode;
+                const osg::Matrixd& matrix = node->asTransform()->asMatrixTransform()->getMatrix();
+                GSceneMatrix value;
+                std::memcpy(value.value, matrix.ptr(), sizeof(value.value));
+                m_matrices.push_back(value);
+                data = (int)m_matrices.size() - 1;
+            } else {
+                entry.type = node->asGeode() ? GeodeNode : GroupNode;
+                data = 0;
+            }
+            if (node->getUpdateCallback()) {
+                entry.callback = addBlob(*node->getUpdateCallback(), false);
+                data = entry.callback < 0 ? -1 : data;
+            }
+            if (data >= 0 && node->getStateSet()) {
+                entry.material = addMaterial(node->getStateSet());
+                data = entry.material < 0 ? -1 : data;
+            }
+        }
+        if (data < 0) {
+            entry.type = EmbeddedNode;
+            entry.material = -1;
+            entry.callback = -1;
+            data = addBlob(*node, true);
+            if (data < 0) {
+                return -1;
+            }
+        }
+        entry.data = (uint32_t)data;
+        entry.name = addString(node->getName());
+        entry.nodeMask = node->getNodeMask();
+        entry.dataVariance = (uint32_t)node->getDataVariance();
+        int index = (int)m_nodes.size();
+        m_nodes.push_back(entry);
+        m_nodeMap.emplace(node, index);
+        osg::Group* group = entry.type == EmbeddedNode ? nullptr : node->asGroup();
+        if (group && group->getNumChildren() > 0) {
+            std::vector<uint32_t> children;
+            for (unsigned int i = 0; i < group->getNumChildren(); i++) {
+                int child = addNode(group->getChild(i));
+                if (child < 0) {
+                    return -1;
+                }
+                children.push_back((uint32_t)child);
+            }
+            m_nodes[index].firstChild = (uint32_t)m_children.size();
+            m_nodes[index].childCount = (uint32_t)children.size();
+            m_children.insert(m_children.end(), children.begin(), children.end());
+        }
+        return index;
+    }
+    template <typename T>
+    void layoutTable(GSceneTable& table, const std::vector<T>& entries, uint64_t& offset)
+    {
+        table.offset = offset;
+        table.count = (uint32_t)entries.size();
+        offset = alignSize(offset + entries.size() * sizeof(T));
+    }
+    template <typename T>
+    static void writeTable(std::ofstream& stream, const std::vector<T>& entries)
+    {
+        stream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(T));
+        writePadding(stream);
+    }
+    static void writePadding(std::ofstream& stream)
+    {
+        static const char padding[SCENE_FILE_ALIGNMENT] = {};
+        uint64_t position = (uint64_t)stream.tellp();
+        stream.write(padding, (std::streamsize)(alignSize(position) - position));
+    }
+    bool save(const std::string& path)
+    {
+        uint64_t offset = alignSize(sizeof(GSceneHeader));
+        layoutTable(m_header.strings, m_strings, offset);
+        layoutTable(m_header.nodes, m_nodes, offset);
+        layoutTable(m_header.children, m_children, offset);
+        layoutTable(m_header.materials, m_materials, offset);
+        layoutTable(m_header.blobs, m_blobs, offset);
+        layoutTable(m_header.matrices, m_matrices, offset);
+        layoutTable(m_header.geometries, m_geometries, offset);
+        layoutTable(m_header.slots, m_slots, offset);
+        layoutTable(m_header.primitives, m_primitives, offset);
+        layoutTable(m_header.arrays, m_arrays, offset);
+        for (size_t i = 0; i < m_strings.size(); i++) {
+            m_strings[i].offset = offset;
+            offset = alignSize(offset + m_strings[i].size);
+        }
+        for (const auto& blob : m_pendingBlobs) {
+            m_blobs[blob.first].offset = offset;
+            offset = alignSize(offset + m_blobs[blob.first].size);
+        }
+        for (auto& array : m_arrays) {
+            array.blob.offset = offset;
+            offset = alignSize(offset + array.blob.size);
+        }
+        osgDB::makeDirectoryForFile(path);
+        std::string tempFile = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+        {
+            std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+            if (!stream) {
+                return false;
+            }
+            stream.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+            writePadding(stream);
+            writeTable(stream, m_strings);
+            writeTable(stream, m_nodes);
+            writeTable(stream, m_children);
+            writeTable(stream, m_materials);
+            writeTable(stream, m_blobs);
+            writeTable(stream, m_matrices);
+            writeTable(stream, m_geometries);
+            writeTable(stream, m_slots);
+            writeTable(stream, m_primitives);
+            writeTable(stream, m_arrays);
+            for (const auto& value : m_stringData) {
+                stream.write(value.data(), value.size());
+                writePadding(stream);
+            }
+            for (const auto& blob : m_pendingBlobs) {
+                stream.write(blob.second, (std::streamsize)m_blobs[blob.first].size);
+                writePadding(stream);
+            }
+            for (size_t i = 0; i < m_arrays.size(); i++) {
+                stream.write(static_cast<const char*>(m_pendingArrays[i]), (std::streamsize)m_arrays[i].blob.size);
+                writePadding(stream);
+            }
+            if (!stream) {
+                stream.close();
+                std::remove(tempFile.c_str());
+                return false;
+            }
+        }
+        std::remove(path.c_str());
+        if (std::rename(tempFile.c_str(), path.c_str()) != 0) {
+            std::remove(tempFile.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    GSceneHeader m_header;
+    osgDB::ReaderWriter* m_blobWriter = nullptr;
+    osg::ref_ptr<osgDB::Options> m_blobOptions;
+    std::vector<GSceneString> m_strings;
+    std::deque<std::string> m_stringData;
+    std::map<std::string, uint32_t> m_stringMap;
+    std::vector<GSceneNode> m_nodes;
+    std::map<const osg::Node*, int> m_nodeMap;
+    std::vector<uint32_t> m_children;
+    std::vector<uint32_t> m_materials;
+    std::map<const osg::StateSet*, int> m_materialMap;
+    std::vector<GSceneBlob> m_blobs;
+    std::deque<std::string> m_blobData;
+    std::vector<std::pair<size_t, const char*>> m_pendingBlobs;
+    std::vector<GSceneMatrix> m_matrices;
+    std::vector<GSceneGeometry> m_geometries;
+    std::vector<GSceneSlot> m_slots;
+    std::vector<GScenePrimitive> m_primitives;
+    std::vector<GSceneArray> m_arrays;
+    std::vector<const void*> m_pendingArrays;
+    std::map<const osg::BufferData*, int> m_arrayMap;
+};
+
+class GSceneReader {
+public:
+    explicit GSceneReader(GMappedFile* file, const std::string& path)
+        : m_file(file)
+        , m_path(path)
+    {
+    }
+    osg::ref_ptr<osg::Node> read(const osgDB::Options* options)
+    {
+        std::memcpy(&m_header, m_file->data(), sizeof(m_header));
+        if (std::memcmp(m_header.magic, SCENE_FILE_MAGIC, sizeof(SCENE_FILE_MAGIC)) != 0 || m_header.version != SCENE_FILE_VERSION) {
+            return nullptr;
+        }
+        if (!table(m_header.strings, m_strings) || !table(m_header.nodes, m_nodes) || !table(m_header.children, m_children)
+            || !table(m_header.materials, m_materials) || !table(m_header.blobs, m_blobs) || !table(m_header.matrices, m_matrices)
+            || !table(m_header.geometries, m_geometries) || !table(m_header.slots, m_slots) || !table(m_header.primitives, m_primitives)
+            || !table(m_header.arrays, m_arrays) || m_header.root >= m_header.nodes.count) {
+            return nullptr;
+        }
+        m_blobReader = osgDB::Registry::instance()->getReaderWriterForExtension(SCENE_BLOB_EXTENSION);
+        m_options = options ? osg::clone(options, osg::CopyOp::SHALLOW_COPY) : new osgDB::Options;
+        // Relative references resolve against the graph's source directory first, then the file itself.
+        if (!osgDB::getFilePath(m_path).empty()) {
+            m_options->getDatabasePathList().push_front(osgDB::getFilePath(m_path));
+        }
+        std::string source;
+        if (string(m_header.source, source) && !source.empty()) {
+            m_options->getDatabasePathList().push_front(source);
+        }
+        m_arrayList.resize(m_header.arrays.count);
+        m_materialList.resize(m_header.materials.count);
+        std::vector<osg::ref_ptr<osg::Node>> nodeList(m_header.nodes.count);
+        for (uint32_t i = 0; i < m_header.nodes.count; i++) {
+            nodeList[i] = createNode(m_nodes[i]);
+            if (!nodeList[i].valid()) {
+                return nullptr;
+            }
+        }
+        for (uint32_t i = 0; i < m_header.nodes.count; i++) {
+            const GSceneNode& entry = m_nodes[i];
+            if (entry.childCount == 0) {
+                continue;
+            }
+            osg::Group* group = nodeList[i]->asGroup();
+            if (!group || entry.type == EmbeddedNode || !range(entry.firstChild, entry.childCount, m_header.children.count)) {
+                return nullptr;
+            }
+            for (uint32_t j = 0; j < entry.childCount; j++) {
+                uint32_t child = m_children[entry.firstChild + j];
+                if (child >= m_header.nodes.count) {
+                    return nullptr;
+                }
+                group->addChild(nodeList[child]);
+            }
+        }
+        return nodeList[m_header.root];
+    }
+
+private:
+    static bool range(uint64_t first, uint64_t count, uint64_t size)
+    {
+        return first <= size && count <= size - first;
+    }
+    template <typename T>
+    bool table(const GSceneTable& table, const T*& entries)
+    {
+        if (table.offset % SCENE_FILE_ALIGNMENT != 0 || !range(table.offset, (uint64_t)table.count * sizeof(T), m_file->size())) {
+            return false;
+        }
+        entries = reinterpret_cast<const T*>(m_file->data() + table.offset);
+        return true;
+    }
+    bool string(uint32_t index, std::string& value) const
+    {
+        if (index >= m_header.strings.count || !range(m_strings[index].offset, m_strings[index].size, m_file->size())) {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(m_file->data() + m_strings[index].offset), m_strings[index].size);
+        return true;
+    }
+    osg::ref_ptr<osg::Object> readBlob(int index, bool node)
+    {
+        if (!m_blobReader || index < 0 || (uint32_t)index >= m_header.blobs.count || !range(m_blobs[index].offset, m_blobs[index].size, m_file->size())) {
+            return nullptr;
+        }
+        GMemoryBuffer buffer(m_file->data() + m_blobs[index].offset, (size_t)m_blobs[index].size);
+        std::istream stream(&buffer);
+        osgDB::ReaderWriter::ReadResult result = node ? m_blobReader->readNode(stream, m_options) : m_blobReader->readObject(stream, m_options);
+        return result.getObject();
+    }
+    osg::StateSet* material(int index)
+    {
+        if (index < 0 || (uint32_t)index >= m_header.materials.count) {
+            return nullptr;
+        }
+        if (!m_materialList[index].valid()) {
+            m_materialList[index] = dynamic_cast<osg::StateSet*>(readBlob((int)m_materials[index], false).get());
+        }
+        return m_materialList[index].get();
+    }
+    template <typename T, osg::Array::Type ARRAYTYPE>
+    osg::Array* mappedArray(const GSceneArray& entry)
+    {
+        return new GMappedArray<T, ARRAYTYPE>(m_file, reinterpret_cast<T*>(m_file->data() + entry.blob.offset), entry);
+    }
+    bool validArray(uint32_t index) const
+    {
+        if (index >= m_header.arrays.count) {
+            return false;
+        }
+        const GSceneArray& entry = m_arrays[index];
+        unsigned int size = elementSize((osg::Array::Type)entry.type);
+        return size && size == entry.elementSize && entry.blob.size == (uint64_t)size * entry.count
+            && entry.blob.offset % SCENE_FILE_ALIGNMENT == 0 && range(entry.blob.offset, entry.blob.size, m_file->size());
+    }
+    osg::Array* array(uint32_t index)
+    {
+        if (!validArray(index)) {
+            return nullptr;
+        }
+        if (!m_arrayList[index].valid()) {
+            const GSceneArray& entry = m_arrays[index];
+            switch (entry.type) {
+#define SCENE_ARRAY_CREATE(TYPE, ELEMENT)                                  \
+    case osg::Array::TYPE:                                                 \
+        m_arrayList[index] = mappedArray<ELEMENT, osg::Array::TYPE>(entry); \
+        break;
+                SCENE_ARRAY_TYPES(SCENE_ARRAY_CREATE)
+#undef SCENE_ARRAY_CREATE
+            default:
+                break;
+            }
+        }
+        return m_arrayList[index].get();
+    }
+    osg::PrimitiveSet* drawElements(const GScenePrimitive& primitive)
+    {
+        if (!validArray(primitive.array)) {
+            return nullptr;
+        }
+        auto key = std::make_tuple(primitive.array, primitive.mode, primitive.numInstances);
+        osg::ref_ptr<osg::PrimitiveSet>& primitiveSet = m_drawElementsMap[key];
+        if (!primitiveSet.valid()) {
+            const GSceneArray& entry = m_arrays[primitive.array];
+            unsigned char* data = m_file->data() + entry.blob.offset;
+            switch (entry.type) {
+            case osg::Array::UByteArrayType:
+                primitiveSet = new GMappedDrawElements<GLubyte, GL_UNSIGNED_BYTE>(m_file, data, entry.count, primitive.mode, primitive.numInstances);
+                break;
+            case osg::Array::UShortArrayType:
+                primitiveSet = new GMappedDrawElements<GLushort, GL_UNSIGNED_SHORT>(m_file, reinterpret_cast<GLushort*>(data), entry.count, primitive.mode, primitive.numInstances);
+                break;
+            case osg::Array::UIntArrayType:
+                primitiveSet = new GMappedDrawElements<GLuint, GL_UNSIGNED_INT>(m_file, reinterpret_cast<GLuint*>(data), entry.count, primitive.mode, primitive.numInstances);
+                break;
+            default:
+                break;
+            }
+        }
+        return primitiveSet.get();
+    }
+    osg::ref_ptr<osg::Geometry> createGeometry(uint32_t index)
+    {
+        if (index >= m_header.geometries.count) {
+            return nullptr;
+        }
+        const GSceneGeometry& entry = m_geometries[index];
+        if (!range(entry.firstSlot, entry.slotCount, m_header.slots.count) || !range(entry.firstPrimitive, entry.primitiveCount, m_header.primitives.count)) {
+            return nullptr;
+        }
+        osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+        geometry->setUseDisplayList((entry.flags & DisplayListFlag) != 0);
+        geometry->setUseVertexBufferObjects((entry.flags & VertexBufferObjectFlag) != 0);
+        for (uint32_t i = 0; i < entry.slotCount; i++) {
+            const GSceneSlot& slot = m_slots[entry.firstSlot + i];
+            osg::Array* array = this->array(slot.array);
+            if (!array) {
+                return nullptr;
+            }
+            switch (slot.kind) {
+            case VertexSlot:
+                geometry->setVertexArray(array);
+                break;
+            case NormalSlot:
+                geometry->setNormalArray(array);
+                break;
+            case ColorSlot:
+                geometry->setColorArray(array);
+                break;
+            case SecondaryColorSlot:
+                geometry->setSecondaryColorArray(array);
+                break;
+            case FogCoordSlot:
+                geometry->setFogCoordArray(array);
+                break;
+            case TexCoordSlot:
+                geometry->setTexCoordArray(slot.unit, array);
+                break;
+            case VertexAttribSlot:
+                geometry->setVertexAttribArray(slot.unit, array);
+                break;
+            default:
+                return nullptr;
+            }
+        }
+        for (uint32_t i = 0; i < entry.primitiveCount; i++) {
+            const GScenePrimitive& primitive = m_primitives[entry.firstPrimitive + i];
+            osg::ref_ptr<osg::PrimitiveSet> primitiveSet;
+            if (primitive.type == ArraysPrimitive) {
+                primitiveSet = new osg::DrawArrays(primitive.mode, (GLint)primitive.first, (GLsizei)primitive.count, primitive.numInstances);
+            } else if (primitive.type == ElementsPrimitive) {
+                primitiveSet = drawElements(primitive);
+            }
+            if (!primitiveSet.valid()) {
+                return nullptr;
+            }
+            geometry->addPrimitiveSet(primitiveSet);
+        }
+        return geometry;
+    }
+    osg::ref_ptr<osg::Node> createNode(const GSceneNode& entry)
+    {
+        osg::ref_ptr<osg::Node> node;
+        switch (entry.type) {
+        case GroupNode:
+            node = new osg::Group;
+            break;
+        case TransformNode:
+            if (entry.data < m_header.matrices.count) {
+                osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform;
+                transform->setMatrix(osg::Matrixd(m_matrices[entry.data].value));
+                node = transform;
+            }
+            break;
+        case GeodeNode:
+            node = new osg::Geode;
+            break;
+        case GeometryNode:
+            node = createGeometry(entry.data);
+            break;
+        case EmbeddedNode:
+            return dynamic_cast<osg::Node*>(readBlob((int)entry.data, true).get());
+        default:
+            break;
+        }
+        if (!node.valid()) {
+            return nullptr;
+        }
+        std::string name;
+        if (!string(entry.name, name)) {
+            return nullptr;
+        }
+        node->setName(name);
+        node->setNodeMask(entry.nodeMask);
+        node->setDataVariance((osg::Object::DataVariance)entry.dataVariance);
+        if (entry.material >= 0) {
+            osg::StateSet* stateSet = material(entry.material);
+            if (!stateSet) {
+                return nullptr;
+            }
+            node->setStateSet(stateSet);
+        }
+        if (entry.callback >= 0) {
+            osg::ref_ptr<osg::Callback> callback = dynamic_cast<osg::Callback*>(readBlob(entry.callback, false).get());
+            if (!callback.valid()) {
+                return nullptr;
+            }
+            node->setUpdateCallback(callback);
+        }
+        return node;
+    }
+
+private:
+    osg::ref_ptr<GMappedFile> m_file;
+    std::string m_path;
+    GSceneHeader m_header;
+    osgDB::ReaderWriter* m_blobReader = nullptr;
+    osg::ref_ptr<osgDB::Options> m_options;
+    const GSceneString* m_strings = nullptr;
+    const GSceneNode* m_nodes = nullptr;
+    const uint32_t* m_children = nullptr;
+    const uint32_t* m_materials = nullptr;
+    const GSceneBlob* m_blobs = nullptr;
+    const GSceneMatrix* m_matrices = nullptr;
+    const GSceneGeometry* m_geometries = nullptr;
+    const GSceneSlot* m_slots = nullptr;
+    const GScenePrimitive* m_primitives = nullptr;
+    const GSceneArray* m_arrays = nullptr;
+    std::vector<osg::ref_ptr<osg::Array>> m_arrayList;
+    std::vector<osg::ref_ptr<osg::StateSet>> m_materialList;
+    std::map<std::tuple<uint32_t, uint32_t, int32_t>, osg::ref_ptr<osg::PrimitiveSet>> m_drawElementsMap;
+};
+
+class GScenePermissibleCallback : public osgUtil::Optimizer::IsOperationPermissibleForObjectCallback {
+public:
+    virtual bool isOperationPermissibleForObjectImplementation(const osgUtil::Optimizer* optimizer, const osg::Drawable* drawable, unsigned int option) const override
+    {
+        if ((option & REWRITE_OPTIMIZATIONS) && isMapped(drawable)) {
+            return false;
+        }
+        return osgUtil::Optimizer::IsOperationPermissibleForObjectCallback::isOperationPermissibleForObjectImplementation(optimizer, drawable, option);
+    }
+    virtual bool isOperationPermissibleForObjectImplementation(const osgUtil::Optimizer* optimizer, const osg::Node* node, unsigned int option) const override
+    {
+        if ((option & REWRITE_OPTIMIZATIONS) && isMapped(node->asDrawable())) {
+            return false;
+        }
+        return osgUtil::Optimizer::IsOperationPermissibleForObjectCallback::isOperationPermissibleForObjectImplementation(optimizer, node, option);
+    }
+    using osgUtil::Optimizer::IsOperationPermissibleForObjectCallback::isOperationPermissibleForObjectImplementation;
+
+private:
+    // Passes that rewrite vertex or index data in place, which a fixed size mapping can't take.
+    static const unsigned int REWRITE_OPTIMIZATIONS = osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS
+        | osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS
+        | osgUtil::Optimizer::MERGE_GEOMETRY
+        | osgUtil::Optimizer::MAKE_FAST_GEOMETRY
+        | osgUtil::Optimizer::CHECK_GEOMETRY
+        | osgUtil::Optimizer::TRISTRIP_GEOMETRY
+        | osgUtil::Optimizer::TESSELLATE_GEOMETRY
+        | osgUtil::Optimizer::INDEX_MESH
+        | osgUtil::Optimizer::VERTEX_POSTTRANSFORM
+        | osgUtil::Optimizer::VERTEX_PRETRANSFORM;
+};
+
+class GSceneReaderWriter : public osgDB::ReaderWriter {
+public:
+    GSceneReaderWriter()
+    {
+        supportsExtension(SCENE_FILE_EXTENSION, "Memory mapped gosg scene");
+    }
+    virtual const char* className() const override { return "gosg scene reader/writer"; }
+    virtual ReadResult readNode(const std::string& file, const osgDB::Options* options) const override
+    {
+        if (!acceptsExtension(osgDB::getLowerCaseFileExtension(file))) {
+            return ReadResult::FILE_NOT_HANDLED;
+        }
+        std::string path = osgDB::findDataFile(file, options);
+        if (path.empty()) {
+            return ReadResult::FILE_NOT_FOUND;
+        }
+        osg::ref_ptr<osg::Node> node = GSceneFile::read(path, options);
+        if (!node.valid()) {
+            return ReadResult::ERROR_IN_READING_FILE;
+        }
+        return node.release();
+    }
+    virtual WriteResult writeNode(const osg::Node& node, const std::string& file, const osgDB::Options*) const override
+    {
+        if (!acceptsExtension(osgDB::getLowerCaseFileExtension(file))) {
+            return WriteResult::FILE_NOT_HANDLED;
+        }
+        if (!GSceneFile::write(const_cast<osg::Node*>(&node), file)) {
+            return WriteResult::ERROR_IN_WRITING_FILE;
+        }
+        return WriteResult::FILE_SAVED;
+    }
+};
+
+static osgDB::RegisterReaderWriterProxy<GSceneReaderWriter> g_sceneReaderWriterProxy;
+
+std::string cachePath(const std::string& directory, const std::string& file, const std::string& variant)
+{
+    struct stat info;
+    if (directory.empty() || stat(file.c_str(), &info) != 0) {
+        return std::string();
+    }
+    std::string path = osgDB::getRealPath(file);
+    uint64_t hash = hashBytes(path.data(), path.size());
+    uint64_t size = (uint64_t)info.st_size;
+    uint64_t time = (uint64_t)info.st_mtime;
+    hash = hashBytes(&size, sizeof(size), hash);
+    hash = hashBytes(&time, sizeof(time), hash);
+    hash = hashBytes(variant.data(), variant.size(), hash);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return osgDB::concatPaths(directory, std::string(name) + "." + SCENE_FILE_EXTENSION);
+}
+
+bool write(osg::Node* node, const std::string& path, const std::string& sourceFile)
+{
+    if (!node || path.empty()) {
+        return false;
+    }
+    GSceneWriter writer;
+    return writer.write(node, path, sourceFile);
+}
+
+osg::ref_ptr<osg::Node> read(const std::string& path, const osgDB::Options* options)
+{
+    if (path.empty() || !osgDB::fileExists(path)) {
+        return nullptr;
+    }
+    osg::ref_ptr<GMappedFile> file = GMappedFile::open(path);
+    if (!file.valid() || file->size() < sizeof(GSceneHeader)) {
+        return nullptr;
+    }
+    GSceneReader reader(file, path);
+    return reader.read(options);
+}
+
+bool isMapped(const osg::Drawable* drawable)
+{
+    const osg::Geometry* geometry = drawable ? drawable->asGeometry() : nullptr;
+    return geometry && geometry->getVertexArray() && std::strcmp(geometry->getVertexArray()->libraryName(), "gosg") == 0;
+}
+
+osg::ref_ptr<osgUtil::Optimizer::IsOperationPermissibleForObjectCallback> permissibleCallback()
+{
+    return new GScenePermissibleCallback;
+}
+
+};
@@ -0,0 +1,35 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GSCENEFILE_H
+#define GSCENEFILE_H
+
+#include <osg/Drawable>
+#include <osg/Node>
+#include <osgDB/Options>
+#include <osgUtil/Optimizer>
+#include <string>
+
+namespace GSceneFile {
+
+extern std::string cachePath(const std::string& directory, const std::string& file, const std::string& variant = std::string());
+extern bool write(osg::Node* node, const std::string& path, const std::string& sourceFile = std::string());
+extern osg::ref_ptr<osg::Node> read(const std::string& path, const osgDB::Options* options = nullptr);
+extern bool isMapped(const osg::Drawable* drawable);
+// Whether the writer stores the node in its own tables, other nodes and their subgraphs are embedded as osgb.
+extern bool isNative(const osg::Node* node);
+extern osg::ref_ptr<osgUtil::Optimizer::IsOperationPermissibleForObjectCallback> permissibleCallback();
+
+};
+
+#endif // GSCENEFILE_H
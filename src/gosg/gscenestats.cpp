@@ -0,0 +1,174 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gscenestats.h"
+#include <algorithm>
+#include <osg/Geometry>
+#include <osg/Stats>
+#include <set>
+
+namespace GSceneStats {
+
+static unsigned long long triangleCount(GLenum mode, unsigned long long count)
+{
+    switch (mode) {
+    case GL_TRIANGLES:
+        return count / 3;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        return count >= 3 ? count - 2 : 0;
+    case GL_QUADS:
+        return count / 4 * 2;
+    case GL_QUAD_STRIP:
+        return count >= 4 ? (count - 2) / 2 * 2 : 0;
+    default:
+        return 0;
+    }
+}
+
+Stats drawableStats(const osg::Drawable& drawable)
+{
+    Stats stats;
+    stats.drawables = 1;
+    const osg::Geometry* geometry = drawable.asGeometry();
+    if (!geometry) {
+        stats.drawCalls = 1;
+        return stats;
+    }
+    if (geometry->getVertexArray()) {
+        stats.vertices = geometry->getVertexArray()->getNumElements();
+    }
+    for (const auto& primitiveSet : geometry->getPrimitiveSetList()) {
+        unsigned long long instances = std::max(1, primitiveSet->getNumInstances());
+        const osg::DrawArrayLengths* lengths = dynamic_cast<const osg::DrawArrayLengths*>(primitiveSet.get());
+        if (lengths) {
+            // Each length is its own glDrawArrays call.
+            for (GLsizei length : *lengths) {
+                stats.triangles += triangleCount(lengths->getMode(), length) * instances;
+            }
+            stats.drawCalls += (unsigned int)lengths->size();
+        } else {
+            stats.triangles += triangleCount(primitiveSet->getMode(), primitiveSet->getNumIndices()) * instances;
+            stats.drawCalls++;
+        }
+    }
+    return stats;
+}
+
+class GStatsVisitor : public osg::NodeVisitor {
+public:
+    explicit GStatsVisitor()
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN)
+    {
+    }
+    Stats stats() const
+    {
+        Stats stats = m_stats;
+        stats.stateSets = (unsigned int)m_stateSetList.size();
+        return stats;
+    }
+
+protected:
+    virtual void apply(osg::Node& node) override
+    {
+        if (node.getStateSet()) {
+            m_stateSetList.insert(node.getStateSet());
+        }
+        traverse(node);
+    }
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        apply(static_cast<osg::Node&>(drawable));
+        const Stats& stats = drawableStats(drawable);
+        m_stats.triangles += stats.triangles;
+        m_stats.vertices += stats.vertices;
+        m_stats.drawables += stats.drawables;
+        m_stats.drawCalls += stats.drawCalls;
+    }
+
+private:
+    Stats m_stats;
+    std::set<const osg::StateSet*> m_stateSetList;
+};
+
+Stats collect(osg::Node* node)
+{
+    if (!node) {
+        return Stats();
+    }
+    GStatsVisitor visitor;
+    node->accept(visitor);
+    return visitor.stats();
+}
+
+std::vector<osg::ref_ptr<osg::Node>> parts(osg::Node* node)
+{
+    std::vector<osg::ref_ptr<osg::Node>> partList;
+    std::vector<osg::Node*> nodeList { node };
+    // The top-level named nodes, looking through unnamed wrapper groups.
+    while (!nodeList.empty()) {
+        osg::Node* current = nodeList.back();
+        nodeList.pop_back();
+        osg::Group* group = current ? current->asGroup() : nullptr;
+        for (unsigned int i = 0; group && i < group->getNumChildren(); i++) {
+            osg::Node* child = group->getChild(i);
+            if (!child->getName().empty()) {
+                partList.push_back(child);
+            } else if (child->asGroup()) {
+                nodeList.push_back(child);
+            }
+        }
+    }
+    return partList;
+}
+
+std::map<std::string, double> visible(osg::Camera* camera)
+{
+    static const std::pair<const char*, const char*> attributes[] = {
+        { "drawables", "Visible number of drawables" },
+        { "fastDrawables", "Visible number of fast drawables" },
+        { "vertices", "Visible vertex count" },
+        { "triangles", "Visible number of GL_TRIANGLES" },
+        { "triangleStrips", "Visible number of GL_TRIANGLE_STRIP" },
+        { "stateGraphs", "Number of StateGraphs" },
+        { "renderBins", "Visible number of render bins" },
+    };
+    std::map<std::string, double> result;
+    osg::Stats* stats = camera ? camera->getStats() : nullptr;
+    if (!stats) {
+        return result;
+    }
+    if (!stats->collectStats("scene")) {
+        // Collection starts with the next cull, callers poll so the first answer is empty.
+        stats->collectStats("scene", true);
+        return result;
+    }
+    for (unsigned int frame = stats->getLatestFrameNumber(); frame + 1 > stats->getEarliestFrameNumber() && result.empty(); frame--) {
+        double value = 0;
+        if (!stats->getAttribute(frame, attributes[0].second, value)) {
+            if (frame == 0) {
+                break;
+            }
+            continue;
+        }
+        for (const auto& attribute : attributes) {
+            if (stats->getAttribute(frame, attribute.second, value)) {
+                result[attribute.first] = value;
+            }
+        }
+        result["frame"] = frame;
+    }
+    return result;
+}
+
+};
@@ -0,0 +1,39 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GSCENESTATS_H
+#define GSCENESTATS_H
+
+#include <map>
+#include <osg/Camera>
+#include <osg/Node>
+#include <string>
+#include <vector>
+
+namespace GSceneStats {
+
+struct Stats {
+    unsigned long long triangles = 0;
+    unsigned long long vertices = 0;
+    unsigned int drawables = 0;
+    unsigned int drawCalls = 0;
+    unsigned int stateSets = 0;
+};
+
+extern Stats collect(osg::Node* node);
+extern Stats drawableStats(const osg::Drawable& drawable);
+extern std::vector<osg::ref_ptr<osg::Node>> parts(osg::Node* node);
+extern std::map<std::string, double> visible(osg::Camera* camera);
+
+};
+
+#endif // GSCENESTATS_H
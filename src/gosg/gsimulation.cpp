@@ -0,0 +1,245 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gsimulation.h"
+#include <chrono>
+#include <osg/Material>
+
+#define SIMULATION_DEFAULT_RATE 60
+#define SIMULATION_MAX_LAG 4
+#define FLY_FIRST_CONTROLPOINT_TIME 1
+
+GSimulation::GSimulation()
+    : m_tickRate(SIMULATION_DEFAULT_RATE)
+    , m_time(0)
+{
+}
+
+GSimulation::~GSimulation()
+{
+    stop();
+}
+
+void GSimulation::setTickRate(int tickRate)
+{
+    m_tickRate = std::max(1, tickRate);
+}
+
+void GSimulation::setPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_paused = paused;
+    }
+    m_condition.notify_all();
+}
+
+void GSimulation::setTargets(osg::MatrixTransform* rootTransform, osg::MatrixTransform* particle, GManipulator* manipulator)
+{
+    m_rootTransform = rootTransform;
+    m_particle = particle;
+    m_manipulator = manipulator;
+}
+
+void GSimulation::setRootMatrix(const osg::Matrixd& matrix)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_state.rootMatrix = matrix;
+}
+
+void GSimulation::setParticleMatrix(const osg::Matrixd& matrix)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_state.particleMatrix = matrix;
+}
+
+void GSimulation::setGlow(osg::Node* node, const osg::Vec4& color)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_state.glows[node] = color;
+}
+
+void GSimulation::clearGlow(osg::Node* node)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_state.glows.erase(node);
+}
+
+void GSimulation::clearGlows()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_state.glows.clear();
+}
+
+void GSimulation::playFly(int index, const osg::AnimationPath* path)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_flyRequest = path;
+    m_flyRequestIndex = index;
+}
+
+void GSimulation::stopFly()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_flyRequest = nullptr;
+    m_flyPath = nullptr;
+    m_state.flyIndex = -1;
+}
+
+void GSimulation::start()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_running) {
+        return;
+    }
+    m_quit = false;
+    m_running = true;
+    m_thread = std::thread(&GSimulation::run, this);
+}
+
+void GSimulation::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_quit = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+    m_running = false;
+}
+
+void GSimulation::operator()(osg::Node* node, osg::NodeVisitor* nv)
+{
+    if (m_snapshots.update() || m_glowPending) {
+        apply(m_snapshots.front());
+    }
+    const Snapshot& snapshot = m_snapshots.front();
+    if (m_manipulator.valid()) {
+        // The manipulator rebuilds its matrix every event traversal, the fly pose must win each frame.
+        if (snapshot.flying) {
+            m_manipulator->setCameraMatrix(snapshot.cameraMatrix);
+        }
+        m_cameraMatrices.back() = m_manipulator->cameraMatrix();
+        m_cameraMatrices.publish();
+    }
+    traverse(node, nv);
+}
+
+void GSimulation::run()
+{
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> locker(m_mutex);
+    while (!m_quit) {
+        if (m_paused) {
+            // The clock holds while paused and resumes from the same time.
+            m_condition.wait(locker, [this]() { return m_quit || !m_paused; });
+            next = std::chrono::steady_clock::now();
+            continue;
+        }
+        std::chrono::steady_clock::duration step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / m_tickRate));
+        next += step;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - next > step * SIMULATION_MAX_LAG) {
+            // Drops the ticks missed by a stall instead of bursting through them.
+            next = now;
+        }
+        if (m_condition.wait_until(locker, next, [this]() { return m_quit || m_paused; })) {
+            continue;
+        }
+        tick();
+    }
+}
+
+void GSimulation::tick()
+{
+    m_state.tick++;
+    m_state.time += 1.0 / m_tickRate;
+    m_state.flying = false;
+    if (m_flyRequest.valid()) {
+        // Starts from the pose the render thread showed last.
+        m_cameraMatrices.update();
+        const osg::Matrixd& camera = m_cameraMatrices.front();
+        m_flyPath = new osg::AnimationPath(*m_flyRequest);
+        m_flyPath->getTimeControlPointMap().erase(FLY_FIRST_CONTROLPOINT_TIME);
+        m_flyPath->insert(FLY_FIRST_CONTROLPOINT_TIME, osg::AnimationPath::ControlPoint(camera.getTrans(), camera.getRotate(), osg::Vec3d(1, 1, 1)));
+        m_flyStart = m_state.time;
+        m_state.flyIndex = m_flyRequestIndex;
+        m_flyRequest = nullptr;
+    }
+    if (m_flyPath.valid()) {
+        double elapsed = m_state.time - m_flyStart;
+        osg::AnimationPath::ControlPoint point;
+        m_flyPath->getInterpolatedControlPoint(m_flyPath->getFirstTime() + elapsed, point);
+        point.getMatrix(m_state.cameraMatrix);
+        m_state.flying = true;
+        if (elapsed >= m_flyPath->getPeriod()) {
+            m_state.flyIndex = -1;
+            m_state.flyFinished++;
+            m_flyPath = nullptr;
+        }
+    }
+    m_snapshots.back() = m_state;
+    m_snapshots.publish();
+    m_time = m_state.time;
+}
+
+void GSimulation::apply(const Snapshot& snapshot)
+{
+    if (m_rootTransform.valid() && m_rootTransform->getMatrix() != snapshot.rootMatrix) {
+        m_rootTransform->setMatrix(snapshot.rootMatrix);
+    }
+    if (m_particle.valid() && m_particle->getMatrix() != snapshot.particleMatrix) {
+        m_particle->setMatrix(snapshot.particleMatrix);
+    }
+    for (auto it = m_appliedGlows.begin(); it != m_appliedGlows.end();) {
+        if (snapshot.glows.find(it->first) == snapshot.glows.end()) {
+            it->first->getOrCreateStateSet()->removeAttribute(osg::StateAttribute::MATERIAL);
+            it = m_appliedGlows.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_glowPending = false;
+    for (const auto& glow : snapshot.glows) {
+        auto it = m_appliedGlows.find(glow.first);
+        if (it != m_appliedGlows.end() && it->second == glow.second) {
+            continue;
+        }
+        osg::StateSet* stateSet = glow.first->getOrCreateStateSet();
+        if (stateSet->getDataVariance() != osg::Object::DYNAMIC) {
+            // The draw in flight took this StateSet as static, edit it once a frame has culled it dynamic.
+            stateSet->setDataVariance(osg::Object::DYNAMIC);
+            m_glowPending = true;
+            continue;
+        }
+        osg::ref_ptr<osg::Material> material = static_cast<osg::Material*>(stateSet->getAttribute(osg::StateAttribute::MATERIAL));
+        if (!material.valid()) {
+            material = new osg::Material;
+            material->setDataVariance(osg::Object::DYNAMIC);
+            stateSet->setAttributeAndModes(material, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
+        }
+        material->setEmission(osg::Material::FRONT, glow.second);
+        material->setShininess(osg::Material::FRONT, 128.0);
+        material->setColorMode(osg::Material::AMBIENT);
+        m_appliedGlows[glow.first] = glow.second;
+    }
+    if (m_flyFinished != snapshot.flyFinished) {
+        m_flyFinished = snapshot.flyFinished;
+        if (m_flyFinishedCallback) {
+            m_flyFinishedCallback(snapshot.flyIndex);
+        }
+    }
+}
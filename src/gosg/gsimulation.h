@@ -0,0 +1,103 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GSIMULATION_H
+#define GSIMULATION_H
+
+#include "gmanipulator.h"
+#include "gtriplebuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <osg/AnimationPath>
+#include <osg/Callback>
+#include <osg/MatrixTransform>
+#include <thread>
+
+// Advances the fly path and the scene clock at a fixed tick on its own thread.
+// Each tick publishes a snapshot the update traversal applies without locks.
+class GSimulation : public osg::NodeCallback {
+public:
+    using FlyCompletedCallback = std::function<void(int)>;
+    explicit GSimulation();
+    struct Snapshot {
+        unsigned long long tick = 0;
+        double time = 0;
+        osg::Matrixd rootMatrix;
+        osg::Matrixd particleMatrix;
+        std::map<osg::ref_ptr<osg::Node>, osg::Vec4> glows;
+        osg::Matrixd cameraMatrix;
+        bool flying = false;
+        int flyIndex = -1;
+        unsigned int flyFinished = 0;
+    };
+
+public:
+    inline double time() const { return m_time; }
+    inline int tickRate() const { return m_tickRate; }
+    inline bool paused() const { return m_paused; }
+    inline void setFlyFinishedCallback(const FlyCompletedCallback& callback) { m_flyFinishedCallback = callback; }
+    void setTickRate(int tickRate);
+    void setPaused(bool paused);
+    void setTargets(osg::MatrixTransform* rootTransform, osg::MatrixTransform* particle, GManipulator* manipulator);
+    void setRootMatrix(const osg::Matrixd& matrix);
+    void setParticleMatrix(const osg::Matrixd& matrix);
+    void setGlow(osg::Node* node, const osg::Vec4& color);
+    void clearGlow(osg::Node* node);
+    void clearGlows();
+    void playFly(int index, const osg::AnimationPath* path);
+    void stopFly();
+    void start();
+    void stop();
+
+public:
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv) override;
+
+protected:
+    virtual ~GSimulation();
+
+private:
+    void run();
+    void tick();
+    void apply(const Snapshot& snapshot);
+
+private:
+    // Written by the simulation thread, guarded by m_mutex against the setters.
+    Snapshot m_state;
+    osg::ref_ptr<osg::AnimationPath> m_flyPath;
+    osg::ref_ptr<const osg::AnimationPath> m_flyRequest;
+    int m_flyRequestIndex = -1;
+    double m_flyStart = 0;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_running = false;
+    bool m_quit = false;
+    std::atomic<bool> m_paused { false };
+    std::atomic<int> m_tickRate;
+    std::atomic<double> m_time;
+    GTripleBuffer<Snapshot> m_snapshots;
+    GTripleBuffer<osg::Matrixd> m_cameraMatrices;
+    // Owned by the update traversal.
+    osg::ref_ptr<osg::MatrixTransform> m_rootTransform;
+    osg::ref_ptr<osg::MatrixTransform> m_particle;
+    osg::ref_ptr<GManipulator> m_manipulator;
+    std::map<osg::ref_ptr<osg::Node>, osg::Vec4> m_appliedGlows;
+    unsigned int m_flyFinished = 0;
+    bool m_glowPending = false;
+    FlyCompletedCallback m_flyFinishedCallback = nullptr;
+};
+
+#endif // GSIMULATION_H
@@ -11,7 +11,12 @@
  **********************************************************************************/
 
 #include "gskybox.h"
+#include "gparallel.h"
+#include "gtexturecache.h"
 #include <functional>
+#include <future>
+#include <map>
+#include <mutex>
 #include <osg/Depth>
 #include <osg/ShapeDrawable>
 #include <osg/Switch>
@@ -24,75 +29,126 @@
 
 namespace GSkyBox {
 
-osg::ref_ptr<osg::Node> create(const std::string& dir, double size)
-{
-    class TexMatCallback : public osg::NodeCallback {
-    public:
-        explicit TexMatCallback(const osg::ref_ptr<osg::TexMat>& texMat)
-            : m_texMat(texMat)
-        {
-        }
-        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
-        {
-            osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
-            if (cv) {
-                const osg::Matrix& mv = *(cv->getModelViewMatrix());
-                const osg::Matrix& r = osg::Matrix::rotate(osg::DegreesToRadians(112.0f), 0.0f, 0.0f, 1.0f) * osg::Matrix::rotate(osg::DegreesToRadians(90.0f), 1.0f, 0.0f, 0.0f);
-                const osg::Quat& q = mv.getRotate();
-                const osg::Matrix& c = osg::Matrix::rotate(q.inverse());
-                if (m_texMat) {
-                    m_texMat->setMatrix(c * r);
-                }
+class TexMatCallback : public osg::NodeCallback {
+public:
+    explicit TexMatCallback(const osg::ref_ptr<osg::TexMat>& texMat)
+        : m_texMat(texMat)
+    {
+    }
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+    {
+        osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+        if (cv) {
+            const osg::Matrix& mv = *(cv->getModelViewMatrix());
+            const osg::Matrix& r = osg::Matrix::rotate(osg::DegreesToRadians(112.0f), 0.0f, 0.0f, 1.0f) * osg::Matrix::rotate(osg::DegreesToRadians(90.0f), 1.0f, 0.0f, 0.0f);
+            const osg::Quat& q = mv.getRotate();
+            const osg::Matrix& c = osg::Matrix::rotate(q.inverse());
+            if (m_texMat) {
+                m_texMat->setMatrix(c * r);
             }
-            traverse(node, nv);
         }
+        traverse(node, nv);
+    }
 
-    private:
-        osg::ref_ptr<osg::TexMat> m_texMat;
-    };
-    class MoveEarthySkyTransform : public osg::Transform {
-        virtual bool computeLocalToWorldMatrix(osg::Matrix& matrix, osg::NodeVisitor* nv) const
-        {
-            osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
-            if (cv) {
-                osg::Vec3 eyePointLocal = cv->getEyeLocal();
-                matrix.preMult(osg::Matrix::translate(eyePointLocal));
-            }
-            return true;
+private:
+    osg::ref_ptr<osg::TexMat> m_texMat;
+};
+
+class MoveEarthySkyTransform : public osg::Transform {
+public:
+    inline void setSize(double size) { m_size = size; }
+    virtual bool computeLocalToWorldMatrix(osg::Matrix& matrix, osg::NodeVisitor* nv) const
+    {
+        osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+        if (cv) {
+            osg::Vec3 eyePointLocal = cv->getEyeLocal();
+            matrix.preMult(osg::Matrix::scale(m_size, m_size, m_size) * osg::Matrix::translate(eyePointLocal));
         }
-        virtual bool computeWorldToLocalMatrix(osg::Matrix& matrix, osg::NodeVisitor* nv) const
-        {
-            osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
-            if (cv) {
-                osg::Vec3 eyePointLocal = cv->getEyeLocal();
-                matrix.postMult(osg::Matrix::translate(-eyePointLocal));
-            }
-            return true;
+        return true;
+    }
+    virtual bool computeWorldToLocalMatrix(osg::Matrix& matrix, osg::NodeVisitor* nv) const
+    {
+        osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+        if (cv) {
+            osg::Vec3 eyePointLocal = cv->getEyeLocal();
+            matrix.postMult(osg::Matrix::translate(-eyePointLocal) * osg::Matrix::scale(1.0 / m_size, 1.0 / m_size, 1.0 / m_size));
         }
+        return true;
+    }
+
+private:
+    double m_size = 1.0;
+};
+
+using CubeMapFuture = std::shared_future<osg::ref_ptr<osg::TextureCubeMap>>;
+
+static std::mutex s_cubeMapMutex;
+static std::map<std::string, CubeMapFuture> s_cubeMapList;
+
+static osg::ref_ptr<osg::TextureCubeMap> readCubeMap(const std::string& dir, const std::string& cacheDirectory, bool compress)
+{
+    static const std::pair<osg::TextureCubeMap::Face, const char*> faces[] = {
+        { osg::TextureCubeMap::POSITIVE_X, "right.jpg" },
+        { osg::TextureCubeMap::NEGATIVE_X, "left.jpg" },
+        { osg::TextureCubeMap::POSITIVE_Y, "bottom.jpg" },
+        { osg::TextureCubeMap::NEGATIVE_Y, "top.jpg" },
+        { osg::TextureCubeMap::POSITIVE_Z, "front.jpg" },
+        { osg::TextureCubeMap::NEGATIVE_Z, "back.jpg" },
     };
-    auto readCubeMap = [](const std::string& dir) -> osg::ref_ptr<osg::TextureCubeMap> {
-        osg::ref_ptr<osg::TextureCubeMap> cubemap = new osg::TextureCubeMap;
-        osg::ref_ptr<osg::Image> imagePosX = osgDB::readImageFile(dir + "/right.jpg");
-        osg::ref_ptr<osg::Image> imageNegX = osgDB::readImageFile(dir + "/left.jpg");
-        osg::ref_ptr<osg::Image> imagePosY = osgDB::readImageFile(dir + "/bottom.jpg");
-        osg::ref_ptr<osg::Image> imageNegY = osgDB::readImageFile(dir + "/top.jpg");
-        osg::ref_ptr<osg::Image> imagePosZ = osgDB::readImageFile(dir + "/front.jpg");
-        osg::ref_ptr<osg::Image> imageNegZ = osgDB::readImageFile(dir + "/back.jpg");
-        if (imagePosX && imageNegX && imagePosY && imageNegY && imagePosZ && imageNegZ) {
-            cubemap->setImage(osg::TextureCubeMap::POSITIVE_X, imagePosX);
-            cubemap->setImage(osg::TextureCubeMap::NEGATIVE_X, imageNegX);
-            cubemap->setImage(osg::TextureCubeMap::POSITIVE_Y, imagePosY);
-            cubemap->setImage(osg::TextureCubeMap::NEGATIVE_Y, imageNegY);
-            cubemap->setImage(osg::TextureCubeMap::POSITIVE_Z, imagePosZ);
-            cubemap->setImage(osg::TextureCubeMap::NEGATIVE_Z, imageNegZ);
-            cubemap->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
-            cubemap->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
-            cubemap->setWrap(osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE);
-            cubemap->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
-            cubemap->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    std::vector<osg::ref_ptr<osg::Image>> images(6);
+    GParallel::forEach(images.size(), [&](size_t i) {
+        const std::string& file = dir + "/" + faces[i].second;
+        const std::string& cacheFile = GTextureCache::cachePath(cacheDirectory, file, compress);
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+        image->setFileName(file);
+        if (GTextureCache::load(cacheFile, image)) {
+            images[i] = image;
+            return;
         }
-        return cubemap;
-    };
+        osg::ref_ptr<osg::Image> decoded = osgDB::readRefImageFile(file);
+        if (decoded.valid() && GTextureCache::store(cacheFile, decoded, compress) && GTextureCache::load(cacheFile, image)) {
+            decoded = image;
+        }
+        images[i] = decoded;
+    });
+    osg::ref_ptr<osg::TextureCubeMap> cubemap = new osg::TextureCubeMap;
+    for (const auto& image : images) {
+        if (!image.valid()) {
+            return cubemap;
+        }
+    }
+    for (size_t i = 0; i < images.size(); i++) {
+        cubemap->setImage(faces[i].first, images[i]);
+    }
+    cubemap->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    cubemap->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+    cubemap->setWrap(osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE);
+    cubemap->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+    cubemap->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    return cubemap;
+}
+
+void preload(const std::string& dir, const std::string& cacheDirectory, bool compress)
+{
+    std::lock_guard<std::mutex> locker(s_cubeMapMutex);
+    if (s_cubeMapList.find(dir) == s_cubeMapList.end()) {
+        s_cubeMapList.emplace(dir, std::async(std::launch::async, readCubeMap, dir, cacheDirectory, compress).share());
+    }
+}
+
+osg::ref_ptr<osg::TextureCubeMap> cubeMap(const std::string& dir)
+{
+    preload(dir);
+    CubeMapFuture future;
+    {
+        std::lock_guard<std::mutex> locker(s_cubeMapMutex);
+        future = s_cubeMapList.at(dir);
+    }
+    return future.get();
+}
+
+osg::ref_ptr<osg::Node> create(const std::string& dir, double size)
+{
     osg::ref_ptr<osg::StateSet> stateSet = new osg::StateSet();
     osg::ref_ptr<osg::TexEnv> te = new osg::TexEnv;
     te->setMode(osg::TexEnv::REPLACE);
@@ -102,7 +158,7 @@ osg::ref_ptr<osg::Node> create(const std::string& dir, double size)
     stateSet->setTextureAttributeAndModes(0, tg, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
     osg::ref_ptr<osg::TexMat> tm = new osg::TexMat;
     stateSet->setTextureAttribute(0, tm);
-    osg::ref_ptr<osg::TextureCubeMap> skymap = readCubeMap(dir);
+    osg::ref_ptr<osg::TextureCubeMap> skymap = cubeMap(dir);
     stateSet->setTextureAttributeAndModes(0, skymap, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
     stateSet->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
     stateSet->setMode(GL_CULL_FACE, osg::StateAttribute::OFF);
@@ -111,14 +167,16 @@ osg::ref_ptr<osg::Node> create(const std::string& dir, double size)
     depth->setRange(1.0, 10.0);
     stateSet->setAttributeAndModes(depth, osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
     stateSet->setRenderBinDetails(-1, "RenderBin");
-    osg::ref_ptr<osg::Drawable> drawable = new osg::ShapeDrawable(new osg::Sphere(osg::Vec3(0, 0, 0), size));
+    // A unit sphere scaled by the transform, so a new model only has to call setSize().
+    osg::ref_ptr<osg::Drawable> drawable = new osg::ShapeDrawable(new osg::Sphere(osg::Vec3(0, 0, 0), 1.0f));
     osg::ref_ptr<osg::Geode> geode = new osg::Geode;
     geode->setCullingActive(false);
     geode->setStateSet(stateSet);
     drawable->setUseVertexBufferObjects(true);
     geode->addDrawable(drawable);
-    osg::ref_ptr<osg::Transform> transform = new MoveEarthySkyTransform();
+    osg::ref_ptr<MoveEarthySkyTransform> transform = new MoveEarthySkyTransform();
     transform->setCullingActive(false);
+    transform->setSize(size);
     transform->addChild(geode);
     osg::ref_ptr<osg::ClearNode> clearNode = new osg::ClearNode;
     clearNode->setCullCallback(new TexMatCallback(tm));
@@ -128,4 +186,14 @@ osg::ref_ptr<osg::Node> create(const std::string& dir, double size)
     return switchNode;
 }
 
+void setSize(osg::Node* node, double size)
+{
+    osg::Switch* switchNode = node ? node->asSwitch() : nullptr;
+    osg::Group* clearNode = switchNode && switchNode->getNumChildren() > 0 ? switchNode->getChild(0)->asGroup() : nullptr;
+    MoveEarthySkyTransform* transform = clearNode && clearNode->getNumChildren() > 0 ? dynamic_cast<MoveEarthySkyTransform*>(clearNode->getChild(0)) : nullptr;
+    if (transform) {
+        transform->setSize(size);
+    }
+}
+
 };
@@ -14,10 +14,14 @@
 #define GSKYBOX_H
 
 #include <osg/Node>
+#include <osg/TextureCubeMap>
 
 namespace GSkyBox {
 
+extern void preload(const std::string& dir, const std::string& cacheDirectory = std::string(), bool compress = false);
+extern osg::ref_ptr<osg::TextureCubeMap> cubeMap(const std::string& dir);
 extern osg::ref_ptr<osg::Node> create(const std::string& dir, double size);
+extern void setSize(osg::Node* node, double size);
 
 };
 
@@ -0,0 +1,391 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gtexturecache.h"
+#include "gmappedfile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <osg/Texture>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#define TEXTURE_CACHE_MAGIC "GTEX"
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_ALIGNMENT 16
+
+namespace GTextureCache {
+
+struct GTextureHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t s;
+    uint32_t t;
+    uint32_t internalFormat;
+    uint32_t pixelFormat;
+    uint32_t dataType;
+    uint32_t packing;
+    uint32_t origin;
+    uint32_t levels;
+};
+
+struct GLevel {
+    unsigned int s = 0;
+    unsigned int t = 0;
+    std::vector<unsigned char> rgba;
+};
+
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static size_t alignSize(size_t size)
+{
+    return (size + TEXTURE_CACHE_ALIGNMENT - 1) / TEXTURE_CACHE_ALIGNMENT * TEXTURE_CACHE_ALIGNMENT;
+}
+
+static bool readLevel(const osg::Image* image, GLevel& level, bool& hasAlpha)
+{
+    if (image->getDataType() != GL_UNSIGNED_BYTE || image->r() != 1 || image->isCompressed() || !image->data()) {
+        return false;
+    }
+    GLenum format = image->getPixelFormat();
+    if (format != GL_RGB && format != GL_RGBA && format != GL_LUMINANCE && format != GL_LUMINANCE_ALPHA && format != GL_BGR && format != GL_BGRA) {
+        return false;
+    }
+    unsigned int components = osg::Image::computeNumComponents(format);
+    level.s = image->s();
+    level.t = image->t();
+    level.rgba.resize((size_t)level.s * level.t * 4);
+    hasAlpha = false;
+    for (unsigned int row = 0; row < level.t; row++) {
+        const unsigned char* src = image->data(0, row);
+        unsigned char* dst = level.rgba.data() + (size_t)row * level.s * 4;
+        for (unsigned int col = 0; col < level.s; col++, src += components, dst += 4) {
+            switch (format) {
+            case GL_LUMINANCE:
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = 255;
+                break;
+            case GL_LUMINANCE_ALPHA:
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = src[1];
+                break;
+            case GL_BGR:
+            case GL_BGRA:
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = components == 4 ? src[3] : 255;
+                break;
+            default:
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = components == 4 ? src[3] : 255;
+                break;
+            }
+            hasAlpha = hasAlpha || dst[3] != 255;
+        }
+    }
+    return true;
+}
+
+static GLevel downsample(const GLevel& level)
+{
+    GLevel next;
+    next.s = std::max(1u, level.s / 2);
+    next.t = std::max(1u, level.t / 2);
+    next.rgba.resize((size_t)next.s * next.t * 4);
+    for (unsigned int y = 0; y < next.t; y++) {
+        unsigned int y0 = std::min(y * 2, level.t - 1);
+        unsigned int y1 = std::min(y * 2 + 1, level.t - 1);
+        for (unsigned int x = 0; x < next.s; x++) {
+            unsigned int x0 = std::min(x * 2, level.s - 1);
+            unsigned int x1 = std::min(x * 2 + 1, level.s - 1);
+            for (unsigned int c = 0; c < 4; c++) {
+                unsigned int sum = level.rgba[((size_t)y0 * level.s + x0) * 4 + c] + level.rgba[((size_t)y0 * level.s + x1) * 4 + c]
+                    + level.rgba[((size_t)y1 * level.s + x0) * 4 + c] + level.rgba[((size_t)y1 * level.s + x1) * 4 + c];
+                next.rgba[((size_t)y * next.s + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return next;
+}
+
+static uint16_t packColor(const unsigned char* color)
+{
+    return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void unpackColor(uint16_t packed, int* color)
+{
+    color[0] = ((packed >> 11) & 0x1f) * 255 / 31;
+    color[1] = ((packed >> 5) & 0x3f) * 255 / 63;
+    color[2] = (packed & 0x1f) * 255 / 31;
+}
+
+static void encodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+    unsigned char minColor[3] = { 255, 255, 255 };
+    unsigned char maxColor[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = std::min(minColor[c], block[i][c]);
+            maxColor[c] = std::max(maxColor[c], block[i][c]);
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        int inset = (maxColor[c] - minColor[c]) / 16;
+        minColor[c] = (unsigned char)std::min(255, minColor[c] + inset);
+        maxColor[c] = (unsigned char)std::max(0, maxColor[c] - inset);
+    }
+    uint16_t color0 = packColor(maxColor);
+    uint16_t color1 = packColor(minColor);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestDistance = INT32_MAX;
+            for (int p = 0; p < 4; p++) {
+                int distance = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = block[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+    out[0] = (unsigned char)(color0 & 0xff);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xff);
+    out[3] = (unsigned char)(color1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (unsigned char)(indices >> (i * 8));
+    }
+}
+
+static void encodeAlphaBlock(const unsigned char block[16][4], unsigned char* out)
+{
+    unsigned char minAlpha = 255;
+    unsigned char maxAlpha = 0;
+    for (int i = 0; i < 16; i++) {
+        minAlpha = std::min(minAlpha, block[i][3]);
+        maxAlpha = std::max(maxAlpha, block[i][3]);
+    }
+    uint64_t indices = 0;
+    if (maxAlpha != minAlpha) {
+        int palette[8] = { maxAlpha, minAlpha };
+        for (int i = 1; i < 7; i++) {
+            palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha) / 7;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best])) {
+                    best = p;
+                }
+            }
+            indices |= (uint64_t)best << (i * 3);
+        }
+    }
+    out[0] = maxAlpha;
+    out[1] = minAlpha;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+    }
+}
+
+static std::vector<unsigned char> encodeLevel(const GLevel& level, bool alpha)
+{
+    unsigned int blocksS = (level.s + 3) / 4;
+    unsigned int blocksT = (level.t + 3) / 4;
+    size_t blockSize = alpha ? 16 : 8;
+    std::vector<unsigned char> data((size_t)blocksS * blocksT * blockSize);
+    unsigned char block[16][4];
+    for (unsigned int by = 0; by < blocksT; by++) {
+        for (unsigned int bx = 0; bx < blocksS; bx++) {
+            for (unsigned int i = 0; i < 16; i++) {
+                unsigned int x = std::min(bx * 4 + i % 4, level.s - 1);
+                unsigned int y = std::min(by * 4 + i / 4, level.t - 1);
+                std::memcpy(block[i], level.rgba.data() + ((size_t)y * level.s + x) * 4, 4);
+            }
+            unsigned char* out = data.data() + ((size_t)by * blocksS + bx) * blockSize;
+            if (alpha) {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+        }
+    }
+    return data;
+}
+
+static std::vector<unsigned char> packLevel(const GLevel& level, bool alpha)
+{
+    if (alpha) {
+        return level.rgba;
+    }
+    std::vector<unsigned char> data((size_t)level.s * level.t * 3);
+    for (size_t i = 0; i < (size_t)level.s * level.t; i++) {
+        std::memcpy(data.data() + i * 3, level.rgba.data() + i * 4, 3);
+    }
+    return data;
+}
+
+std::string cachePath(const std::string& directory, const std::string& file, bool compress)
+{
+    struct stat info;
+    if (directory.empty() || stat(file.c_str(), &info) != 0) {
+        return std::string();
+    }
+    std::string path = osgDB::getRealPath(file);
+    uint64_t hash = hashBytes(path.data(), path.size());
+    uint64_t size = (uint64_t)info.st_size;
+    uint64_t time = (uint64_t)info.st_mtime;
+    hash = hashBytes(&size, sizeof(size), hash);
+    hash = hashBytes(&time, sizeof(time), hash);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+    return osgDB::concatPaths(directory, std::string(name) + (compress ? ".dxt.gtex" : ".gtex"));
+}
+
+bool load(const std::string& cacheFile, osg::Image* image)
+{
+    if (cacheFile.empty() || !image || !osgDB::fileExists(cacheFile)) {
+        return false;
+    }
+    osg::ref_ptr<GMappedFile> file = GMappedFile::open(cacheFile);
+    if (!file.valid() || file->size() < sizeof(GTextureHeader)) {
+        return false;
+    }
+    GTextureHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, TEXTURE_CACHE_MAGIC, 4) != 0 || header.version != TEXTURE_CACHE_VERSION || header.levels == 0) {
+        return false;
+    }
+    size_t tableSize = sizeof(GTextureHeader) + header.levels * sizeof(uint32_t);
+    size_t dataOffset = alignSize(tableSize);
+    if (file->size() < dataOffset) {
+        return false;
+    }
+    std::vector<uint32_t> offsets(header.levels);
+    std::memcpy(offsets.data(), file->data() + sizeof(GTextureHeader), header.levels * sizeof(uint32_t));
+    size_t dataSize = file->size() - dataOffset;
+    unsigned int s = header.s;
+    unsigned int t = header.t;
+    for (unsigned int i = 0; i < header.levels; i++) {
+        size_t levelSize = osg::Image::computeImageSizeInBytes(s, t, 1, header.pixelFormat, header.dataType, header.packing);
+        if (offsets[i] + levelSize > dataSize) {
+            return false;
+        }
+        s = std::max(1u, s / 2);
+        t = std::max(1u, t / 2);
+    }
+    image->setImage(header.s, header.t, 1, header.internalFormat, header.pixelFormat, header.dataType,
+        file->data() + dataOffset, osg::Image::NO_DELETE, header.packing);
+    image->setMipmapLevels(osg::Image::MipmapDataType(offsets.begin() + 1, offsets.end()));
+    image->setOrigin((osg::Image::Origin)header.origin);
+    // The image only borrows the mapped pages, keep the mapping alive as long as the image.
+    image->setUserData(file);
+    return true;
+}
+
+bool store(const std::string& cacheFile, const osg::Image* image, bool compress)
+{
+    if (cacheFile.empty() || !image) {
+        return false;
+    }
+    std::vector<GLevel> levels(1);
+    bool alpha = false;
+    if (!readLevel(image, levels.front(), alpha)) {
+        return false;
+    }
+    while (levels.back().s > 1 || levels.back().t > 1) {
+        levels.push_back(downsample(levels.back()));
+    }
+    GTextureHeader header;
+    std::memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.s = image->s();
+    header.t = image->t();
+    header.pixelFormat = compress ? (alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : (alpha ? GL_RGBA : GL_RGB);
+    header.internalFormat = header.pixelFormat;
+    header.dataType = GL_UNSIGNED_BYTE;
+    header.packing = 1;
+    header.origin = image->getOrigin();
+    header.levels = (uint32_t)levels.size();
+    std::vector<std::vector<unsigned char>> dataList(levels.size());
+    std::vector<uint32_t> offsets(levels.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        dataList[i] = compress ? encodeLevel(levels[i], alpha) : packLevel(levels[i], alpha);
+        offsets[i] = (uint32_t)offset;
+        offset += dataList[i].size();
+    }
+    osgDB::makeDirectoryForFile(cacheFile);
+    std::string tempFile = cacheFile + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            return false;
+        }
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+        std::vector<char> padding(alignSize(sizeof(header) + offsets.size() * sizeof(uint32_t)) - sizeof(header) - offsets.size() * sizeof(uint32_t), 0);
+        stream.write(padding.data(), padding.size());
+        for (const auto& data : dataList) {
+            stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+        if (!stream) {
+            stream.close();
+            std::remove(tempFile.c_str());
+            return false;
+        }
+    }
+    std::remove(cacheFile.c_str());
+    if (std::rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+};
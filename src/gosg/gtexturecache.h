@@ -0,0 +1,27 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GTEXTURECACHE_H
+#define GTEXTURECACHE_H
+
+#include <osg/Image>
+#include <string>
+
+namespace GTextureCache {
+
+extern std::string cachePath(const std::string& directory, const std::string& file, bool compress);
+extern bool load(const std::string& cacheFile, osg::Image* image);
+extern bool store(const std::string& cacheFile, const osg::Image* image, bool compress);
+
+};
+
+#endif // GTEXTURECACHE_H
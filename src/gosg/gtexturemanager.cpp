@@ -0,0 +1,267 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#include "gtexturemanager.h"
+#include "gnodevisitor.h"
+#include <algorithm>
+#include <cmath>
+#include <osgUtil/CullVisitor>
+
+#define TEXTURE_COLD_FRAMES 300
+#define TEXTURE_STREAM_PER_FRAME 4
+#define TEXTURE_DEFAULT_BUDGET (256ULL * 1024 * 1024)
+
+class GTextureSwapOperation : public osg::GraphicsOperation {
+public:
+    using SwapList = std::vector<std::pair<osg::ref_ptr<osg::Texture2D>, osg::ref_ptr<osg::Image>>>;
+    explicit GTextureSwapOperation(const SwapList& swapList)
+        : osg::GraphicsOperation("GTextureSwap", false)
+        , m_swapList(swapList)
+    {
+    }
+    virtual void operator()(osg::GraphicsContext* context) override
+    {
+        (void)context;
+        for (const auto& swap : m_swapList) {
+            swap.first->setImage(swap.second);
+            swap.first->dirtyTextureObject();
+        }
+    }
+
+private:
+    SwapList m_swapList;
+};
+
+class GTextureCullCallback : public osg::DrawableCullCallback {
+public:
+    explicit GTextureCullCallback(const std::vector<osg::ref_ptr<GTextureManager::Entry>>& entryList)
+        : m_entryList(entryList)
+    {
+    }
+    virtual bool cull(osg::NodeVisitor* nv, osg::Drawable* drawable, osg::RenderInfo* renderInfo) const override
+    {
+        (void)renderInfo;
+        osgUtil::CullVisitor* cv = nv ? nv->asCullVisitor() : nullptr;
+        if (!cv || !nv->getFrameStamp()) {
+            return false;
+        }
+        if (drawable->isCullingActive() && cv->isCulled(drawable->getBoundingBox())) {
+            return true;
+        }
+        // Diameter of the bounding sphere on screen, one texel per pixel is enough.
+        float pixels = std::max(1.0f, 2.0f * cv->clampedPixelSize(drawable->getBound()));
+        unsigned int frameNumber = nv->getFrameStamp()->getFrameNumber();
+        for (const auto& entry : m_entryList) {
+            int size = std::max(entry->source->s(), entry->source->t());
+            unsigned int level = (unsigned int)std::max(0.0f, std::floor(std::log2(size / pixels)));
+            level = std::min(level, entry->levels - 1);
+            unsigned int wanted = entry->wanted;
+            while (level < wanted && !entry->wanted.compare_exchange_weak(wanted, level)) {
+            }
+            entry->lastFrame = frameNumber;
+        }
+        return false;
+    }
+
+private:
+    std::vector<osg::ref_ptr<GTextureManager::Entry>> m_entryList;
+};
+
+GTextureManager::GTextureManager()
+    : m_budget(TEXTURE_DEFAULT_BUDGET)
+    , m_residentBytes(0)
+{
+}
+
+void GTextureManager::setBudget(unsigned long long budget)
+{
+    m_budget = budget;
+}
+
+unsigned int GTextureManager::attach(osg::Node* node)
+{
+    if (!node) {
+        return 0;
+    }
+    GGeometryVisitor geometryVisitor;
+    geometryVisitor.collect(node);
+    std::lock_guard<std::mutex> locker(m_mutex);
+    unsigned int count = 0;
+    auto collectTextures = [&](osg::StateSet* stateSet, std::vector<osg::ref_ptr<Entry>>& entryList) {
+        if (!stateSet) {
+            return;
+        }
+        for (const auto& unit : stateSet->getTextureAttributeList()) {
+            for (const auto& attribute : unit) {
+                osg::Texture* texture = attribute.second.first->asTexture();
+                osg::Texture2D* texture2D = dynamic_cast<osg::Texture2D*>(texture);
+                osg::Image* image = texture2D ? texture2D->getImage() : nullptr;
+                if (!image || !image->data() || !image->isMipmap() || texture2D->getDataVariance() == osg::Object::DYNAMIC) {
+                    // Nothing to stream, the CPU copy is only needed until the first upload.
+                    if (texture && image && image->getAllocationMode() != osg::Image::NO_DELETE) {
+                        texture->setUnRefImageDataAfterApply(true);
+                    }
+                    continue;
+                }
+                auto it = m_entryList.find(texture2D);
+                if (it == m_entryList.end()) {
+                    it = m_entryList.emplace(texture2D, new Entry).first;
+                    Entry& entry = *it->second;
+                    entry.texture = texture2D;
+                    entry.source = image;
+                    entry.levels = image->getNumMipmapLevels();
+                    entry.level = 0;
+                    entry.wanted = entry.levels - 1;
+                    entry.lastFrame = m_frameNumber;
+                    m_residentBytes += levelBytes(entry, 0);
+                    count++;
+                }
+                entryList.push_back(it->second);
+            }
+        }
+    };
+    std::vector<osg::ref_ptr<Entry>> nodeEntryList;
+    for (const auto& stateSet : geometryVisitor.nodeStateSetList()) {
+        collectTextures(stateSet, nodeEntryList);
+    }
+    for (const auto& geometry : geometryVisitor.geometryList()) {
+        std::vector<osg::ref_ptr<Entry>> entryList;
+        collectTextures(geometry->getStateSet(), entryList);
+        if (!entryList.empty() && !geometry->getCullCallback()) {
+            geometry->setCullCallback(new GTextureCullCallback(entryList));
+        }
+    }
+    // Textures bound on group StateSets have no single drawable to measure, keep them at full size.
+    for (const auto& entry : nodeEntryList) {
+        entry->lastFrame = UINT32_MAX;
+        entry->wanted = 0;
+    }
+    return count;
+}
+
+void GTextureManager::clear()
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_entryList.clear();
+    m_residentBytes = 0;
+}
+
+void GTextureManager::operator()(osg::Node* node, osg::NodeVisitor* nv)
+{
+    if (nv && nv->getFrameStamp()) {
+        update(nv->getFrameStamp()->getFrameNumber());
+    }
+    traverse(node, nv);
+}
+
+void GTextureManager::update(unsigned int frameNumber)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_frameNumber = frameNumber;
+    if (m_entryList.empty()) {
+        return;
+    }
+    std::vector<std::pair<Entry*, unsigned int>> targetList;
+    targetList.reserve(m_entryList.size());
+    unsigned long long targetBytes = 0;
+    for (auto& it : m_entryList) {
+        Entry& entry = *it.second;
+        unsigned int lastFrame = entry.lastFrame;
+        bool cold = lastFrame != UINT32_MAX && frameNumber > lastFrame && frameNumber - lastFrame > TEXTURE_COLD_FRAMES;
+        unsigned int target = cold ? entry.levels - 1 : std::min<unsigned int>(entry.wanted, entry.levels - 1);
+        if (lastFrame != UINT32_MAX) {
+            entry.wanted = entry.levels - 1;
+        }
+        targetList.emplace_back(&entry, target);
+        targetBytes += levelBytes(entry, target);
+    }
+    // Over budget, drop one level at a time from the least recently seen textures.
+    std::sort(targetList.begin(), targetList.end(), [](const std::pair<Entry*, unsigned int>& a, const std::pair<Entry*, unsigned int>& b) {
+        return a.first->lastFrame < b.first->lastFrame;
+    });
+    bool reduced = true;
+    while (targetBytes > m_budget && reduced) {
+        reduced = false;
+        for (auto& target : targetList) {
+            if (target.second + 1 < target.first->levels) {
+                targetBytes -= levelBytes(*target.first, target.second) - levelBytes(*target.first, target.second + 1);
+                target.second++;
+                reduced = true;
+                if (targetBytes <= m_budget) {
+                    break;
+                }
+            }
+        }
+    }
+    unsigned int streamed = 0;
+    unsigned long long residentBytes = 0;
+    GTextureSwapOperation::SwapList swapList;
+    for (auto& target : targetList) {
+        Entry& entry = *target.first;
+        // Coarser levels are free, finer levels are streamed in a few per frame to keep uploads small.
+        if (target.second < entry.level && streamed < TEXTURE_STREAM_PER_FRAME) {
+            streamed++;
+        } else if (target.second < entry.level) {
+            target.second = entry.level;
+        }
+        if (target.second != entry.level) {
+            entry.level = target.second;
+            swapList.emplace_back(entry.texture, levelImage(entry, entry.level));
+        }
+        residentBytes += levelBytes(entry, entry.level);
+    }
+    if (!swapList.empty()) {
+        // The previous frame may still be drawing these textures, the swap runs on the draw thread after it.
+        osg::ref_ptr<GTextureSwapOperation> operation = new GTextureSwapOperation(swapList);
+        osg::ref_ptr<osg::GraphicsContext> graphicsContext;
+        if (m_graphicsContext.lock(graphicsContext)) {
+            graphicsContext->add(operation);
+        } else {
+            (*operation)(nullptr);
+        }
+    }
+    if (m_residentBytes != residentBytes) {
+        m_residentBytes = residentBytes;
+        if (m_residentChangedCallback) {
+            m_residentChangedCallback(residentBytes);
+        }
+    }
+}
+
+osg::ref_ptr<osg::Image> GTextureManager::levelImage(const Entry& entry, unsigned int level) const
+{
+    const osg::Image* source = entry.source;
+    if (level == 0) {
+        return entry.source;
+    }
+    unsigned int offset = source->getMipmapOffset(level);
+    osg::Image::MipmapDataType mipmapList;
+    for (unsigned int i = level + 1; i < entry.levels; i++) {
+        mipmapList.push_back(source->getMipmapOffset(i) - offset);
+    }
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->setFileName(source->getFileName());
+    image->setImage(std::max(1, source->s() >> level), std::max(1, source->t() >> level), 1, source->getInternalTextureFormat(), source->getPixelFormat(), source->getDataType(),
+        const_cast<unsigned char*>(source->getMipmapData(level)), osg::Image::NO_DELETE, source->getPacking());
+    image->setMipmapLevels(mipmapList);
+    image->setOrigin(source->getOrigin());
+    // The level borrows the pixels of the source image, keep the source alive with it.
+    image->setUserData(const_cast<osg::Image*>(source));
+    return image;
+}
+
+unsigned long long GTextureManager::levelBytes(const Entry& entry, unsigned int level) const
+{
+    const osg::Image* source = entry.source;
+    unsigned int offset = level == 0 ? 0 : source->getMipmapOffset(level);
+    return source->getTotalSizeInBytesIncludingMipmaps() - offset;
+}
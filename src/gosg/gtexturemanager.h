@@ -0,0 +1,69 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+#ifndef GTEXTUREMANAGER_H
+#define GTEXTUREMANAGER_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <osg/Callback>
+#include <osg/GraphicsContext>
+#include <osg/Node>
+#include <osg/observer_ptr>
+#include <osg/Texture2D>
+
+class GTextureManager : public osg::NodeCallback {
+public:
+    using ResidentChangedCallback = std::function<void(unsigned long long)>;
+    explicit GTextureManager();
+    struct Entry : public osg::Referenced {
+        osg::ref_ptr<osg::Texture2D> texture;
+        osg::ref_ptr<osg::Image> source;
+        unsigned int levels = 1;
+        unsigned int level = 0;
+        std::atomic<unsigned int> wanted;
+        std::atomic<unsigned int> lastFrame;
+    };
+
+public:
+    inline unsigned long long budget() const { return m_budget; }
+    inline unsigned long long residentBytes() const { return m_residentBytes; }
+    inline void setResidentChangedCallback(const ResidentChangedCallback& callback) { m_residentChangedCallback = callback; }
+    inline void setGraphicsContext(osg::GraphicsContext* graphicsContext) { m_graphicsContext = graphicsContext; }
+    void setBudget(unsigned long long budget);
+    unsigned int attach(osg::Node* node);
+    void clear();
+
+public:
+    virtual void operator()(osg::Node* node, osg::NodeVisitor* nv) override;
+
+protected:
+    virtual ~GTextureManager() = default;
+
+private:
+    void update(unsigned int frameNumber);
+    osg::ref_ptr<osg::Image> levelImage(const Entry& entry, unsigned int level) const;
+    unsigned long long levelBytes(const Entry& entry, unsigned int level) const;
+
+private:
+    std::map<osg::Texture2D*, osg::ref_ptr<Entry>> m_entryList;
+    std::mutex m_mutex;
+    std::atomic<unsigned long long> m_budget;
+    std::atomic<unsigned long long> m_residentBytes;
+    unsigned int m_frameNumber = 0;
+    osg::observer_ptr<osg::GraphicsContext> m_graphicsContext;
+    ResidentChangedCallback m_residentChangedCallback;
+};
+
+#endif // GTEXTUREMANAGER_H
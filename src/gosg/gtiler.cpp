@@ -0,0 +1,323 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gtiler.h"
+#include "gdedup.h"
+#include "gnodevisitor.h"
+#include "gscenefile.h"
+#include "gscenestats.h"
+#include <algorithm>
+#include <cfloat>
+#include <map>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/PagedLOD>
+#include <osg/Texture>
+#include <osg/ValueObject>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/WriteFile>
+#include <osgUtil/Simplifier>
+#include <set>
+#include <vector>
+
+#define TILE_BYTES_VALUE "gtilerTileBytes"
+
+namespace GTiler {
+
+struct Item {
+    osg::ref_ptr<osg::Drawable> drawable;
+    osg::ref_ptr<osg::StateSet> stateSet;
+    osg::Matrixd matrix;
+    osg::BoundingBox box;
+    unsigned long long triangles = 0;
+};
+
+using ItemList = std::vector<const Item*>;
+using StateGroupMap = std::map<osg::StateSet*, osg::ref_ptr<osg::Group>>;
+
+class GItemVisitor : public osg::NodeVisitor {
+public:
+    explicit GItemVisitor()
+        : osg::NodeVisitor(TRAVERSE_ACTIVE_CHILDREN)
+    {
+    }
+    inline std::vector<Item>& itemList() { return m_itemList; }
+
+protected:
+    virtual void apply(osg::Drawable& drawable) override
+    {
+        Item item;
+        item.drawable = &drawable;
+        item.stateSet = inheritedStateSet();
+        item.matrix = osg::computeLocalToWorld(getNodePath());
+        const osg::BoundingBox& box = drawable.getBoundingBox();
+        for (unsigned int i = 0; box.valid() && i < 8; i++) {
+            item.box.expandBy(box.corner(i) * item.matrix);
+        }
+        item.triangles = GSceneStats::collect(&drawable).triangles;
+        if (item.box.valid()) {
+            m_itemList.push_back(item);
+        }
+    }
+
+private:
+    osg::StateSet* inheritedStateSet()
+    {
+        // State of the nodes above the drawable, merged once per distinct path.
+        std::vector<osg::StateSet*> path;
+        const osg::NodePath& nodePath = getNodePath();
+        for (size_t i = 0; i + 1 < nodePath.size(); i++) {
+            if (nodePath[i]->getStateSet()) {
+                path.push_back(nodePath[i]->getStateSet());
+            }
+        }
+        if (path.empty()) {
+            return nullptr;
+        }
+        osg::ref_ptr<osg::StateSet>& merged = m_stateSetList[path];
+        if (!merged.valid()) {
+            merged = new osg::StateSet;
+            for (osg::StateSet* stateSet : path) {
+                merged->merge(*stateSet);
+            }
+        }
+        return merged.get();
+    }
+
+private:
+    std::vector<Item> m_itemList;
+    std::map<std::vector<osg::StateSet*>, osg::ref_ptr<osg::StateSet>> m_stateSetList;
+};
+
+class GTileBuilder {
+public:
+    explicit GTileBuilder(const std::string& outputFile, const std::string& sourceFile, const Options& options, Report& report)
+        : m_outputFile(outputFile)
+        , m_sourceDirectory(osgDB::getFilePath(sourceFile))
+        , m_options(options)
+        , m_report(report)
+    {
+    }
+    osg::ref_ptr<osg::PagedLOD> buildCell(const ItemList& items, const osg::BoundingBox& cell, unsigned int depth, const std::string& name)
+    {
+        m_report.levels = std::max(m_report.levels, depth + 1);
+        osg::ref_ptr<osg::Group> detail = new osg::Group;
+        StateGroupMap detailGroups;
+        unsigned long long triangles = 0;
+        osg::BoundingBox bound;
+        for (const Item* item : items) {
+            triangles += item->triangles;
+            bound.expandBy(item->box);
+        }
+        if (triangles <= m_options.maxTriangles || depth >= m_options.maxDepth) {
+            for (const Item* item : items) {
+                addItem(detail, detailGroups, *item, item->drawable);
+            }
+        } else {
+            // Items larger than an octant stay at this level, the rest go to the octant holding their center.
+            const osg::Vec3 center = cell.center();
+            const osg::Vec3 half = (cell._max - cell._min) * 0.5f;
+            ItemList octants[8];
+            for (const Item* item : items) {
+                const osg::Vec3 size = item->box._max - item->box._min;
+                if (size.x() > half.x() || size.y() > half.y() || size.z() > half.z()) {
+                    addItem(detail, detailGroups, *item, item->drawable);
+                    continue;
+                }
+                const osg::Vec3 itemCenter = item->box.center();
+                unsigned int octant = (itemCenter.x() >= center.x() ? 1 : 0) | (itemCenter.y() >= center.y() ? 2 : 0) | (itemCenter.z() >= center.z() ? 4 : 0);
+                octants[octant].push_back(item);
+            }
+            for (unsigned int i = 0; i < 8; i++) {
+                if (octants[i].empty()) {
+                    continue;
+                }
+                osg::BoundingBox octantCell;
+                octantCell._min.set(i & 1 ? center.x() : cell.xMin(), i & 2 ? center.y() : cell.yMin(), i & 4 ? center.z() : cell.zMin());
+                octantCell._max.set(i & 1 ? cell.xMax() : center.x(), i & 2 ? cell.yMax() : center.y(), i & 4 ? cell.zMax() : center.z());
+                osg::ref_ptr<osg::PagedLOD> child = buildCell(octants[i], octantCell, depth + 1, name + std::to_string(i));
+                if (!child.valid()) {
+                    return nullptr;
+                }
+                detail->addChild(child);
+            }
+        }
+        const std::string fileName = osgDB::getStrippedName(m_outputFile) + "_t" + name + "." + m_options.extension;
+        if (!writeTile(detail, osgDB::concatPaths(osgDB::getFilePath(m_outputFile), fileName))) {
+            return nullptr;
+        }
+        m_report.tiles++;
+        m_report.tileBytes += GDedup::residentBytes(detail);
+        const float cutoff = bound.radius() * m_options.rangeFactor;
+        osg::ref_ptr<osg::PagedLOD> lod = new osg::PagedLOD;
+        lod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+        lod->setCenter(bound.center());
+        lod->setRadius(bound.radius());
+        lod->addChild(buildProxy(items, cell), cutoff, FLT_MAX);
+        lod->setFileName(1, fileName);
+        lod->setRange(1, 0.0f, cutoff);
+        return lod;
+    }
+    bool writeTile(osg::Node* node, const std::string& file)
+    {
+        if (osgDB::getLowerCaseFileExtension(file) == "gscene") {
+            // Images are referenced by name, pin them to absolute paths so the tiles can live anywhere.
+            resolveImages(node);
+            return GSceneFile::write(node, file);
+        }
+        osgDB::makeDirectoryForFile(file);
+        return osgDB::writeNodeFile(*node, file);
+    }
+
+private:
+    static void addItem(osg::Group* parent, StateGroupMap& groups, const Item& item, osg::Drawable* drawable)
+    {
+        osg::ref_ptr<osg::Group>& group = groups[item.stateSet.get()];
+        if (!group.valid()) {
+            group = new osg::Group;
+            group->setStateSet(item.stateSet);
+            parent->addChild(group);
+        }
+        if (item.matrix.isIdentity()) {
+            group->addChild(drawable);
+            return;
+        }
+        osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform(item.matrix);
+        transform->addChild(drawable);
+        group->addChild(transform);
+    }
+    osg::ref_ptr<osg::Group> buildProxy(const ItemList& items, const osg::BoundingBox& cell)
+    {
+        // Coarse stand-in for the whole cell: small parts are dropped, the rest decimated.
+        osg::ref_ptr<osg::Group> proxy = new osg::Group;
+        StateGroupMap proxyGroups;
+        const float featureSize = cell.radius() * 2.0f * m_options.proxyFeatureSize;
+        for (const Item* item : items) {
+            const osg::Geometry* geometry = item->drawable->asGeometry();
+            if (!geometry || item->box.radius() * 2.0f < featureSize || !GGeometryVisitor::isPlainGeometry(geometry)) {
+                continue;
+            }
+            osg::ref_ptr<osg::Geometry>& simplified = m_proxyList[geometry];
+            if (!simplified.valid()) {
+                simplified = new osg::Geometry(*geometry, osg::CopyOp::DEEP_COPY_ARRAYS | osg::CopyOp::DEEP_COPY_PRIMITIVES);
+                osgUtil::Simplifier simplifier(m_options.proxyRatio);
+                simplifier.simplify(*simplified);
+            }
+            addItem(proxy, proxyGroups, *item, simplified);
+        }
+        return proxy;
+    }
+    void resolveImages(osg::Node* node)
+    {
+        GGeometryVisitor visitor;
+        visitor.collect(node);
+        std::vector<osg::StateSet*> stateSets;
+        for (const auto& stateSet : visitor.nodeStateSetList()) {
+            stateSets.push_back(stateSet);
+        }
+        for (const auto& stateSet : visitor.drawableStateSetList()) {
+            stateSets.push_back(stateSet);
+        }
+        for (osg::StateSet* stateSet : stateSets) {
+            for (const auto& unit : stateSet->getTextureAttributeList()) {
+                for (const auto& attribute : unit) {
+                    osg::Texture* texture = attribute.second.first->asTexture();
+                    for (unsigned int i = 0; texture && i < texture->getNumImages(); i++) {
+                        osg::Image* image = texture->getImage(i);
+                        if (!image || image->getFileName().empty() || !m_resolvedImages.insert(image).second) {
+                            continue;
+                        }
+                        std::string path = osgDB::concatPaths(m_sourceDirectory, image->getFileName());
+                        if (!osgDB::fileExists(path)) {
+                            path = osgDB::findDataFile(image->getFileName());
+                        }
+                        if (!path.empty()) {
+                            image->setFileName(osgDB::getRealPath(path));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    std::string m_outputFile;
+    std::string m_sourceDirectory;
+    Options m_options;
+    Report& m_report;
+    std::map<const osg::Geometry*, osg::ref_ptr<osg::Geometry>> m_proxyList;
+    std::set<const osg::Image*> m_resolvedImages;
+};
+
+Report build(osg::Node* node, const std::string& outputFile, const std::string& sourceFile, const Options& options)
+{
+    Report report;
+    if (!node || outputFile.empty()) {
+        return report;
+    }
+    GItemVisitor visitor;
+    node->accept(visitor);
+    ItemList items;
+    osg::BoundingBox bound;
+    for (const Item& item : visitor.itemList()) {
+        items.push_back(&item);
+        bound.expandBy(item.box);
+        report.triangles += item.triangles;
+    }
+    report.drawables = (unsigned int)items.size();
+    if (items.empty()) {
+        return report;
+    }
+    // Octants split a cube, so a flat model still halves along every axis.
+    const float half = std::max(std::max(bound.xMax() - bound.xMin(), bound.yMax() - bound.yMin()), bound.zMax() - bound.zMin()) * 0.5f;
+    const osg::Vec3 extent(half, half, half);
+    const osg::BoundingBox cell(bound.center() - extent, bound.center() + extent);
+    GTileBuilder builder(outputFile, sourceFile, options, report);
+    osg::ref_ptr<osg::PagedLOD> root = builder.buildCell(items, cell, 0, "");
+    if (!root.valid()) {
+        return Report();
+    }
+    report.tileBytes /= std::max(1u, report.tiles);
+    root->setUserValue(TILE_BYTES_VALUE, (double)report.tileBytes);
+    if (!builder.writeTile(root, outputFile)) {
+        return Report();
+    }
+    return report;
+}
+
+unsigned long long tileBytes(const osg::Node* node)
+{
+    double bytes = 0;
+    if (!node || !node->getUserValue(TILE_BYTES_VALUE, bytes)) {
+        return 0;
+    }
+    return (unsigned long long)bytes;
+}
+
+void setPagerThreads(osgDB::DatabasePager* pager, unsigned int threads)
+{
+    if (pager) {
+        pager->setUpThreads(std::max(1u, threads), 1);
+    }
+}
+
+void setPagerMemoryCap(osgDB::DatabasePager* pager, unsigned long long memoryCap, unsigned long long tileBytes)
+{
+    if (pager && memoryCap > 0 && tileBytes > 0) {
+        // The pager caps the number of resident PagedLODs, so the byte cap goes through the average tile size.
+        pager->setTargetMaximumNumberOfPageLOD((unsigned int)std::max(1ULL, memoryCap / tileBytes));
+    }
+}
+
+};
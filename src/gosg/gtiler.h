@@ -0,0 +1,47 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GTILER_H
+#define GTILER_H
+
+#include <osg/Node>
+#include <osgDB/DatabasePager>
+#include <string>
+
+namespace GTiler {
+
+struct Options {
+    unsigned int maxDepth = 8;
+    unsigned int maxTriangles = 65536;
+    float proxyRatio = 0.1f;
+    float proxyFeatureSize = 1.0f / 32.0f;
+    float rangeFactor = 4.0f;
+    std::string extension = "gscene";
+};
+
+struct Report {
+    unsigned int tiles = 0;
+    unsigned int levels = 0;
+    unsigned int drawables = 0;
+    unsigned long long triangles = 0;
+    unsigned long long tileBytes = 0;
+};
+
+extern Report build(osg::Node* node, const std::string& outputFile, const std::string& sourceFile = std::string(), const Options& options = Options());
+extern unsigned long long tileBytes(const osg::Node* node);
+extern void setPagerThreads(osgDB::DatabasePager* pager, unsigned int threads);
+extern void setPagerMemoryCap(osgDB::DatabasePager* pager, unsigned long long memoryCap, unsigned long long tileBytes);
+
+};
+
+#endif // GTILER_H
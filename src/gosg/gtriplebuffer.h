@@ -0,0 +1,47 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#ifndef GTRIPLEBUFFER_H
+#define GTRIPLEBUFFER_H
+
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread
+// without locks, each side keeps its own slot and they trade the middle one.
+template <typename T>
+class GTripleBuffer {
+public:
+    inline T& back() { return m_slots[m_back]; }
+    inline const T& front() const { return m_slots[m_front]; }
+    inline void publish() { m_back = m_middle.exchange(m_back | DIRTY, std::memory_order_acq_rel) & INDEX; }
+    bool update()
+    {
+        if (!(m_middle.load(std::memory_order_acquire) & DIRTY)) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+private:
+    enum {
+        INDEX = 3,
+        DIRTY = 4,
+    };
+    T m_slots[3];
+    std::atomic<int> m_middle { 1 };
+    int m_back = 0;
+    int m_front = 2;
+};
+
+#endif // GTRIPLEBUFFER_H
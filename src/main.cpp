@@ -10,15 +10,21 @@
  *History:
  **********************************************************************************/
 
+#include "gosg/gmemoryreport.h"
 #include "gosg/gosgcontrol.h"
 #include "gosg/gosgrenderitem.h"
+#include "gosg/gpipeline.h"
 #include <QApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
 #include <QMessageBox>
 #include <QQmlApplicationEngine>
 #include <QQuickWindow>
 #include <QSharedMemory>
+#include <QTextStream>
+#include <cstring>
 
 static bool checkSingletonProcess(const QString& name)
 {
@@ -44,8 +50,45 @@ static bool checkSingletonProcess(const QString& name)
     return true;
 }
 
+static int runMemoryReport(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList& arguments = app.arguments();
+    int index = arguments.indexOf("--memory-report");
+    if (index + 1 >= arguments.size()) {
+        qWarning() << "Usage:" << QFileInfo(arguments.first()).fileName() << "--memory-report <model> [output.json]";
+        return -1;
+    }
+    const std::string& modelFile = arguments.at(index + 1).toStdString();
+    GPipeline::Options options;
+    options.cacheDirectory = GPipeline::cacheDirectory(modelFile);
+    GPipeline::Report report;
+    osg::ref_ptr<osg::Node> node = GPipeline::load(modelFile, options, report);
+    if (!node.valid()) {
+        qWarning() << "Failed to load model !";
+        return -2;
+    }
+    const QByteArray& json = QJsonDocument(GMemoryReport::create(node)).toJson();
+    if (index + 2 < arguments.size()) {
+        QFile file(arguments.at(index + 2));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Failed to write" << file.fileName();
+            return -3;
+        }
+        file.write(json);
+        return 0;
+    }
+    QTextStream(stdout) << json;
+    return 0;
+}
+
 int main(int argc, char* argv[])
 {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--memory-report") == 0) {
+            return runMemoryReport(argc, argv);
+        }
+    }
     QCoreApplication::setAttribute(Qt::AA_UseDesktopOpenGL);
 #if QT_VERSION_MAJOR >= 6
     QQuickWindow::setGraphicsApi(QSGRendererInterface::OpenGL);
@@ -21,6 +21,7 @@ GOsgControl{
         "rotate":"1,-1,-1,1",
         "scale":"1,1,1",
     }
+    batchExcludeList: ["lamp"]
     particleMatrix: {
         "translate":"-2220,0,3650",
         "rotate":"0,0.707107,0,0.707107",
@@ -0,0 +1,250 @@
+/*********************************************************************************
+ *Copyright(C): Juntuan.Lu, 2020-2030, All rights reserved.
+ *Author:  Juntuan.Lu
+ *Version: 1.0
+ *Date:  2021/10/23
+ *Email: 931852884@qq.com
+ *Description:
+ *Others:
+ *Function List:
+ *History:
+ **********************************************************************************/
+
+
+#include "gparallel.h"
+#include "gpipeline.h"
+#include "gtiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#define MODEL_EXTENSIONS { "3ds", "dae", "fbx", "flt", "glb", "gltf", "ive", "lwo", "obj", "osg", "osgb", "osgt", "ply", "stl" }
+
+struct Arguments {
+    std::vector<std::string> inputs;
+    std::string reportFile;
+    GPipeline::Options options;
+    unsigned int jobs = std::max(1u, GParallel::threadCount() / 2);
+    bool force = false;
+    bool tile = false;
+};
+
+struct Result {
+    std::string file;
+    bool success = false;
+    bool tiled = false;
+    unsigned long long inputBytes = 0;
+    unsigned long long sceneBytes = 0;
+    unsigned long long residentBefore = 0;
+    unsigned long long residentAfter = 0;
+    unsigned int tiles = 0;
+    double totalTime = 0;
+    GPipeline::Report report;
+};
+
+static unsigned long long fileSize(const std::string& file)
+{
+    struct stat info;
+    return stat(file.c_str(), &info) == 0 ? (unsigned long long)info.st_size : 0;
+}
+
+static std::string jsonString(const std::string& value)
+{
+    std::string result = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", (unsigned int)(unsigned char)c);
+            result += escape;
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+static void collectFiles(const std::string& path, bool explicitFile, std::vector<std::string>& files)
+{
+    if (osgDB::fileType(path) == osgDB::DIRECTORY) {
+        osgDB::DirectoryContents contents = osgDB::getDirectoryContents(path);
+        std::sort(contents.begin(), contents.end());
+        for (const std::string& name : contents) {
+            // Skips ".", ".." and the ".gcache" directories written by earlier runs.
+            if (!name.empty() && name[0] != '.') {
+                collectFiles(osgDB::concatPaths(path, name), false, files);
+            }
+        }
+        return;
+    }
+    static const std::set<std::string> extensions = MODEL_EXTENSIONS;
+    if (explicitFile || extensions.count(osgDB::getLowerCaseFileExtension(path))) {
+        files.push_back(path);
+    }
+}
+
+static Result convert(const std::string& file, const Arguments& arguments)
+{
+    auto start = std::chrono::steady_clock::now();
+    Result result;
+    result.file = file;
+    result.inputBytes = fileSize(file);
+    GPipeline::Options options = arguments.options;
+    options.cacheDirectory = GPipeline::cacheDirectory(file);
+    if (arguments.force) {
+        std::remove(GPipeline::sceneCachePath(file, options).c_str());
+    }
+    osg::ref_ptr<osg::Node> node = GPipeline::load(file, options, result.report);
+    if (node.valid()) {
+        result.success = result.report.sceneCached || result.report.sceneWritten;
+        result.residentBefore = result.report.dedup.bytesBefore;
+        result.residentAfter = GDedup::residentBytes(node);
+        result.sceneBytes = fileSize(result.report.sceneFile);
+    }
+    if (result.success && arguments.tile) {
+        // Tiles are cut from the unbatched graph, merged batches would defeat the spatial split.
+        GPipeline::Options tileOptions = options;
+        tileOptions.sceneCache = tileOptions.dedup = tileOptions.quantize = tileOptions.halfTexCoords = tileOptions.batch = tileOptions.meshOptimizer = false;
+        GPipeline::Report tileReport;
+        osg::ref_ptr<osg::Node> tileNode = GPipeline::load(file, tileOptions, tileReport);
+        const std::string name = osgDB::getStrippedName(file);
+        const std::string tileFile = osgDB::concatPaths(osgDB::concatPaths(osgDB::getFilePath(file), name + ".tiles"), name + ".gscene");
+        result.tiles = tileNode.valid() ? GTiler::build(tileNode, tileFile, file).tiles : 0;
+        result.tiled = result.tiles > 0;
+        result.success = result.tiled;
+    }
+    result.totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static void printResult(const Result& result)
+{
+    const GPipeline::Report& report = result.report;
+    std::ostringstream stream;
+    stream << (result.success ? "[ok] " : "[failed] ") << result.file << ": "
+           << "read " << report.readTime << " ms, process " << report.processTime << " ms, write " << report.writeTime << " ms, total " << result.totalTime << " ms; "
+           << "input " << result.inputBytes << " B, scene " << result.sceneBytes << " B, resident " << result.residentBefore << " -> " << result.residentAfter << " B; "
+           << report.images.images << " images (" << report.images.cacheHits << " cached)";
+    if (report.meshOptimizer.triangles > 0) {
+        stream << ", ACMR " << report.meshOptimizer.acmrBefore << " -> " << report.meshOptimizer.acmrAfter;
+    }
+    if (report.sceneCached) {
+        stream << ", scene file up to date";
+    }
+    if (result.tiled) {
+        stream << ", " << result.tiles << " tiles";
+    }
+    std::cout << stream.str() << std::endl;
+}
+
+static bool writeReport(const std::string& file, const std::vector<Result>& results)
+{
+    std::ofstream stream(file, std::ios::trunc);
+    if (!stream) {
+        return false;
+    }
+    stream << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        const GPipeline::Report& report = result.report;
+        stream << "    {\n"
+               << "        \"file\": " << jsonString(result.file) << ",\n"
+               << "        \"success\": " << (result.success ? "true" : "false") << ",\n"
+               << "        \"sceneFile\": " << jsonString(report.sceneFile) << ",\n"
+               << "        \"sceneCached\": " << (report.sceneCached ? "true" : "false") << ",\n"
+               << "        \"inputBytes\": " << result.inputBytes << ",\n"
+               << "        \"sceneBytes\": " << result.sceneBytes << ",\n"
+               << "        \"residentBefore\": " << result.residentBefore << ",\n"
+               << "        \"residentAfter\": " << result.residentAfter << ",\n"
+               << "        \"images\": " << report.images.images << ",\n"
+               << "        \"imageCacheHits\": " << report.images.cacheHits << ",\n"
+               << "        \"acmrBefore\": " << report.meshOptimizer.acmrBefore << ",\n"
+               << "        \"acmrAfter\": " << report.meshOptimizer.acmrAfter << ",\n"
+               << "        \"tiles\": " << result.tiles << ",\n"
+               << "        \"readTime\": " << report.readTime << ",\n"
+               << "        \"processTime\": " << report.processTime << ",\n"
+               << "        \"writeTime\": " << report.writeTime << ",\n"
+               << "        \"totalTime\": " << result.totalTime << "\n"
+               << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    stream << "]\n";
+    return (bool)stream;
+}
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << osgDB::getSimpleFileName(program) << " [options] <model|directory>...\n"
+              << "  -j <count>          files converted in parallel\n"
+              << "  --exclude <name>    node kept out of batching, repeat to match the viewer's batchExcludeList\n"
+              << "  --no-compress       cache textures uncompressed\n"
+              << "  --half-uvs          store texture coordinates as half floats, combine with --force for existing scene files\n"
+              << "  --reduce-overdraw   also sort triangles against overdraw, combine with --force for existing scene files\n"
+              << "  --force             rebuild scene files that are already up to date\n"
+              << "  --tile              also write PagedLOD tiles to <model>.tiles/\n"
+              << "  --report <file>     write per-file timings and sizes as JSON\n";
+}
+
+int main(int argc, char* argv[])
+{
+    Arguments arguments;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            arguments.jobs = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--exclude") == 0 && i + 1 < argc) {
+            arguments.options.excludeNames.insert(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-compress") == 0) {
+            arguments.options.compress = false;
+        } else if (std::strcmp(argv[i], "--half-uvs") == 0) {
+            arguments.options.halfTexCoords = true;
+        } else if (std::strcmp(argv[i], "--reduce-overdraw") == 0) {
+            arguments.options.reduceOverdraw = true;
+        } else if (std::strcmp(argv[i], "--force") == 0) {
+            arguments.force = true;
+        } else if (std::strcmp(argv[i], "--tile") == 0) {
+            arguments.tile = true;
+        } else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            arguments.reportFile = argv[++i];
+        } else if (argv[i][0] == '-') {
+            printUsage(argv[0]);
+            return -1;
+        } else {
+            arguments.inputs.push_back(argv[i]);
+        }
+    }
+    std::vector<std::string> files;
+    for (const std::string& input : arguments.inputs) {
+        collectFiles(input, true, files);
+    }
+    if (files.empty()) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    // Files run side by side, each one also fans out its image decode and mesh passes.
+    std::vector<Result> results(files.size());
+    std::mutex mutex;
+    GParallel::forEach(files.size(), [&](size_t i) {
+        results[i] = convert(files[i], arguments);
+        std::lock_guard<std::mutex> locker(mutex);
+        printResult(results[i]);
+    }, arguments.jobs);
+    unsigned int failed = (unsigned int)std::count_if(results.begin(), results.end(), [](const Result& result) { return !result.success; });
+    std::cout << files.size() - failed << " of " << files.size() << " models converted" << std::endl;
+    if (!arguments.reportFile.empty() && !writeReport(arguments.reportFile, results)) {
+        std::cerr << "Failed to write " << arguments.reportFile << std::endl;
+        return -3;
+    }
+    return failed ? -2 : 0;
+}